@@ -0,0 +1,149 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  fixed_msg_conversions.hpp
+ * \brief Conversion helpers between dynamic (DataReceived/DataSent) and
+ *        fixed-size (DataReceivedFixed/DataSentFixed) EtherCAT messages.
+ *
+ * Fixed-size messages are used on the real-time topics, dynamic ones can still be
+ * used by tools that doesn't know the configured number of drives.
+ * Converting to fixed-size messages never allocates, converting from them resizes
+ * the destination vectors to the number of valid drives.
+ *******************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+#include "ecat_msgs/msg/data_received.hpp"
+#include "ecat_msgs/msg/data_sent.hpp"
+#include "ecat_msgs/msg/data_received_fixed.hpp"
+#include "ecat_msgs/msg/data_sent_fixed.hpp"
+
+namespace ecat_msgs
+{
+namespace conversions
+{
+/**
+ * @brief Copies dynamic feedback message to fixed-size feedback message.
+ *
+ * @param in Dynamic feedback message.
+ * @param out Fixed-size feedback message.
+ * @return true if all drives fit in fixed-size message, false if drives are truncated.
+ */
+inline bool ToFixed(const msg::DataReceived& in, msg::DataReceivedFixed& out)
+{
+    const std::size_t n = std::min<std::size_t>(in.actual_pos.size(), msg::DataReceivedFixed::MAX_SERVO_DRIVES);
+    out.stamp                  = in.header.stamp;
+    out.com_status             = in.com_status;
+    out.num_of_drives          = static_cast<uint16_t>(n);
+    for(std::size_t i = 0 ; i < n ; i++){
+        out.actual_pos[i]      = in.actual_pos[i];
+        out.actual_vel[i]      = i < in.actual_vel.size()      ? in.actual_vel[i]      : 0;
+        out.actual_tor[i]      = i < in.actual_tor.size()      ? in.actual_tor[i]      : 0;
+        out.status_word[i]     = i < in.status_word.size()     ? in.status_word[i]     : 0;
+        out.op_mode_display[i] = i < in.op_mode_display.size() ? in.op_mode_display[i] : 0;
+        out.filtered_vel[i]    = i < in.filtered_vel.size()    ? in.filtered_vel[i]    : 0;
+        out.filtered_acc[i]    = i < in.filtered_acc.size()    ? in.filtered_acc[i]    : 0;
+    }
+    out.left_limit_switch_val  = in.left_limit_switch_val;
+    out.right_limit_switch_val = in.right_limit_switch_val;
+    out.emergency_switch_val   = in.emergency_switch_val;
+    return n == in.actual_pos.size();
+}
+
+/**
+ * @brief Copies fixed-size feedback message to dynamic feedback message.
+ *
+ * @param in Fixed-size feedback message.
+ * @param out Dynamic feedback message, vectors are resized to number of valid drives.
+ */
+inline void FromFixed(const msg::DataReceivedFixed& in, msg::DataReceived& out)
+{
+    const std::size_t n = std::min<std::size_t>(in.num_of_drives, msg::DataReceivedFixed::MAX_SERVO_DRIVES);
+    out.header.stamp = in.stamp;
+    out.com_status   = in.com_status;
+    out.actual_pos.assign(in.actual_pos.begin(), in.actual_pos.begin() + n);
+    out.actual_vel.assign(in.actual_vel.begin(), in.actual_vel.begin() + n);
+    out.actual_tor.assign(in.actual_tor.begin(), in.actual_tor.begin() + n);
+    out.status_word.assign(in.status_word.begin(), in.status_word.begin() + n);
+    out.op_mode_display.assign(in.op_mode_display.begin(), in.op_mode_display.begin() + n);
+    out.filtered_vel.assign(in.filtered_vel.begin(), in.filtered_vel.begin() + n);
+    out.filtered_acc.assign(in.filtered_acc.begin(), in.filtered_acc.begin() + n);
+    out.left_limit_switch_val  = in.left_limit_switch_val;
+    out.right_limit_switch_val = in.right_limit_switch_val;
+    out.emergency_switch_val   = in.emergency_switch_val;
+}
+
+/**
+ * @brief Copies dynamic command message to fixed-size command message.
+ *
+ * @param in Dynamic command message.
+ * @param out Fixed-size command message.
+ * @return true if all drives fit in fixed-size message, false if drives are truncated.
+ */
+inline bool ToFixed(const msg::DataSent& in, msg::DataSentFixed& out)
+{
+    const std::size_t n = std::min<std::size_t>(in.control_word.size(), msg::DataSentFixed::MAX_SERVO_DRIVES);
+    out.stamp         = in.header.stamp;
+    out.num_of_drives = static_cast<uint16_t>(n);
+    for(std::size_t i = 0 ; i < n ; i++){
+        out.control_word[i] = in.control_word[i];
+        out.target_pos[i]   = i < in.target_pos.size() ? in.target_pos[i] : 0;
+        out.target_vel[i]   = i < in.target_vel.size() ? in.target_vel[i] : 0;
+        out.target_tor[i]   = i < in.target_tor.size() ? in.target_tor[i] : 0;
+    }
+    out.op_mode    = in.op_mode;
+    out.vel_offset = in.vel_offset;
+    out.tor_offset = in.tor_offset;
+    return n == in.control_word.size();
+}
+
+/**
+ * @brief Copies fixed-size command message to dynamic command message.
+ *
+ * @param in Fixed-size command message.
+ * @param out Dynamic command message, vectors are resized to number of valid drives.
+ */
+inline void FromFixed(const msg::DataSentFixed& in, msg::DataSent& out)
+{
+    const std::size_t n = std::min<std::size_t>(in.num_of_drives, msg::DataSentFixed::MAX_SERVO_DRIVES);
+    out.header.stamp = in.stamp;
+    out.target_pos.assign(in.target_pos.begin(), in.target_pos.begin() + n);
+    out.target_vel.assign(in.target_vel.begin(), in.target_vel.begin() + n);
+    out.target_tor.assign(in.target_tor.begin(), in.target_tor.begin() + n);
+    out.control_word.assign(in.control_word.begin(), in.control_word.begin() + n);
+    out.op_mode    = in.op_mode;
+    out.vel_offset = in.vel_offset;
+    out.tor_offset = in.tor_offset;
+}
+}  // namespace conversions
+}  // namespace ecat_msgs
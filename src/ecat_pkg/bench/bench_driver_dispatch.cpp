@@ -0,0 +1,238 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  bench_driver_dispatch.cpp
+ * \brief Cost of statically dispatched slave drivers vs hand-written PDO loops.
+ *
+ * Decodes feedback and encodes velocity commands of kNumOfDrives EPOS4 drives
+ * in a fake domain image, once with plain loops over PdoLayout::View (the code
+ * before slave_driver.hpp) and once through a DriverSet, times are per cycle.
+ * A mixed EPOS4/Elmo/EasyCAT set runs every Encode*() and Decode() of each
+ * driver, so all declared drivers are compiled against their layouts.
+ *   ros2 run ecat_pkg bench_driver_dispatch --cpu 3 --priority 80
+ *******************************************************************************/
+#include "bench_util.hpp"
+#include "slave_driver.hpp"
+
+namespace {
+
+const int kNumOfDrives = 64;
+/// Sync manager blocks are placed this far apart in the fake domain, all layouts fit.
+const int kSyncStride  = 16;
+
+/// Same fields as DataReceivedFixed, sized for the benchmark topology.
+struct Feedback
+{
+    int32_t  actual_pos[kNumOfDrives];
+    int32_t  actual_vel[kNumOfDrives];
+    uint16_t status_word[kNumOfDrives];
+    int16_t  actual_tor[kNumOfDrives];
+    int8_t   op_mode_display[kNumOfDrives];
+    uint8_t  right_limit_switch_val;
+    uint8_t  left_limit_switch_val;
+    uint8_t  emergency_switch_val;
+};
+
+struct Commands
+{
+    uint16_t control_word[kNumOfDrives];
+    int32_t  target_vel[kNumOfDrives];
+    int32_t  target_pos[kNumOfDrives];
+    int16_t  target_tor[kNumOfDrives];
+};
+
+/// Stores domain offset of E into offsets like Layout::Register() does, if L maps it.
+template <typename L, typename E>
+void Place(OffsetPDO & offsets, int base, std::true_type)
+{
+    static_assert(L::template OffsetOf<E>() + int(sizeof(typename E::Type)) <= kSyncStride, "Sync manager block doesn't fit.");
+    offsets.*E::GetField() = base + L::template SyncOf<E>() * kSyncStride + L::template OffsetOf<E>();
+}
+template <typename L, typename E>
+void Place(OffsetPDO &, int, std::false_type)
+{
+}
+
+/// Lays out slave of layout L at base in the fake domain.
+template <typename L>
+void PlaceSlave(EthercatSlave & slave, uint8_t * domain, int base)
+{
+    using namespace PdoLayout;
+    slave.slave_pdo_domain_ = domain;
+    OffsetPDO & o = slave.offset_;
+    Place<L, ControlWord>(o, base, std::integral_constant<bool, L::template IsBindable<ControlWord>()>());
+    Place<L, TargetPosition>(o, base, std::integral_constant<bool, L::template IsBindable<TargetPosition>()>());
+    Place<L, TargetVelocity>(o, base, std::integral_constant<bool, L::template IsBindable<TargetVelocity>()>());
+    Place<L, TargetTorque>(o, base, std::integral_constant<bool, L::template IsBindable<TargetTorque>()>());
+    Place<L, TorqueOffset>(o, base, std::integral_constant<bool, L::template IsBindable<TorqueOffset>()>());
+    Place<L, OperationMode>(o, base, std::integral_constant<bool, L::template IsBindable<OperationMode>()>());
+    Place<L, StatusWord>(o, base, std::integral_constant<bool, L::template IsBindable<StatusWord>()>());
+    Place<L, PositionActualValue>(o, base, std::integral_constant<bool, L::template IsBindable<PositionActualValue>()>());
+    Place<L, VelocityActualValue>(o, base, std::integral_constant<bool, L::template IsBindable<VelocityActualValue>()>());
+    Place<L, TorqueActualValue>(o, base, std::integral_constant<bool, L::template IsBindable<TorqueActualValue>()>());
+    Place<L, OperationModeDisplay>(o, base, std::integral_constant<bool, L::template IsBindable<OperationModeDisplay>()>());
+    Place<L, EasyCatEmergencySwitch>(o, base, std::integral_constant<bool, L::template IsBindable<EasyCatEmergencySwitch>()>());
+    Place<L, EasyCatRightLimitSwitch>(o, base, std::integral_constant<bool, L::template IsBindable<EasyCatRightLimitSwitch>()>());
+    Place<L, EasyCatLeftLimitSwitch>(o, base, std::integral_constant<bool, L::template IsBindable<EasyCatLeftLimitSwitch>()>());
+}
+
+/// Size of one slave in the fake domain.
+template <typename L>
+constexpr int SlotSize() { return L::kNumOfSyncs * kSyncStride; }
+
+/// Binds drivers of set to consecutive slots of domain.
+template <typename Set>
+void Layout(Set & drivers, std::vector<uint8_t> & domain, EthercatSlave * slaves)
+{
+    int size = 0;
+    drivers.ForEach([&size](auto & driver, int){
+        size += SlotSize<typename std::decay<decltype(driver)>::type::Layout>();
+    });
+    domain.assign(size, 0);
+    int base = 0;
+    drivers.ForEach([&](auto & driver, int i){
+        typedef typename std::decay<decltype(driver)>::type::Layout L;
+        PlaceSlave<L>(slaves[i], domain.data(), base);
+        driver.Bind(slaves[i]);
+        base += SlotSize<L>();
+    });
+}
+
+/// Pretends the slaves answered, so decode doesn't read the same values every cycle.
+void Receive(std::vector<uint8_t> & domain, uint32_t cycle)
+{
+    for(size_t i = 0 ; i < domain.size() ; i += 8){
+        domain[i] = uint8_t(cycle + i);
+    }
+}
+
+template <typename Cycle>
+void Run(const char * label, const bench::Options & options, std::vector<uint8_t> & domain, Cycle cycle)
+{
+    bench::Samples exec_time(options.iterations);
+    for(uint32_t i = 0 ; i < options.iterations ; i++){
+        Receive(domain, i);
+        const int64_t start = bench::NowNs();
+        cycle(i);
+        exec_time.Add(bench::NowNs() - start);
+        bench::DoNotOptimize(domain[i % domain.size()]);
+    }
+    exec_time.Print(label);
+}
+
+typedef SlaveDriver::DriverSet<SlaveDriver::Batch<SlaveDriver::MaxonEpos4Driver, 0, kNumOfDrives>> Epos4Set;
+typedef SlaveDriver::DriverSet<SlaveDriver::Batch<SlaveDriver::MaxonEpos4Driver, 0, kNumOfDrives / 2>,
+                               SlaveDriver::Batch<SlaveDriver::ElmoGoldDriver, kNumOfDrives / 2, kNumOfDrives / 2>,
+                               SlaveDriver::Batch<SlaveDriver::EasyCatDriver, kNumOfDrives, 1>> MixedSet;
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const bench::Options options = bench::ParseOptions(argc, argv, 100000);
+    static EthercatSlave slaves[kNumOfDrives + 1];
+    static Feedback feedback;
+    static Commands commands;
+    for(int i = 0 ; i < kNumOfDrives ; i++){
+        commands.control_word[i] = 0x0f;
+        commands.target_vel[i]   = 100 * i;
+        commands.target_pos[i]   = 1000 * i;
+        commands.target_tor[i]   = 10 * i;
+    }
+    std::vector<uint8_t> domain;
+    static Epos4Set epos4_drivers;
+    Layout(epos4_drivers, domain, slaves);
+    // Views of the same slaves for hand-written loops.
+    static PdoLayout::View<PdoLayout::MaxonEpos4> views[kNumOfDrives];
+    for(int i = 0 ; i < kNumOfDrives ; i++){
+        views[i].Bind(slaves[i].slave_pdo_domain_, slaves[i].offset_);
+    }
+    if(bench::SetupRealtime(options)){
+        return 1;
+    }
+    printf("# %d drives | domain %zu bytes\n", kNumOfDrives, domain.size());
+
+    // Same as ReadFromSlaves() and WriteToSlavesVelocityMode() before drivers were introduced.
+    Run("hand-written loops : velocity mode", options, domain, [&](uint32_t){
+        for(int i = 0 ; i < kNumOfDrives ; i++){
+            feedback.actual_pos[i]  = views[i].Get<PdoLayout::PositionActualValue>();
+            feedback.actual_vel[i]  = views[i].Get<PdoLayout::VelocityActualValue>();
+            feedback.status_word[i] = views[i].Get<PdoLayout::StatusWord>();
+            feedback.actual_tor[i]  = views[i].Get<PdoLayout::TorqueActualValue>();
+        }
+        for(int i = 0 ; i < kNumOfDrives ; i++){
+            views[i].Set<PdoLayout::ControlWord>(commands.control_word[i]);
+            views[i].Set<PdoLayout::TargetVelocity>(commands.target_vel[i]);
+        }
+    });
+    Run("drivers : velocity mode", options, domain, [&](uint32_t){
+        epos4_drivers.ForEach([](auto & driver, int i){ driver.Decode(feedback, i); });
+        epos4_drivers.ForEachDrive([](auto & driver, int i){
+            driver.EncodeVelocity(commands.control_word[i], commands.target_vel[i]);
+        });
+    });
+
+    static MixedSet mixed_drivers;
+    Layout(mixed_drivers, domain, slaves);
+    printf("# %d EPOS4, %d Elmo Gold, 1 EasyCAT | domain %zu bytes\n", kNumOfDrives / 2, kNumOfDrives / 2, domain.size());
+    Run("mixed drivers : velocity mode", options, domain, [&](uint32_t){
+        mixed_drivers.ForEach([](auto & driver, int i){ driver.Decode(feedback, i); });
+        mixed_drivers.ForEachDrive([](auto & driver, int i){
+            driver.EncodeVelocity(commands.control_word[i], commands.target_vel[i]);
+        });
+    });
+    Run("mixed drivers : position mode", options, domain, [&](uint32_t){
+        mixed_drivers.ForEach([](auto & driver, int i){ driver.Decode(feedback, i); });
+        mixed_drivers.ForEachDrive([](auto & driver, int i){
+            driver.EncodePosition(commands.control_word[i], commands.target_pos[i]);
+        });
+    });
+    Run("mixed drivers : torque mode", options, domain, [&](uint32_t){
+        mixed_drivers.ForEach([](auto & driver, int i){ driver.Decode(feedback, i); });
+        mixed_drivers.ForEachDrive([](auto & driver, int i){
+            driver.EncodeTorque(commands.control_word[i], commands.target_tor[i], 0);
+        });
+    });
+    Run("mixed drivers : homing", options, domain, [&](uint32_t){
+        mixed_drivers.ForEach([](auto & driver, int i){ driver.Decode(feedback, i); });
+        mixed_drivers.ForEachDrive([](auto & driver, int i){
+            driver.EncodeOperationMode(kHoming);
+            driver.EncodeHoming(commands.control_word[i], kHoming, feedback.actual_pos[i]);
+        });
+    });
+    Run("mixed drivers : control word only", options, domain, [&](uint32_t){
+        mixed_drivers.ForEach([](auto & driver, int i){ driver.Decode(feedback, i); });
+        mixed_drivers.ForEachDrive([](auto & driver, int i){ driver.EncodeControlWord(commands.control_word[i]); });
+    });
+    printf("# last drive : position %d | velocity %d | status word 0x%04x\n", feedback.actual_pos[kNumOfDrives - 1],
+           feedback.actual_vel[kNumOfDrives - 1], feedback.status_word[kNumOfDrives - 1]);
+    return 0;
+}
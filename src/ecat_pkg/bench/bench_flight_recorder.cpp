@@ -0,0 +1,133 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  bench_flight_recorder.cpp
+ * \brief Effect of the flight recorder on control cycle time.
+ *
+ * Runs a 1 kHz loop that copies a domain image of --drives EPOS4 drives in and
+ * out, once without recorder and once recording every cycle into --directory.
+ * Execution time and wake up latency of both runs are printed, the difference
+ * is what recording costs the control thread. Records also carry decoded
+ * messages sized by ECAT_MAX_SERVO_DRIVES, build ecat_msgs with 64 for 64 drives.
+ *   ros2 run ecat_pkg bench_flight_recorder --drives 64 --cpu 3 --priority 80
+ *******************************************************************************/
+#include "bench_util.hpp"
+#include "flight_recorder.hpp"
+#include "pdo_layout.hpp"
+
+#include <string>
+
+namespace {
+
+const int64_t kCycleNs = 1000000;
+
+/// Bytes of an EPOS4 in the domain, RxPDO 0x1600 plus TxPDO 0x1a00.
+int Epos4ImageSize()
+{
+    return PdoLayout::Pdo<0x1600, PdoLayout::ControlWord, PdoLayout::TargetVelocity, PdoLayout::TargetPosition,
+                          PdoLayout::TargetTorque, PdoLayout::TorqueOffset, PdoLayout::OperationMode>::Size() +
+           PdoLayout::Pdo<0x1a00, PdoLayout::StatusWord, PdoLayout::PositionActualValue, PdoLayout::VelocityActualValue,
+                          PdoLayout::TorqueActualValue, PdoLayout::OperationModeDisplay>::Size();
+}
+
+void Run(const char * label, const bench::Options & options, std::vector<uint8_t> & domain,
+         std::vector<uint8_t> & image, FlightRecorder * recorder)
+{
+    bench::Samples exec_time(options.iterations);
+    bench::Samples latency(options.iterations);
+    timespec wake_up_time;
+    clock_gettime(CLOCK_MONOTONIC, &wake_up_time);
+    for(uint32_t cycle = 0 ; cycle < options.iterations ; cycle++){
+        wake_up_time.tv_nsec += kCycleNs;
+        if(wake_up_time.tv_nsec >= 1000000000){
+            wake_up_time.tv_nsec -= 1000000000;
+            wake_up_time.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake_up_time, NULL);
+        const int64_t start = bench::NowNs();
+        latency.Add(start - (int64_t(wake_up_time.tv_sec) * 1000000000 + wake_up_time.tv_nsec));
+
+        // Same order as control loop : input image, control logic, output image.
+        FlightRecorder::CycleRecord * record = recorder ? recorder->BeginRecord() : nullptr;
+        memcpy(image.data(), domain.data(), domain.size());
+        if(record){
+            recorder->SaveInputImage(domain.data());
+            record->cycle      = cycle;
+            record->start_ns   = start;
+            record->received_data.num_of_drives = g_kNumberOfServoDrivers;
+        }
+        image[cycle % image.size()]++;
+        memcpy(domain.data(), image.data(), domain.size());
+        if(record){
+            recorder->SaveOutputImage(domain.data());
+            record->end_ns = bench::NowNs();
+            recorder->CommitRecord();
+        }
+        exec_time.Add(bench::NowNs() - start);
+    }
+    printf("%s\n", label);
+    exec_time.Print("  execution time");
+    latency.Print("  wake up latency");
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const bench::Options options = bench::ParseOptions(argc, argv, 30000);
+    const int drives = bench::IntArgument(argc, argv, "--drives", 64);
+    std::string directory = "/tmp/bench_flight_recorder";
+    for(int i = 1 ; i + 1 < argc ; i++){
+        if(!strcmp(argv[i], "--directory")){
+            directory = argv[i + 1];
+        }
+    }
+    std::vector<uint8_t> domain(drives * Epos4ImageSize());
+    std::vector<uint8_t> image(domain.size());
+    // Slaves are only used for PDO offsets in file header.
+    static EthercatSlave slaves[NUM_OF_SLAVES];
+    const EstimatorParameters<g_kNumberOfServoDrivers> estimator = {};
+
+    FlightRecorder recorder;
+    if(recorder.Open(directory, 2, 10000, domain.size(), slaves, estimator, nullptr)){
+        return 1;
+    }
+    if(bench::SetupRealtime(options)){
+        return 1;
+    }
+    printf("# drives %d | domain %zu bytes | record %u bytes\n", drives, domain.size(),
+           FlightRecorder::GetRecordSize(domain.size()));
+    Run("recorder off", options, domain, image, nullptr);
+    Run("recorder on", options, domain, image, &recorder);
+    printf("# dropped records %llu\n", (unsigned long long)recorder.GetDroppedRecords());
+    recorder.Close();
+    return 0;
+}
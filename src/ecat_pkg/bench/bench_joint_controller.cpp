@@ -0,0 +1,140 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  bench_joint_controller.cpp
+ * \brief Per cycle cost of the CST joint controller at 64 axes.
+ *
+ * Runs the joint controller part of UpdateCyclicTorqueModeParameters() in a
+ * 1 kHz loop : acquire gains, jog or hold every axis, compute torque targets.
+ * A second thread publishes new gains every --gain-period-ms like the parameter
+ * callback does, so the triple buffer hand over is part of the timed work.
+ * The max is only meaningful with --cpu on an isolated CPU and --priority.
+ *   ros2 run ecat_pkg bench_joint_controller --cpu 3 --priority 80
+ *******************************************************************************/
+#include "bench_util.hpp"
+#include "joint_controller.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+const size_t  kNumOfAxes = 64;
+const int64_t kCycleNs   = 1000000;
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const bench::Options options = bench::ParseOptions(argc, argv, 30000);
+    const long gain_period_ms = bench::IntArgument(argc, argv, "--gain-period-ms", 10);
+
+    static JointController<kNumOfAxes> controller;
+    controller.Configure(4096 * 4, 1000);
+    JointGains<kNumOfAxes> gains;
+    for(size_t i = 0 ; i < kNumOfAxes ; i++){
+        gains.kp[i] = 0.05f;
+        gains.kd[i] = 0.5f;
+        gains.kv[i] = 0.01f;
+        gains.ka[i] = 0.001f;
+        gains.max_torque[i] = 1000;
+    }
+    controller.SetGains(gains);
+
+    static int32_t actual_pos[kNumOfAxes];
+    static float   velocity[kNumOfAxes];
+    static int16_t target_tor[kNumOfAxes];
+
+    // Executor side, changes gains while the loop runs.
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> published{0};
+    std::thread writer([&](){
+        JointGains<kNumOfAxes> g = gains;
+        while(running){
+            std::this_thread::sleep_for(std::chrono::milliseconds(gain_period_ms));
+            g.kp[published % kNumOfAxes] += 1e-4f;
+            controller.SetGains(g);
+            published++;
+        }
+    });
+
+    if(bench::SetupRealtime(options)){
+        running = false;
+        writer.join();
+        return 1;
+    }
+    printf("# %zu axes | gains published every %ld ms\n", kNumOfAxes, gain_period_ms);
+
+    bench::Samples exec_time(options.iterations);
+    bench::Samples latency(options.iterations);
+    uint64_t acquired = 0;
+    timespec wake_up_time;
+    clock_gettime(CLOCK_MONOTONIC, &wake_up_time);
+    for(uint32_t cycle = 0 ; cycle < options.iterations ; cycle++){
+        wake_up_time.tv_nsec += kCycleNs;
+        if(wake_up_time.tv_nsec >= 1000000000){
+            wake_up_time.tv_nsec -= 1000000000;
+            wake_up_time.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake_up_time, NULL);
+        // Feedback of this cycle, drives roughly follow their reference.
+        for(size_t i = 0 ; i < kNumOfAxes ; i++){
+            actual_pos[i] += int32_t(i) - 32;
+            velocity[i]    = float(int32_t(i) - 32) * 0.1f;
+        }
+        const int64_t start = bench::NowNs();
+        latency.Add(start - (int64_t(wake_up_time.tv_sec) * 1000000000 + wake_up_time.tv_nsec));
+
+        acquired += controller.AcquireGains();
+        for(size_t i = 0 ; i < kNumOfAxes ; i++){
+            // Every 8th axis is disabled and released, the others jog from a held position.
+            if(i % 8){
+                if(!controller.IsHeld(i)){
+                    controller.Hold(i, actual_pos[i]);
+                }
+                controller.Jog(i, int32_t((cycle + i) % 500) - 250);
+            }else{
+                controller.Release(i);
+            }
+        }
+        controller.Compute(actual_pos, velocity, target_tor);
+
+        exec_time.Add(bench::NowNs() - start);
+        bench::DoNotOptimize(target_tor);
+    }
+    running = false;
+    writer.join();
+    exec_time.Print("acquire gains + jog + compute");
+    latency.Print("wake up latency");
+    printf("# gains published %llu, acquired %llu\n", (unsigned long long)published.load(), (unsigned long long)acquired);
+    return 0;
+}
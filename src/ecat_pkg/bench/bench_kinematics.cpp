@@ -0,0 +1,175 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  bench_kinematics.cpp
+ * \brief Cost of scalar and batched kinematics of a 3 joint (RRP) chain.
+ *
+ * Scalar functions are what the control loop would call once per cycle, they
+ * are timed in groups of kCallsPerSample calls so clock reads don't dominate,
+ * inverse kinematics is timed per call since its iteration count varies.
+ * Batch functions run over --samples random configurations within joint limits.
+ * Results are checked against the scalar versions. Times are per call or
+ * per sample. The chain is an example geometry, not the robot's calibration.
+ *   ros2 run ecat_pkg bench_kinematics --samples 100000 --cpu 3 --priority 80
+ *******************************************************************************/
+#include "bench_util.hpp"
+#include "kinematics.hpp"
+
+#include <random>
+
+namespace {
+
+const int kCallsPerSample = 100;
+
+const Kinematics::DhLink kLinks[3] = {
+    // a,   alpha,      d,     theta, prismatic, q_min,  q_max
+    {  0.0, M_PI / 2,   150.0, 0.0,   false,     -M_PI,  M_PI   },
+    {  250.0, 0.0,      0.0,   0.0,   false,     -M_PI,  M_PI   },
+    {  0.0, 0.0,        0.0,   0.0,   true,      0.0,    200.0  },
+};
+const Kinematics::LinkMass kMasses[3] = {{2.0, {0, -50, 0}}, {1.5, {-125, 0, 0}}, {0.5, {0, 0, 100}}};
+const double kGravity[3] = {0, 0, -9.81};
+
+/// Times kCallsPerSample calls of f per sample, f gets the configuration index.
+template <typename F>
+void RunScalar(const char * label, const bench::Options & options, size_t count, F f)
+{
+    bench::Samples exec_time(options.iterations);
+    size_t s = 0;
+    for(uint32_t i = 0 ; i < options.iterations ; i++){
+        const int64_t start = bench::NowNs();
+        for(int k = 0 ; k < kCallsPerSample ; k++){
+            f(s);
+            s = s + 1 < count ? s + 1 : 0;
+        }
+        exec_time.Add((bench::NowNs() - start) / kCallsPerSample);
+    }
+    exec_time.Print(label);
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    const bench::Options options = bench::ParseOptions(argc, argv, 20000);
+    const size_t count = bench::IntArgument(argc, argv, "--samples", 100000);
+    const int repetitions = bench::IntArgument(argc, argv, "--repetitions", 20);
+    const Kinematics::SerialChain<3> chain(kLinks);
+
+    // Random configurations within limits, targets are their tool positions and IK starts from a perturbed seed.
+    std::mt19937 generator(1);
+    std::vector<double> q[3], seed[3], x(count), y(count), z(count);
+    for(int i = 0 ; i < 3 ; i++){
+        std::uniform_real_distribution<double> joint(kLinks[i].q_min, kLinks[i].q_max);
+        std::uniform_real_distribution<double> noise(-0.05 * (kLinks[i].q_max - kLinks[i].q_min),
+                                                      0.05 * (kLinks[i].q_max - kLinks[i].q_min));
+        q[i].resize(count);
+        seed[i].resize(count);
+        for(size_t s = 0 ; s < count ; s++){
+            q[i][s]    = joint(generator);
+            seed[i][s] = std::min(std::max(q[i][s] + noise(generator), kLinks[i].q_min), kLinks[i].q_max);
+        }
+    }
+    const double * const q_ptr[3] = {q[0].data(), q[1].data(), q[2].data()};
+    chain.ForwardBatch(q_ptr, count, x.data(), y.data(), z.data());
+
+    if(bench::SetupRealtime(options)){
+        return 1;
+    }
+    printf("# %zu configurations | %d calls per sample for scalar functions\n", count, kCallsPerSample);
+
+    Kinematics::Frame tip;
+    RunScalar("Forward", options, count, [&](size_t s){
+        const double qs[3] = {q[0][s], q[1][s], q[2][s]};
+        chain.Forward(qs, tip);
+        bench::DoNotOptimize(tip);
+    });
+    double jac[6][3];
+    RunScalar("Jacobian", options, count, [&](size_t s){
+        const double qs[3] = {q[0][s], q[1][s], q[2][s]};
+        chain.Jacobian(qs, jac, tip);
+        bench::DoNotOptimize(jac);
+    });
+    double tau[3];
+    RunScalar("GravityTorque", options, count, [&](size_t s){
+        const double qs[3] = {q[0][s], q[1][s], q[2][s]};
+        chain.GravityTorque(qs, kMasses, kGravity, tau);
+        bench::DoNotOptimize(tau);
+    });
+
+    bench::Samples inverse_time(options.iterations);
+    uint32_t reached = 0;
+    for(uint32_t i = 0 ; i < options.iterations ; i++){
+        const size_t s = i % count;
+        const double target[3] = {x[s], y[s], z[s]};
+        double qs[3] = {seed[0][s], seed[1][s], seed[2][s]};
+        const int64_t start = bench::NowNs();
+        reached += chain.Inverse(target, qs) >= 0;
+        inverse_time.Add(bench::NowNs() - start);
+    }
+    inverse_time.Print("Inverse, per call");
+    printf("# Inverse reached %.2f %% of targets\n", 100.0 * reached / options.iterations);
+
+    // Batch functions, samples are per configuration.
+    std::vector<double> bx(count), by(count), bz(count);
+    bench::Samples batch_time(repetitions);
+    for(int r = 0 ; r < repetitions ; r++){
+        const int64_t start = bench::NowNs();
+        chain.ForwardBatch(q_ptr, count, bx.data(), by.data(), bz.data());
+        batch_time.Add((bench::NowNs() - start) / int64_t(count));
+    }
+    batch_time.Print("ForwardBatch, per sample");
+    double max_error = 0;
+    for(size_t s = 0 ; s < count ; s++){
+        const double qs[3] = {q[0][s], q[1][s], q[2][s]};
+        chain.Forward(qs, tip);
+        max_error = std::max(max_error, std::fabs(tip.p[0] - bx[s]) + std::fabs(tip.p[1] - by[s]) + std::fabs(tip.p[2] - bz[s]));
+    }
+    printf("# ForwardBatch vs Forward max error %.3g mm\n", max_error);
+
+    std::vector<double> solution[3];
+    const double * const target_ptr[3] = {x.data(), y.data(), z.data()};
+    bench::Samples inverse_batch_time(repetitions);
+    size_t batch_reached = 0;
+    for(int r = 0 ; r < repetitions ; r++){
+        double * qs[3];
+        for(int i = 0 ; i < 3 ; i++){
+            solution[i] = seed[i];
+            qs[i] = solution[i].data();
+        }
+        const int64_t start = bench::NowNs();
+        batch_reached = chain.InverseBatch(target_ptr, qs, count, nullptr);
+        inverse_batch_time.Add((bench::NowNs() - start) / int64_t(count));
+    }
+    inverse_batch_time.Print("InverseBatch, per sample");
+    printf("# InverseBatch reached %.2f %% of targets\n", 100.0 * batch_reached / count);
+    return 0;
+}
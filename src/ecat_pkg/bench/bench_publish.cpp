@@ -0,0 +1,279 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  bench_publish.cpp
+ * \brief Cost of publishing feedback per cycle, copy based vs loaned messages
+ *        and per cycle vs batched feedback.
+ *
+ * Publishes DataReceivedFixed and DataSentFixed once per 1 ms cycle the same way
+ * EthercatLifeCycle::PublishAllData() does, first by publishing preallocated
+ * messages and then through borrow_loaned_message() if the RMW supports loans.
+ * A subscriber in the same process (intra-process off) receives both topics, so
+ * DDS does the full delivery. Drive count is the ECAT_MAX_SERVO_DRIVES ecat_msgs
+ * was built with, to compare 3/16/64 drives rebuild with e.g.
+ *   colcon build --packages-select ecat_msgs ecat_pkg \
+ *     --cmake-args -DECAT_MAX_SERVO_DRIVES=64 -DECAT_BUILD_BENCHMARKS=ON
+ *   ros2 run ecat_pkg bench_publish --cpu 3 --priority 80
+ * Batched runs publish DataSentFixed every cycle and a DataReceivedBatch every
+ * --batch cycles (default 10, feedback_batch_size of ecat_node) instead of a
+ * DataReceivedFixed per cycle, their mean is the cost per cycle.
+ *
+ * Each run prints the publish cost and, with the subscriber, the latency from
+ * publish to receive callback of each topic. Messages are stamped with the
+ * monotonic clock right before publishing, the callback subtracts the stamp.
+ * A batch's latency is the one of its newest sample, older samples wait in the
+ * batch on purpose. Received/published counts show losses of the best effort QoS.
+ * Add --subscriber 0 to publish without matched reader.
+ *******************************************************************************/
+#include "bench_util.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "rclcpp/rclcpp.hpp"
+#include "ecat_msgs/msg/data_received_fixed.hpp"
+#include "ecat_msgs/msg/data_sent_fixed.hpp"
+#include "ecat_msgs/msg/data_received_batch.hpp"
+
+using ecat_msgs::msg::DataReceivedBatch;
+using ecat_msgs::msg::DataReceivedFixed;
+using ecat_msgs::msg::DataSentFixed;
+
+namespace {
+
+const int64_t kCycleNs = 1000000;
+
+void Stamp(builtin_interfaces::msg::Time & stamp, int64_t ns)
+{
+    stamp.sec     = int32_t(ns / 1000000000);
+    stamp.nanosec = uint32_t(ns % 1000000000);
+}
+
+int64_t StampNs(const builtin_interfaces::msg::Time & stamp)
+{
+    return int64_t(stamp.sec) * 1000000000 + stamp.nanosec;
+}
+
+/// Receive latencies of the current run, written by subscription callbacks in reader thread.
+struct LatencySink
+{
+    std::mutex mutex;
+    bench::Samples * feedback = nullptr;
+    bench::Samples * commands = nullptr;
+    uint64_t feedback_received = 0;
+    uint64_t commands_received = 0;
+
+    void Add(bench::Samples * LatencySink::* samples, uint64_t LatencySink::* received,
+             const builtin_interfaces::msg::Time & stamp)
+    {
+        const int64_t now = bench::NowNs();
+        std::lock_guard<std::mutex> lock(mutex);
+        if(this->*samples){
+            (this->*samples)->Add(now - StampNs(stamp));
+            (this->*received)++;
+        }
+    }
+};
+
+void Fill(DataReceivedFixed & received, DataSentFixed & sent, uint32_t cycle)
+{
+    for(uint32_t i = 0 ; i < DataReceivedFixed::MAX_SERVO_DRIVES ; i++){
+        received.actual_pos[i]   = cycle + i;
+        received.actual_vel[i]   = i;
+        received.status_word[i]  = 0x1237;
+        received.filtered_vel[i] = 0.5f * i;
+        sent.target_pos[i]       = cycle;
+        sent.control_word[i]     = 0x0f;
+    }
+}
+
+/**
+ * Runs `publish` once per cycle and prints its execution time distribution, then
+ * publish to receive latency of feedback and commands if a subscriber is attached.
+ * `feedback_per_cycle` is the number of feedback messages published per cycle.
+ */
+template <typename Publish>
+void Run(const char * label, const bench::Options & options, DataReceivedFixed & received,
+         DataSentFixed & sent, LatencySink * sink, double feedback_per_cycle, Publish publish)
+{
+    bench::Samples samples(options.iterations);
+    bench::Samples feedback_latency(options.iterations);
+    bench::Samples commands_latency(options.iterations);
+    if(sink){
+        std::lock_guard<std::mutex> lock(sink->mutex);
+        sink->feedback = &feedback_latency;
+        sink->commands = &commands_latency;
+        sink->feedback_received = sink->commands_received = 0;
+    }
+    timespec wake_up_time;
+    clock_gettime(CLOCK_MONOTONIC, &wake_up_time);
+    for(uint32_t cycle = 0 ; cycle < options.iterations ; cycle++){
+        wake_up_time.tv_nsec += kCycleNs;
+        if(wake_up_time.tv_nsec >= 1000000000){
+            wake_up_time.tv_nsec -= 1000000000;
+            wake_up_time.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake_up_time, NULL);
+        Fill(received, sent, cycle);
+        const int64_t start = bench::NowNs();
+        Stamp(received.stamp, start);
+        Stamp(sent.stamp, start);
+        publish();
+        samples.Add(bench::NowNs() - start);
+    }
+    samples.Print(label);
+    if(sink){
+        // Messages still in flight are delivered before the run's samples are taken away.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::lock_guard<std::mutex> lock(sink->mutex);
+        sink->feedback = sink->commands = nullptr;
+        feedback_latency.Print("  publish to receive, feedback");
+        commands_latency.Print("  publish to receive, commands");
+        printf("  received feedback %llu / %.0f | commands %llu / %u\n",
+               (unsigned long long)sink->feedback_received, options.iterations * feedback_per_cycle,
+               (unsigned long long)sink->commands_received, options.iterations);
+    }
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+    rclcpp::init(argc, argv);
+    const bench::Options options = bench::ParseOptions(argc, argv, 20000);
+    const bool with_subscriber   = bench::IntArgument(argc, argv, "--subscriber", 1);
+    const long batch_size        = bench::IntArgument(argc, argv, "--batch", 10);
+    if(batch_size < 1 || batch_size > DataReceivedBatch::MAX_SAMPLES){
+        fprintf(stderr, "--batch has to be in [1, %u]\n", unsigned(DataReceivedBatch::MAX_SAMPLES));
+        return 1;
+    }
+
+    auto node = std::make_shared<rclcpp::Node>("bench_publish");
+    auto qos  = rclcpp::QoS(rclcpp::KeepLast(1)).best_effort();
+    auto received_publisher = node->create_publisher<DataReceivedFixed>("bench_feedback", qos);
+    auto sent_publisher     = node->create_publisher<DataSentFixed>("bench_commands", qos);
+    auto batch_publisher    = node->create_publisher<DataReceivedBatch>("bench_feedback_batch", qos);
+
+    LatencySink latency;
+    auto reader = std::make_shared<rclcpp::Node>("bench_publish_reader");
+    rclcpp::executors::SingleThreadedExecutor executor;
+    std::thread reader_thread;
+    rclcpp::Subscription<DataReceivedFixed>::SharedPtr received_subscription;
+    rclcpp::Subscription<DataSentFixed>::SharedPtr sent_subscription;
+    rclcpp::Subscription<DataReceivedBatch>::SharedPtr batch_subscription;
+    if(with_subscriber){
+        received_subscription = reader->create_subscription<DataReceivedFixed>("bench_feedback", qos,
+            [&latency](DataReceivedFixed::UniquePtr msg){
+                latency.Add(&LatencySink::feedback, &LatencySink::feedback_received, msg->stamp);
+            });
+        sent_subscription     = reader->create_subscription<DataSentFixed>("bench_commands", qos,
+            [&latency](DataSentFixed::UniquePtr msg){
+                latency.Add(&LatencySink::commands, &LatencySink::commands_received, msg->stamp);
+            });
+        batch_subscription    = reader->create_subscription<DataReceivedBatch>("bench_feedback_batch", qos,
+            [&latency](DataReceivedBatch::UniquePtr msg){
+                if(msg->num_of_samples){
+                    latency.Add(&LatencySink::feedback, &LatencySink::feedback_received,
+                                msg->samples[msg->num_of_samples - 1].stamp);
+                }
+            });
+        executor.add_node(reader);
+        reader_thread = std::thread([&executor](){ executor.spin(); });
+        // Discovery has to finish before timing starts.
+        std::this_thread::sleep_for(std::chrono::seconds(2));
+    }
+    if(bench::SetupRealtime(options)){
+        return 1;
+    }
+    printf("# ECAT_MAX_SERVO_DRIVES %u | DataReceivedFixed %zu bytes | DataSentFixed %zu bytes | subscriber %d\n",
+           unsigned(DataReceivedFixed::MAX_SERVO_DRIVES), sizeof(DataReceivedFixed), sizeof(DataSentFixed), int(with_subscriber));
+    printf("# batch of %ld samples | DataReceivedBatch %zu bytes\n", batch_size, sizeof(DataReceivedBatch));
+
+    DataReceivedFixed received;
+    DataSentFixed     sent;
+    // Batch is a member in ecat_node, it's large so it isn't put on the stack.
+    auto batch = std::make_unique<DataReceivedBatch>();
+    received.num_of_drives = DataReceivedFixed::MAX_SERVO_DRIVES;
+    sent.num_of_drives     = DataSentFixed::MAX_SERVO_DRIVES;
+    LatencySink * sink = with_subscriber ? &latency : nullptr;
+
+    Run("copy : publish(const &)", options, received, sent, sink, 1, [&](){
+        received_publisher->publish(received);
+        sent_publisher->publish(sent);
+    });
+    if(received_publisher->can_loan_messages() && sent_publisher->can_loan_messages()){
+        Run("loan : borrow, assign, publish", options, received, sent, sink, 1, [&](){
+            auto received_loan = received_publisher->borrow_loaned_message();
+            received_loan.get() = received;
+            received_publisher->publish(std::move(received_loan));
+            auto sent_loan = sent_publisher->borrow_loaned_message();
+            sent_loan.get() = sent;
+            sent_publisher->publish(std::move(sent_loan));
+        });
+    }else{
+        printf("%-40s skipped, RMW can't loan messages\n", "loan : borrow, assign, publish");
+    }
+
+    // Same as PublishAllData() with per_cycle_feedback disabled.
+    Run("copy : batched feedback", options, received, sent, sink, 1.0 / batch_size, [&](){
+        batch->samples[batch->num_of_samples++] = received;
+        sent_publisher->publish(sent);
+        if(batch->num_of_samples >= batch_size){
+            batch_publisher->publish(*batch);
+            batch->num_of_samples = 0;
+        }
+    });
+    if(batch_publisher->can_loan_messages() && sent_publisher->can_loan_messages()){
+        Run("loan : batched feedback", options, received, sent, sink, 1.0 / batch_size, [&](){
+            batch->samples[batch->num_of_samples++] = received;
+            auto sent_loan = sent_publisher->borrow_loaned_message();
+            sent_loan.get() = sent;
+            sent_publisher->publish(std::move(sent_loan));
+            if(batch->num_of_samples >= batch_size){
+                auto batch_loan = batch_publisher->borrow_loaned_message();
+                batch_loan.get().num_of_samples = batch->num_of_samples;
+                std::copy_n(batch->samples.begin(), batch->num_of_samples, batch_loan.get().samples.begin());
+                batch_publisher->publish(std::move(batch_loan));
+                batch->num_of_samples = 0;
+            }
+        });
+    }else{
+        printf("%-40s skipped, RMW can't loan messages\n", "loan : batched feedback");
+    }
+    if(with_subscriber){
+        executor.cancel();
+        reader_thread.join();
+    }
+    rclcpp::shutdown();
+    return 0;
+}
@@ -0,0 +1,159 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  bench_util.hpp
+ * \brief Timing helpers shared by benchmark executables in bench/.
+ *
+ * Benchmarks are built with -DECAT_BUILD_BENCHMARKS=ON and use the same compile
+ * options as ecat_node. Each one takes
+ *   --iterations N   number of timed iterations
+ *   --cpu C          pin benchmark thread to CPU C, e.g. one isolated with isolcpus
+ *   --priority P     run benchmark thread with SCHED_FIFO priority P
+ * Worst case numbers are only meaningful with --cpu on an isolated CPU and --priority.
+ *******************************************************************************/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+namespace bench {
+
+struct Options
+{
+    uint32_t iterations = 100000;
+    int      cpu        = -1;
+    int      priority   = 0;
+};
+
+/// Parses common options, unknown arguments are left for benchmark itself.
+inline Options ParseOptions(int argc, char ** argv, uint32_t default_iterations)
+{
+    Options options;
+    options.iterations = default_iterations;
+    for(int i = 1 ; i + 1 < argc ; i++){
+        if(!strcmp(argv[i], "--iterations")){
+            options.iterations = strtoul(argv[++i], NULL, 10);
+        }else if(!strcmp(argv[i], "--cpu")){
+            options.cpu = atoi(argv[++i]);
+        }else if(!strcmp(argv[i], "--priority")){
+            options.priority = atoi(argv[++i]);
+        }
+    }
+    return options;
+}
+
+/// @return value of integer argument `name`, or default_value if it's not given.
+inline long IntArgument(int argc, char ** argv, const char * name, long default_value)
+{
+    for(int i = 1 ; i + 1 < argc ; i++){
+        if(!strcmp(argv[i], name)){
+            return strtol(argv[i + 1], NULL, 10);
+        }
+    }
+    return default_value;
+}
+
+/// Locks memory and applies CPU affinity and priority to calling thread, same as ecat_node's RT thread.
+inline int SetupRealtime(const Options & options)
+{
+    if(mlockall(MCL_CURRENT | MCL_FUTURE)){
+        perror("mlockall");
+    }
+    if(options.cpu >= 0){
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(options.cpu, &cpus);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)){
+            fprintf(stderr, "Couldn't pin thread to CPU %d\n", options.cpu);
+            return -1;
+        }
+    }
+    if(options.priority > 0){
+        sched_param param = {};
+        param.sched_priority = options.priority;
+        if(pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)){
+            fprintf(stderr, "Couldn't set SCHED_FIFO priority %d, run as root or with CAP_SYS_NICE\n", options.priority);
+            return -1;
+        }
+    }
+    printf("# cpu %d | SCHED_FIFO priority %d | iterations %u\n", options.cpu, options.priority, options.iterations);
+    return 0;
+}
+
+inline int64_t NowNs()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return int64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+/// Preallocated duration samples, Add() doesn't allocate.
+class Samples
+{
+  public:
+    explicit Samples(uint32_t capacity) { values_.reserve(capacity); }
+    void Add(int64_t ns) { if(values_.size() < values_.capacity()) values_.push_back(ns); }
+    void Clear() { values_.clear(); }
+    /// Prints mean, min, median, p99, p99.9 and max in microseconds.
+    void Print(const char * label)
+    {
+        if(values_.empty()){
+            printf("%-40s no samples\n", label);
+            return;
+        }
+        std::sort(values_.begin(), values_.end());
+        auto at = [this](double q){ return values_[size_t(q * (values_.size() - 1))] / 1e3; };
+        double sum = 0;
+        for(int64_t value : values_) sum += value;
+        printf("%-40s mean %9.3f | min %9.3f | median %9.3f | p99 %9.3f | p99.9 %9.3f | max %9.3f us\n",
+               label, sum / values_.size() / 1e3, at(0), at(0.5), at(0.99), at(0.999), at(1));
+    }
+  private:
+    std::vector<int64_t> values_;
+};
+
+/// Keeps the compiler from removing computations whose result isn't used.
+template <typename T>
+inline void DoNotOptimize(const T & value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace bench
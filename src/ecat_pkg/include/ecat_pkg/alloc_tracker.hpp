@@ -0,0 +1,96 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  alloc_tracker.hpp
+ * \brief Counts dynamic memory allocations made by tagged threads.
+ *
+ * Global operator new/delete are replaced in alloc_tracker.cpp. Each thread can tag
+ * itself (e.g. executor thread), allocations of tagged threads are counted while
+ * tracking is enabled. Used to verify real-time threads are allocation free in 
+ * steady state.
+ *
+ * If TRACK_RT_ALLOCATIONS is set in ecat_globals.hpp, malloc family is intercepted
+ * as well, so allocations which bypass operator new (e.g. C libraries, logging)
+ * are counted and backtraces of first few offenders are recorded.
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace AllocTracker
+{
+/// Thread tags, allocations are counted per tag.
+enum TrackedThread
+{
+    kUntracked = 0,
+    kExecutorThread,
+    kCyclicThread,
+    kNumOfTrackedThreads
+};
+
+/// Maximum number of recorded offender backtraces and depth of each backtrace.
+const uint32_t kMaxRecordedBacktraces = 8;
+const uint32_t kMaxBacktraceDepth     = 24;
+
+/**
+ * @brief Prepares tracker before real-time part starts. First call to backtrace() 
+ *        loads unwinder library and allocates, therefore it's done here once.
+ */
+void Init();
+
+/**
+ * @brief Tags calling thread, following allocations of this thread are counted under this tag.
+ */
+void SetThreadTag(TrackedThread tag);
+
+/**
+ * @brief Starts/stops counting allocations. Can be called in real-time, doesn't allocate.
+ */
+void Enable(bool enable);
+
+/**
+ * @brief Resets all counters and recorded backtraces.
+ */
+void Reset();
+
+/**
+ * @brief Gets number of allocations made by threads with given tag since last reset.
+ */
+uint64_t GetAllocationCount(TrackedThread tag);
+
+/**
+ * @brief Writes recorded offender backtraces to given file descriptor. 
+ *        Doesn't allocate, safe to call while tracking is enabled.
+ * @return Number of written backtraces.
+ */
+uint32_t PrintBacktraces(int fd);
+}  // namespace AllocTracker
@@ -71,10 +71,15 @@
 /****************************************************************************/
                 /// USER SHOULD DEFINE THIS AREAS ///
 #define NUM_OF_SLAVES     1     /// Total number of connected slave to the bus.
+#define NUM_OF_MASTERS    1     /// Number of EtherCAT masters (one per NIC/segment), each master runs its own cyclic thread.
+/// Slaves are numbered consecutively over masters, first g_kNumberOfSlavesPerMaster[0] slaves are on first master etc.
+/// Entries should sum up to NUM_OF_SLAVES.
+const uint32_t  g_kNumberOfSlavesPerMaster[NUM_OF_MASTERS] = {NUM_OF_SLAVES};
 const uint32_t  g_kNumberOfServoDrivers = 1 ; /// Number of connected servo drives.
 #define CUSTOM_SLAVE    0
 #define FREQUENCY       1000        // Ethercat PDO exchange loop frequency in Hz
 #define MEASURE_TIMING         0    /// If you want to measure timings leave it as one, otherwise make it 0.
+#define TRACK_RT_ALLOCATIONS   0    /// Set to 1 to intercept malloc family and record allocations of cyclic thread, \see alloc_tracker.hpp
 #define VELOCITY_MODE          1    /// set this to 1 if you want to use it in velocity mode (and set other modes to 0)
 #define POSITION_MODE          0    /// set this to 1 if you want to use it in position mode (and set other modes to 0)
 #define CYCLIC_POSITION_MODE   0    /// set this to 1 if you want to use it in cyclic synchronous position mode (and set other modes to 0)
@@ -95,17 +100,9 @@ const uint32_t           g_kNsPerSec = 1000000000;     /// Nanoseconds per secon
     #define FINAL_SLAVE     (NUM_OF_SLAVES-1)
 #endif
 /****************************************************************************/
-/// Global variable declarations, definitions are in @file ethercat_node.cpp
+/// Global variable declarations. Master, domain and their states are members of EthercatNode instances.
 static volatile sig_atomic_t sig = 1;
-extern ec_master_t        * g_master ;  // EtherCAT master
-extern ec_master_state_t    g_master_state ; // EtherCAT master state
-
-extern ec_domain_t       * g_master_domain ; // Ethercat data passing master domain
-extern ec_domain_state_t   g_master_domain_state ;   // EtherCAT master domain state
-
-extern struct timespec      g_sync_timer ;                       // timer for DC sync .
 const struct timespec       g_cycle_time = {0, PERIOD_NS} ;       // cycletime settings in ns. 
-extern uint32_t             g_sync_ref_counter;                  // To sync every cycle.
 
 /****************************************************************************/
 #define TEST_BIT(NUM,N)    ((NUM &  (1 << N))>>N)  /// Check specific bit in the data. 0 or 1.
@@ -359,8 +356,8 @@ typedef struct
  {
     uint32_t Pgain = 20000;     // micro amp sec per radian
     uint32_t Igain = 500000;    // micro amp per radian
-    uint32_t FFVelgain = 0;
-    uint32_t FFAccgain = 0;
+    uint32_t FFVelgain = 0;     // 0 keeps drive's stored value, unless the other one is set.
+    uint32_t FFAccgain = 0;     // 0 keeps drive's stored value, unless the other one is set.
  } VelControlParam;
 /**
  * @brief Struct contains configuration parameters for cyclic sync. velocity mode.
@@ -374,18 +371,31 @@ typedef struct
     uint32_t software_position_limit ; 
     uint32_t interpolation_time_period ;
 } CSVelocityModeParam ;
+/**
+ * @brief Struct containing 'gear configuration' 0x3003, all 4 sub indexes are written together.
+ * Default values are from EPOS4 firmware manual except max_input_speed, 0 means record isn't written.
+ * 
+ */
+ typedef struct
+ {
+    uint32_t numerator = 1;
+    uint32_t denominator = 1;
+    uint32_t max_input_speed = 0;       // rpm
+    uint32_t misc_configuration = 0;    // Bit 0 : gear direction, 0 normal 1 inverted.
+ } GearParam;
  /**
  * @brief Struct contains configuration parameters for cyclic sync. torque mode.
+ *        Motor, gear and current controller entries that are 0 keep the value stored in the drive.
  * 
  */
 typedef struct 
 {
-    uint32_t nominal_current ;
-    uint16_t torque_constant ;
-    uint32_t max_motor_speed ; 
-    uint32_t max_gear_input_speed ;
-    uint32_t current_controller_p_gain ;
-    uint32_t current_controller_i_gain ; 
+    uint32_t nominal_current = 0;           // mA
+    uint16_t torque_constant = 0;           // uNm/A
+    uint32_t max_motor_speed = 0;           // rpm
+    GearParam gear ;
+    uint32_t current_controller_p_gain = 0; // uV/A
+    uint32_t current_controller_i_gain = 0; // uV/(A*ms)
     uint32_t quick_stop_dec ;
     uint32_t profile_dec ;
     uint16_t motor_rated_torque ;
@@ -34,7 +34,16 @@
  *        loop implemented in this file.
  *******************************************************************************/
 #include "ecat_node.hpp"
+#include "secondary_master.hpp"
 #include "timing.hpp"
+#include "loop_statistics.hpp"
+#include "flight_recorder.hpp"
+#include "latency_trace.hpp"
+#include "phase_trace.hpp"
+#include "homing.hpp"
+#include "joint_controller.hpp"
+#include "torque_feedforward.hpp"
+#include "state_estimator.hpp"
 /******************************************************************************/
 /// ROS2 lifecycle node header files.
 #include <rclcpp_lifecycle/lifecycle_node.hpp>
@@ -43,8 +52,11 @@
 /// Interface header files
 #include "std_msgs/msg/u_int8.hpp"
 /// Interface header files.Contains custom msg files.
-#include "ecat_msgs/msg/data_received.hpp"
-#include "ecat_msgs/msg/data_sent.hpp"
+/// Fixed-size variants are used on real-time topics, they don't allocate memory.
+#include "ecat_msgs/msg/data_received_fixed.hpp"
+#include "ecat_msgs/msg/data_sent_fixed.hpp"
+#include "ecat_msgs/msg/data_received_batch.hpp"
+#include "std_srvs/srv/trigger.hpp"
 /******************************************************************************/
 #include <rclcpp/strategies/message_pool_memory_strategy.hpp>   // /// Completely static memory allocation strategy for messages.
 #include <rclcpp/strategies/allocator_memory_strategy.hpp>
@@ -59,17 +71,22 @@
 
 #include <tlsf_cpp/tlsf.hpp>   // C++ wrapper for Miguel Masmano Tello's implementation of the TLSF memory allocator
 // Implements the allocator_traits template
+#include "tlsf_message_pool.hpp"   // Preallocated subscription messages backed by TLSF allocator.
+#include "alloc_tracker.hpp"       // Allocation counters to verify executor and control loop are allocation free.
+#include <atomic>
 
 /******************************************************************************/ 
 #include "ecat_msgs/msg/haptic_cmd.hpp"
 using rclcpp::strategies::message_pool_memory_strategy::MessagePoolMemoryStrategy;
 using rclcpp::memory_strategies::allocator_memory_strategy::AllocatorMemoryStrategy;
 
-template<typename T = void>
-using TLSFAllocator = tlsf_heap_allocator<T>;
-
 using namespace rclcpp_lifecycle ;
 using namespace EthercatCommunication ; 
+
+static_assert(g_kNumberOfServoDrivers <= ecat_msgs::msg::DataReceivedFixed::MAX_SERVO_DRIVES,
+              "Rebuild ecat_msgs with ECAT_MAX_SERVO_DRIVES >= g_kNumberOfServoDrivers");
+static_assert(g_kNumberOfServoDrivers <= ecat_msgs::msg::DataSentFixed::MAX_SERVO_DRIVES,
+              "Rebuild ecat_msgs with ECAT_MAX_SERVO_DRIVES >= g_kNumberOfServoDrivers");
 namespace EthercatLifeCycleNode
 {
 class EthercatLifeCycle : public LifecycleNode
@@ -77,6 +94,20 @@ class EthercatLifeCycle : public LifecycleNode
     public:
         EthercatLifeCycle();
         ~EthercatLifeCycle();
+    /**
+     * @brief Gets TLSF allocator based memory strategy, executor spinning this node 
+     *        should be created with this strategy. \see main.cpp
+     */
+        rclcpp::memory_strategy::MemoryStrategy::SharedPtr GetMemoryStrategy() const { return memory_strategy_; }
+    /**
+     * @brief Returns true if control loop was stopped because cyclic thread allocated 
+     *        memory after warm-up. Only set when "fail_on_rt_allocation" parameter is true.
+     */
+        bool RtAllocationDetected() const { return rt_allocation_detected_; }
+    /**
+     * @brief Returns true if replayed output images didn't match the recording. \see Replay()
+     */
+        bool ReplayFailed() const { return replay_failed_; }
     private:
     /**
      * @brief Ethercat lifecycle node configuration function, node will start with this function
@@ -90,13 +121,15 @@ class EthercatLifeCycle : public LifecycleNode
     /**
      * @brief Activates Ethercat lifecycle node and starts real-time Ethercat communication.
      *        All publishing is done in real-time loop in this active state.
+     *        After a deactivation cyclic thread is still in standby, so only drives are re-enabled (warm restart).
      * 
      * @return Success if activation succesfull,otherwise FAILURE
      */
         node_interfaces::LifecycleNodeInterface::CallbackReturn on_activate(const State &);
    
     /**
-     * @brief Deactivates Ethercat lifecycle node, turns of real-time communication.
+     * @brief Deactivates Ethercat lifecycle node, stops control loop and disables drives.
+     *        Master stays requested and activated, cyclic thread keeps slaves in OP in standby.
      * 
      * @return Success if deactivation succesfull,otherwise FAILURE
      */
@@ -126,18 +159,35 @@ class EthercatLifeCycle : public LifecycleNode
 
         rclcpp::TimerBase::SharedPtr timer_;
         /// This lifecycle publisher will be used to publish received feedback data from slaves.
-        LifecyclePublisher<ecat_msgs::msg::DataReceived>::SharedPtr received_data_publisher_;
+        LifecyclePublisher<ecat_msgs::msg::DataReceivedFixed, TLSFAllocator<void>>::SharedPtr received_data_publisher_;
         /// This lifecycle publisher will be used to publish sent data from master to slaves.
-        LifecyclePublisher<ecat_msgs::msg::DataSent>::SharedPtr     sent_data_publisher_;
+        LifecyclePublisher<ecat_msgs::msg::DataSentFixed, TLSFAllocator<void>>::SharedPtr     sent_data_publisher_;
+        /// Publishes feedback of feedback_batch_size consecutive cycles in a single message.
+        LifecyclePublisher<ecat_msgs::msg::DataReceivedBatch, TLSFAllocator<void>>::SharedPtr feedback_batch_publisher_;
+        /// Publishes input-to-actuation latency of each input path at 1 Hz, not real-time.
+        LifecyclePublisher<ecat_msgs::msg::InputLatency, TLSFAllocator<void>>::SharedPtr input_latency_publisher_;
+        /// Runs only while active, cancelled in on_deactivate().
+        rclcpp::TimerBase::SharedPtr latency_timer_;
+        /// Writes phase trace of registered threads as Chrome JSON, \see phase_trace.hpp
+        rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr dump_phase_trace_service_;
+        /// Starts homing of all drives that support it, \see UpdateHoming()
+        rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr home_drives_service_;
+        /// Hands changed joint controller gains to cyclic thread, \see HandleParameterChange()
+        OnSetParametersCallbackHandle::SharedPtr parameter_callback_handle_;
         /// This subscriber  will be used to receive data from controller node.
-        rclcpp::Subscription<sensor_msgs::msg::Joy>::SharedPtr      joystick_subscriber_;
-        rclcpp::Subscription<std_msgs::msg::UInt8>::SharedPtr       gui_subscriber_;
-        rclcpp::Subscription<ecat_msgs::msg::HapticCmd>::SharedPtr  haptic_subscriber_; 
+        rclcpp::Subscription<sensor_msgs::msg::Joy, TLSFAllocator<void>>::SharedPtr      joystick_subscriber_;
+        rclcpp::Subscription<std_msgs::msg::UInt8, TLSFAllocator<void>>::SharedPtr       gui_subscriber_;
+        rclcpp::Subscription<ecat_msgs::msg::HapticCmd, TLSFAllocator<void>>::SharedPtr  haptic_subscriber_; 
 
         
-        ecat_msgs::msg::DataReceived     received_data_;
-        ecat_msgs::msg::DataSent         sent_data_;
+        ecat_msgs::msg::DataReceivedFixed  received_data_;
+        ecat_msgs::msg::DataSentFixed      sent_data_;
+        ecat_msgs::msg::DataReceivedBatch  feedback_batch_;
+        ecat_msgs::msg::InputLatency       input_latency_;
+        /// First master, control thread runs its cycle. Its slaves_ holds all slaves used by control logic.
         std::unique_ptr<EthercatNode>    ecat_node_;
+        /// Remaining masters, each with its own cyclic thread, \see secondary_master.hpp
+        std::vector<std::unique_ptr<SecondaryMaster>> secondary_masters_;
         
         
         /**
@@ -166,6 +216,39 @@ class EthercatLifeCycle : public LifecycleNode
          */
         int InitEthercatCommunication() ;
 
+        /**
+         * @brief Configures master, its slaves, PDOs and DC sync, activates master and registers its domain.
+         * @return 0 if succesful otherwise -1. 
+         */
+        int InitMaster(EthercatNode & node);
+
+        /**
+         * @brief Configures velocity estimator, joint controller and feedforward from parameters,
+         *        used by both EtherCAT and replay mode. Replay takes encoder resolution and
+         *        velocity_filter_theta from the replay file header instead.
+         * @return 0 if succesful, -1 if parameters are invalid.
+         */
+        int InitControllers();
+
+        /**
+         * @brief Builds gravity and friction model from "feedforward.*" parameters if feedforward is enabled.
+         * @return 0 if succesful or disabled, -1 if parameters are invalid.
+         */
+        int InitFeedforward();
+
+        /// Copies latest input images of secondary masters into images control logic reads from.
+        void ReceiveSecondaryImages();
+        /// Publishes images control logic wrote to, secondary masters send them on their next cycle.
+        void SendSecondaryImages();
+        /// @return Application layer states of slaves of all masters.
+        uint8_t GetAlStates() const;
+
+        /**
+         * @brief Points PDO views of slave drivers to slaves' current domain images and offsets. Has to be called
+         *        whenever they change, i.e. after domain registration and in replay mode.
+         */
+        void BindPdoViews();
+
         /**
          * @brief Helper function to enter pthread_create, since pthread's are C function it doesn't
          *        accept class member function, to pass class member function this helper function is 
@@ -190,7 +273,107 @@ class EthercatLifeCycle : public LifecycleNode
          * @return NULL
          */
         void StartPdoExchange(void *instance); 
+
+        /**
+         * @brief Enables drives and runs control loop until node is deactivated, then disables drives.
+         * 
+         * @param wake_up_time Wake up time of last cycle, carried between sessions to keep period.
+         * @param cycle_count  Cycle counter of cyclic thread, carried between sessions.
+         * @return 0 if node is deactivated and thread should go to standby, -1 if thread should exit
+         *         (shutdown, connection loss, real-time allocation or end of MEASURE_TIMING measurement).
+         */
+        int  RunControlSession(struct timespec & wake_up_time, uint64_t & cycle_count);
+
+        /**
+         * @brief Exchanges process data with drives disabled while node is inactive, so slaves stay
+         *        in OP and DC synchronized and activation doesn't need reconfiguration.
+         *        Master state is checked every second as in the control loop.
+         * 
+         * @return 0 if node is activated again, -1 if thread should exit or connection is lost.
+         */
+        int  Standby(struct timespec & wake_up_time, uint64_t & cycle_count);
+
+        /**
+         * @brief Makes cyclic thread leave, waits for it and releases masters. No-op if it isn't running.
+         */
+        void StopCyclicThread();
+
+        /**
+         * @brief Stops allocation tracking and logs executor allocations since activation.
+         */
+        void ReportExecutorAllocations();
         
+        /**
+         * @brief Publishes latency distribution of each input path, called by latency timer.
+         */
+        void PublishInputLatency();
+
+        /**
+         * @brief Handles "dump_phase_trace" service, writes last phase_trace_seconds of phase
+         *        trace to phase_trace_file. Response message contains written file path.
+         */
+        void HandleDumpPhaseTrace(const std::shared_ptr<std_srvs::srv::Trigger::Request> request,
+                                  std::shared_ptr<std_srvs::srv::Trigger::Response> response);
+
+        /**
+         * @brief Handles "home_drives" service, cyclic thread starts homing of all drives in its next cycle.
+         *        Fails if node isn't active.
+         */
+        void HandleHomeDrives(const std::shared_ptr<std_srvs::srv::Trigger::Request> request,
+                              std::shared_ptr<std_srvs::srv::Trigger::Response> response);
+
+        /**
+         * @brief Validates changed "cst_*" gain parameters and publishes them to joint controller,
+         *        cyclic thread uses them from its next cycle on. Other parameters are accepted as is.
+         */
+        rcl_interfaces::msg::SetParametersResult HandleParameterChange(const std::vector<rclcpp::Parameter> & parameters);
+
+        /**
+         * @brief Steps homing sequences of drives once per cycle after control logic, drives that are homing
+         *        get control word and mode of operation from their sequence and targets held at actual position.
+         *        Other drives aren't affected. Emergency stop or GUI halt aborts homing.
+         * @param start true if homing was requested since last cycle, \see homing_requested_
+         */
+        void UpdateHoming(bool start);
+
+        /**
+         * @brief Ends all homing sequences and writes operating mode of drives into process image.
+         */
+        void ResetHoming();
+
+        /**
+         * @brief Runs motor state machine and mode specific update/write functions for one cycle.
+         *        Shared by real-time loop and replay.
+         */
+        void UpdateControlLogic();
+
+        /**
+         * @brief Control logic and homing of one cycle, everything between reading feedback and
+         *        queueing outputs that decides the output image. Shared by real-time loop and replay.
+         */
+        void StepControl(bool homing_start);
+
+        /**
+         * @brief Opens recorded flight recorder file and points slaves' PDO domain and offsets
+         *        to the recorded ones, used instead of InitEthercatCommunication() in replay mode.
+         * @return 0 if succesful otherwise -1.
+         */
+        int InitReplay(const std::string & replay_file);
+
+        /**
+         * @brief Helper function to enter pthread_create for Replay(). \see PassCycylicExchange()
+         */
+        static void *PassReplay(void *arg);
+
+        /**
+         * @brief Feeds each recorded input image and input state through ReadFromSlaves() and
+         *        UpdateControlLogic() as fast as possible and compares resulting output image
+         *        bit-for-bit with the recorded one. State carried between cycles (commands,
+         *        motor states) is restored from the recording each cycle, so a mismatch points
+         *        to the exact cycle whose logic changed. Reports control path throughput.
+         */
+        void Replay();
+
         /**
          * @brief Gets  master's communication state.
          *  \see ec_al_state_t
@@ -205,7 +388,9 @@ class EthercatLifeCycle : public LifecycleNode
         void ReadFromSlaves();
         
         /**
-         * @brief Publishes all data that master received and will be sent
+         * @brief Publishes all data that master received and will be sent.
+         *        If RMW supports loaned messages data is written into middleware owned memory,
+         *        otherwise preallocated member messages are published without allocation.
          * 
          * @return 0 if succesfull otherwise -1. 
          */
@@ -264,8 +449,9 @@ class EthercatLifeCycle : public LifecycleNode
         void UpdateMotorStatePositionMode();
         
         /**
-         * @brief Updates cylic torque mode parameters based on controller inputs.
-         * 
+         * @brief Updates cylic torque mode parameters based on controller inputs. Joystick jogs position
+         *        references of enabled drives, torque targets are computed by joint controller and
+         *        torque offsets by gravity and friction feedforward.
          */
         void UpdateCyclicTorqueModeParameters();
         
@@ -307,21 +493,75 @@ class EthercatLifeCycle : public LifecycleNode
         struct sched_param ethercat_sched_param_ = {};
         pthread_attr_t ethercat_thread_attr_;
         int32_t err_;
+        /// CPU control thread is pinned to, -1 leaves affinity unchanged.
+        int control_cpu_ = -1;
+        /// Common start time of control and secondary master threads, keeps their cycles aligned.
+        struct timespec cycle_start_time_ = {};
         /// Application layer of slaves seen by master.(INIT/PREOP/SAFEOP/OP)
         uint8_t al_state_ = 0; 
         uint32_t motor_state_[g_kNumberOfServoDrivers];
+        /// Homing sequence of each drive, only accessed by cyclic thread.
+        HomingSequence homing_[g_kNumberOfServoDrivers];
+        /// Set by "home_drives" service, taken by cyclic thread.
+        std::atomic<bool> homing_requested_{false};
+        /// Velocity and acceleration of all drives from actual position, updated in ReadFromSlaves().
+        StateEstimator<g_kNumberOfServoDrivers> estimator_;
+        /// PD + feedforward controller of all drives in cyclic torque mode, gains are set from executor thread.
+        JointController<g_kNumberOfServoDrivers> joint_controller_;
+        /// Gravity and friction model in cyclic torque mode, NULL if disabled.
+        std::unique_ptr<TorqueFeedforward<g_kNumberOfServoDrivers>> feedforward_;
+        /// Torque offset of each drive in per thousand of rated torque, sent with target torque.
+        int16_t torque_offset_[g_kNumberOfServoDrivers] = {};
         uint32_t command_ = 0x004F;
         Controller controller_;
         /// Values will be sent by controller node and will be assigned to variables below.
         uint8_t gui_node_data_ = 1;
         uint8_t emergency_status_ = 1 ;
-        rclcpp::memory_strategy::MemoryStrategy::SharedPtr memory_strategy =
-        std::make_shared<AllocatorMemoryStrategy<TLSFAllocator<void>>>();
-        template<typename T = void>
-        using TLSFAllocator = tlsf_heap_allocator<T>;
+        /// True if both feedback publishers can borrow loaned messages from RMW.
+        bool loan_messages_ = false;
+        /// If false, feedback is only published in batches, \see PublishAllData()
+        bool per_cycle_feedback_ = true;
+        uint16_t feedback_batch_size_ = 10;
+        /// If true, control loop stops when cyclic thread allocates after warm-up.
+        bool fail_on_rt_allocation_ = false;
+        std::atomic<bool> rt_allocation_detected_{false};
+        /// Requested by on_activate/on_deactivate, cyclic thread runs control loop while set and standby otherwise.
+        std::atomic<bool> control_active_{false};
+        /// Cleared to make cyclic thread exit, \see StopCyclicThread()
+        std::atomic<bool> keep_exchanging_{true};
+        /// Set by cyclic thread while it exchanges process data with drives disabled.
+        std::atomic<bool> in_standby_{false};
+        /// Set by cyclic thread until it leaves, masters are released after that.
+        std::atomic<bool> exchange_running_{false};
+        bool cyclic_thread_started_ = false;
+        /// Time activation was requested, cyclic thread reports time until all drives are enabled.
+        struct timespec activation_request_time_ = {};
+        /// TLSF allocator shared by executor, publishers and subscriptions of this node.
+        std::shared_ptr<TLSFAllocator<void>> tlsf_allocator_ = std::make_shared<TLSFAllocator<void>>();
+        rclcpp::memory_strategy::MemoryStrategy::SharedPtr memory_strategy_ =
+        std::make_shared<AllocatorMemoryStrategy<TLSFAllocator<void>>>(tlsf_allocator_);
+        /// Preallocated messages for subscriptions, single message is enough for single threaded executor.
+        TLSFMessagePoolMemoryStrategy<sensor_msgs::msg::Joy, 1>::SharedPtr     joystick_msg_pool_ =
+        std::make_shared<TLSFMessagePoolMemoryStrategy<sensor_msgs::msg::Joy, 1>>(tlsf_allocator_);
+        TLSFMessagePoolMemoryStrategy<std_msgs::msg::UInt8, 1>::SharedPtr      gui_msg_pool_ =
+        std::make_shared<TLSFMessagePoolMemoryStrategy<std_msgs::msg::UInt8, 1>>(tlsf_allocator_);
+        TLSFMessagePoolMemoryStrategy<ecat_msgs::msg::HapticCmd, 1>::SharedPtr haptic_msg_pool_ =
+        std::make_shared<TLSFMessagePoolMemoryStrategy<ecat_msgs::msg::HapticCmd, 1>>(tlsf_allocator_);
         // Will be used as a parameter for taking timing measurements.
         std::int32_t measurement_time = 0 ; 
-        Timing timer_info_ ; 
+        Timing timer_info_ ;
+        /// Execution time histogram with page fault/context switch deltas per window, used if MEASURE_TIMING is set.
+        LoopStatistics loop_stats_; 
+        /// Input-to-actuation latency of joystick and haptic inputs.
+        LatencyTrace joystick_latency_;
+        LatencyTrace haptic_latency_;
+        /// Records PDO images and loop state of each cycle, enabled by "flight_recorder" parameter.
+        FlightRecorder flight_recorder_;
+        /// Replay mode state, \see Replay()
+        bool replay_mode_ = false;
+        std::atomic<bool> replay_failed_{false};
+        FlightRecordFile replay_file_;
+        std::vector<uint8_t> replay_domain_;
         HapticInputs haptic_inputs_;
 };
 }
\ No newline at end of file
@@ -42,6 +42,8 @@
 /// Forward declaration of EthercatSlave class.
 class EthercatSlave ;
 #include "ecat_slave.hpp"
+#include "slave_driver.hpp"
+#include <vector>
 /******************************************************************************/
 /// ROS2 Headers
 #include <rclcpp/rclcpp.hpp>
@@ -52,12 +54,29 @@ namespace EthercatCommunication
 class EthercatNode
 {
     public:
-        EthercatNode();
+/**
+ * @brief Constructs wrapper for one EtherCAT master.
+ * 
+ * @param master_index Index of the master as configured in /etc/ethercat.conf (MASTER0_DEVICE etc.)
+ * @param first_slave  Index of first slave of this master in slaves_, slaves are numbered over all masters.
+ * @param num_of_slaves Number of slaves connected to this master.
+ */
+        EthercatNode(uint32_t master_index = 0, int first_slave = 0, int num_of_slaves = NUM_OF_SLAVES);
         ~EthercatNode();
+    /// Indexed by global slave index, only [first_slave, first_slave + num_of_slaves) belong to this master.
     EthercatSlave slaves_[NUM_OF_SLAVES];
+    /// Drivers of all slaves on the bus, configuration only touches slaves of this master.
+    SlaveDriver::Drivers drivers_;
+    /// EtherCAT master instance.
+    ec_master_t        * master_ = NULL;
+    /// EtherCAT master state.
+    ec_master_state_t    master_state_ = {};
+    /// Ethercat data passing master domain.
+    ec_domain_t        * master_domain_ = NULL;
+    /// EtherCAT master domain state.
+    ec_domain_state_t    master_domain_state_ = {};
 /**
  * @brief Requests master instance and creates a domain for a master.
- * @note  Keep in mind that created master and domain are global variables.
  * @return 0 if succesful otherwise -1.
  */
     int  ConfigureMaster();
@@ -158,7 +177,16 @@ class EthercatNode
     int SetCyclicSyncTorqueModeParametersAll(CSTorqueModeParam &P);
 
 /**
- * @brief Maps default PDOs for our spine surgery robot implementation.
+ * @brief Sets homing parameters of all servo drives of this master. They are queued together with
+ *        operation mode parameters, so call this before Set*ParametersAll().
+ * 
+ * @param P Homing parameters, only homing specific objects are written \see ConfigureCia402Sdos()
+ */
+    void SetHomingParametersAll(const HomingParam &P);
+
+/**
+ * @brief Maps default PDOs for our spine surgery robot implementation through drivers in \see slave_driver.hpp
+ *        Servo drives use SlaveDriver::MaxonEpos4Driver and custom slave uses SlaveDriver::EasyCatDriver.
  * @note This method is specific for our spinerobot implementation.
  * If you have different topology or different servo drives use 
  * \see MapCustomPdos() function of modify this function based on your needs.
@@ -173,6 +201,13 @@ class EthercatNode
  * @return 0 if succesfull, -1 otherwise.
  */
     int MapCustomPdos(EthercatSlave c_slave, int position);
+/**
+ * @brief Enables SDO parameter cache, Set*ParametersAll() functions only queue parameters drives don't already hold.
+ * 
+ * @param file Cache file, created if it doesn't exist.
+ * @return 0 if succesful, otherwise -1 and all parameters are written.
+ */
+    int OpenSdoCache(const std::string & file);
 /**
  * @brief Configures DC sync for our default configuration
  * 
@@ -226,6 +261,14 @@ class EthercatNode
  * @return 0 if succesfull, otherwise -1.
  */
     int  WaitForOperationalMode();
+/**
+ * @brief Same as WaitForOperationalMode() for several masters in a single exchange loop.
+ *        Masters which reach OP first keep exchanging frames until all of them are in OP,
+ *        so their slaves don't drop out of OP because of the sync manager watchdog.
+ *        If timeout occurs all given masters are released.
+ * @return 0 if succesfull, otherwise -1.
+ */
+    static int WaitForOperationalMode(const std::vector<EthercatNode*> & nodes);
 
 /**
  * @brief Opens EtherCAT master via command line tool if it's not already on.
@@ -259,9 +302,53 @@ class EthercatNode
  * @return 0 if succesfull, otherwise -1.
  */ 
     int ShutDownEthercatMaster();
+
+    /// @return Index of this master in /etc/ethercat.conf.
+    uint32_t GetMasterIndex() const { return master_index_; }
+    /// @return Global index of first slave of this master.
+    int GetFirstSlave() const { return first_slave_; }
+    /// @return One past global index of last slave of this master.
+    int GetEndSlave() const { return end_slave_; }
+    /// @return true if slave with global index belongs to this master.
+    bool HasSlave(int position) const { return position >= first_slave_ && position < end_slave_; }
     private:
     /// File descriptor to open and wake  master from CLI.
     int  fd;
-    
+    uint32_t master_index_;
+    int first_slave_;
+    int end_slave_;
+    /// Skips parameters drives already hold if opened, \see OpenSdoCache()
+    SdoParameterCache sdo_cache_;
+    /// Homing parameters of slaves are added to startup SDOs, \see SetHomingParametersAll()
+    bool homing_configured_ = false;
+    /// Queues startup SDOs of parameter set P on servo drives of this master.
+    template <typename P>
+    int ConfigureDriveSdos(const P & params)
+    {
+        int err = 0;
+        drivers_.ForEachDrive([this, &err, &params](auto & driver, int i){
+            if(!err && HasSlave(i)){
+                SdoParameterSet sdos;
+                err = driver.ConfigureSdos(sdos, params);
+                if(!err && homing_configured_){
+                    err = driver.ConfigureSdos(sdos, slaves_[i].homing_param_);
+                }
+                if(!err){
+                    err = QueueSdos(i, sdos, std::decay<decltype(driver)>::type::kCachesSdos);
+                }
+            }
+        });
+        if(!err && sdo_cache_.IsOpen()){
+            // Cache is only an optimization, drives hold the hash of what they were given.
+            sdo_cache_.Save();
+        }
+        return err;
+    }
+    /**
+     * @brief Queues startup SDOs of slave, through SDO cache if it's open and slave supports it.
+     * @return 0 if succesful, otherwise -1.
+     */
+    int QueueSdos(int position, const SdoParameterSet & sdos, bool cacheable);
+
 };
 }
\ No newline at end of file
@@ -0,0 +1,265 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  flight_recorder.hpp
+ * \brief Binary recorder of PDO images and control loop state.
+ *
+ * Each cycle the control thread copies raw domain image (after domain process 
+ * and before queue), decoded feedback/command messages, input state and cycle
+ * timestamps into a slot of a preallocated single producer/single consumer ring.
+ * A background thread moves records into a set of preallocated, memory mapped
+ * files and rotates them, oldest file is overwritten when the set is full.
+ * Writer sleeps on a futex, control thread wakes it once kWakeUpBatch records
+ * are pending, so it runs a few times per second instead of polling. While
+ * idle it only wakes up every kIdleTimeoutMs to flush remaining records.
+ *
+ * File layout : FileHeader, padded to kFileHeaderSize, followed by records of
+ * FileHeader::record_size bytes. Each record is CycleRecord followed by input 
+ * and output domain images of FileHeader::domain_size bytes each.
+ *
+ * FlightRecordFile maps a recorded file read-only for offline replay.
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "ecat_globals.hpp"
+#include "ecat_slave.hpp"
+#include "state_estimator.hpp"
+#include "joint_controller.hpp"
+#include "torque_feedforward.hpp"
+#include "homing.hpp"
+#include "ecat_msgs/msg/data_received_fixed.hpp"
+#include "ecat_msgs/msg/data_sent_fixed.hpp"
+
+class FlightRecorder
+{
+    public:
+        static const uint32_t kFileMagic      = 0x52464345;   /// "ECFR" in little endian.
+        static const uint32_t kFileVersion    = 6;
+        /// Number of ring slots, gives writer thread ~2 seconds of slack at 1 kHz.
+        static const uint32_t kNumOfSlots     = 2048;
+        /// Pending records that make control thread wake writer up, one syscall every 64 cycles.
+        static const uint32_t kWakeUpBatch    = 64;
+        /// Writer wakes up by itself after this time, so records of a stopped loop get written too.
+        static const uint32_t kIdleTimeoutMs  = 100;
+
+        /// Written at the beginning of each file.
+        struct FileHeader
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t header_size;
+            uint32_t record_size;
+            uint32_t domain_size;
+            uint32_t frequency;
+            uint32_t num_of_slaves;
+            uint32_t num_of_servo_drives;
+            uint64_t sequence;          /// Increases on each rotation, gives order of files in the set.
+            uint64_t num_of_records;    /// Valid records in this file, updated by writer thread.
+            OffsetPDO offsets[NUM_OF_SLAVES];
+            /// Velocity estimator configuration of the recording, replay is configured from it.
+            EstimatorParameters<g_kNumberOfServoDrivers> estimator;
+            /// Torque feedforward model of the recording if it was enabled, replay is configured from it.
+            uint8_t feedforward_enabled;
+            FeedforwardModel<g_kNumberOfServoDrivers> feedforward;
+        };
+        /// Header area in front of records, whole pages so records start page aligned.
+        static const uint32_t kFileHeaderSize = (sizeof(FileHeader) + 4095) & ~4095u;
+
+        /// Fixed part of each record, domain images follow it.
+        struct CycleRecord
+        {
+            uint64_t cycle;
+            int64_t  wake_up_ns;
+            int64_t  start_ns;
+            int64_t  end_ns;
+            /// Input state used by control logic in this cycle.
+            Controller   controller;
+            HapticInputs haptic_inputs;
+            uint32_t     motor_state[g_kNumberOfServoDrivers];
+            uint32_t     command;
+            uint8_t      gui_node_data;
+            uint8_t      emergency_status;
+            uint8_t      al_state;
+            /// Velocity estimator state after this cycle's update, replay continues from it.
+            EstimatorState<g_kNumberOfServoDrivers> estimator;
+            /// Joint controller references before this cycle's update and gains it used in this cycle.
+            JointControllerState<g_kNumberOfServoDrivers> joint_controller;
+            JointGains<g_kNumberOfServoDrivers>           joint_gains;
+            /// Homing sequences before this cycle's update and whether homing was requested in it.
+            HomingSequence homing[g_kNumberOfServoDrivers];
+            uint8_t        homing_start;
+            /// Decoded feedback and commands.
+            ecat_msgs::msg::DataReceivedFixed received_data;
+            ecat_msgs::msg::DataSentFixed     sent_data;
+        };
+        static_assert(std::is_trivially_copyable<CycleRecord>::value, "Records are copied into files byte by byte.");
+
+        ~FlightRecorder();
+
+        /// Record stride for given domain size, records are cache line aligned.
+        static uint32_t GetRecordSize(uint32_t domain_size)
+        {
+            return (sizeof(CycleRecord) + 2 * domain_size + 63) & ~63u;
+        }
+
+    /**
+     * @brief Preallocates ring and first file, starts writer thread. Not real-time safe.
+     * @param directory Directory of the file set, created if it doesn't exist.
+     * @param num_of_files Number of files in rotating set.
+     * @param records_per_file Number of records(cycles) per file.
+     * @param domain_size Size of the process data image, \see ecrt_domain_size()
+     * @param slaves Slave array to get PDO offsets from.
+     * @param estimator Velocity estimator configuration, stored in file headers.
+     * @param feedforward Torque feedforward model stored in file headers, nullptr if it's disabled.
+     * @return 0 if succesful, -1 otherwise.
+     */
+        int Open(const std::string & directory, uint32_t num_of_files, uint32_t records_per_file,
+                 uint32_t domain_size, const EthercatSlave * slaves,
+                 const EstimatorParameters<g_kNumberOfServoDrivers> & estimator,
+                 const FeedforwardModel<g_kNumberOfServoDrivers> * feedforward);
+
+    /**
+     * @brief Stops writer thread after remaining records are written and closes file.
+     */
+        void Close();
+
+        bool IsOpen() const { return running_; }
+
+    /**
+     * @brief Reserves next ring slot for this cycle. Real-time safe.
+     * @return Record to be filled, nullptr if recorder isn't open or ring is full.
+     */
+        CycleRecord * BeginRecord();
+
+    /**
+     * @brief Copies domain image into reserved slot. Real-time safe.
+     */
+        void SaveInputImage(const uint8_t * domain_data);
+        void SaveOutputImage(const uint8_t * domain_data);
+
+    /**
+     * @brief Publishes reserved slot to writer thread. Real-time safe.
+     */
+        void CommitRecord();
+
+        /// Number of records dropped since ring was full.
+        uint64_t GetDroppedRecords() const { return dropped_records_.load(std::memory_order_relaxed); }
+
+    private:
+        void WriterLoop();
+        /// Control thread side : wakes writer if it sleeps and enough records are pending.
+        void WakeUpWriter(uint64_t head);
+        /// Writer side : sleeps until woken up or kIdleTimeoutMs elapsed.
+        void WaitForRecords();
+        /// Creates and allocates all files of the set, not real-time safe.
+        int  PreallocateFiles();
+        /// Writer side : maps next file of the set, files are only mapped at rotation.
+        int  OpenNextFile();
+        /// Writer side : unmaps current file.
+        void CloseFile();
+        /// Unmaps current file and closes all files of the set.
+        void CloseFiles();
+
+        std::string directory_;
+        uint32_t num_of_files_     = 0;
+        uint32_t records_per_file_ = 0;
+        uint32_t record_size_      = 0;
+        FileHeader header_ = {};
+
+        /// Ring memory, kNumOfSlots * record_size_ bytes.
+        uint8_t * ring_ = nullptr;
+        uint8_t * current_slot_ = nullptr;
+        std::atomic<uint64_t> head_{0};     /// Written by control thread.
+        std::atomic<uint64_t> tail_{0};     /// Written by writer thread.
+        std::atomic<uint64_t> dropped_records_{0};
+        /// Futex word, 1 while writer sleeps or is about to sleep.
+        std::atomic<int> writer_sleeping_{0};
+
+        /// Mapped file state, only used by writer thread.
+        std::vector<int> file_fds_;     /// Preallocated file set, opened in Open().
+        uint8_t * file_map_ = nullptr;
+        size_t    file_size_ = 0;
+        uint64_t  file_sequence_ = 0;
+        uint64_t  records_in_file_ = 0;
+
+        std::thread writer_thread_;
+        std::atomic<bool> running_{false};
+};
+
+/******************************************************************************
+ *  \class   FlightRecordFile
+ *  \brief   Read-only access to a single file written by FlightRecorder.
+ *******************************************************************************/
+class FlightRecordFile
+{
+    public:
+        ~FlightRecordFile();
+
+    /**
+     * @brief Maps given file and validates its header against this build.
+     * @return 0 if succesful, -1 otherwise.
+     */
+        int Open(const std::string & path);
+        void Close();
+
+        const FlightRecorder::FileHeader & GetHeader() const { return *header_; }
+        uint64_t GetNumOfRecords() const { return header_->num_of_records; }
+
+        const FlightRecorder::CycleRecord * GetRecord(uint64_t index) const
+        {
+            return reinterpret_cast<const FlightRecorder::CycleRecord*>(RecordData(index));
+        }
+        const uint8_t * GetInputImage(uint64_t index) const
+        {
+            return RecordData(index) + sizeof(FlightRecorder::CycleRecord);
+        }
+        const uint8_t * GetOutputImage(uint64_t index) const
+        {
+            return RecordData(index) + sizeof(FlightRecorder::CycleRecord) + header_->domain_size;
+        }
+
+    private:
+        const uint8_t * RecordData(uint64_t index) const
+        {
+            return map_ + header_->header_size + index * header_->record_size;
+        }
+
+        int       fd_ = -1;
+        uint8_t * map_ = nullptr;
+        size_t    map_size_ = 0;
+        const FlightRecorder::FileHeader * header_ = nullptr;
+};
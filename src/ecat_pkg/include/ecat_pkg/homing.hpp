@@ -0,0 +1,116 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  homing.hpp
+ * \brief Non-blocking CiA402 homing sequence of one servo drive.
+ *
+ * Sequence is stepped once per cycle from the control loop with the drive's
+ * status word and mode of operation display, and gives control word and mode
+ * of operation to send in that cycle. So drives home concurrently and the
+ * loop keeps exchanging PDOs for axes that aren't homing.
+ *
+ * Steps : switch mode of operation to homing, set "homing operation start"
+ * (control word bit 4), wait for "homing attained" and "target reached"
+ * (status word bit 12 and 10) or "homing error" (bit 13), then switch back to
+ * the operating mode with bit 4 cleared. Drive has to stay in operation
+ * enabled while homing, homing parameters are startup SDOs,
+ * \see EthercatNode::SetHomingParametersAll()
+ *******************************************************************************/
+#pragma once
+
+#include "ecat_globals.hpp"
+
+class HomingSequence
+{
+    public:
+        enum State
+        {
+            kIdle = 0,
+            kSwitchingToHoming,
+            kStarting,
+            kRunning,
+            kSwitchingBack,
+            kAttained,
+            kFailed
+        };
+        enum Result
+        {
+            kNone = 0,
+            kSuccess,
+            kTimeout,
+            kHomingError,
+            kDriveDisabled,
+            kAborted
+        };
+        /// Status word bits in homing mode.
+        enum StatusBits
+        {
+            kTargetReachedBit  = 10,
+            kHomingAttainedBit = 12,
+            kHomingErrorBit    = 13
+        };
+        /**
+         * @brief Sets mode drive returns to after homing and homing timeout.
+         * @param timeout_cycles Cycles from Start() until homing has to be attained.
+         */
+        void Configure(int8_t operating_mode, uint32_t timeout_cycles);
+        /// Starts homing, @return 0 if started, -1 if sequence is already running.
+        int Start();
+        /// Stops homing (bit 4 cleared) and switches back to operating mode, sequence ends as failed.
+        void Abort();
+        /// Ends sequence immediately and commands operating mode, e.g. when cyclic exchange stops.
+        void Reset();
+        /// Steps sequence with this cycle's inputs, outputs are read with GetControlWord()/GetOperationMode().
+        void Update(uint16_t status_word, int8_t mode_display);
+
+        /// @return true while sequence decides control word and mode of the drive.
+        bool IsActive() const { return state_ >= kSwitchingToHoming && state_ <= kSwitchingBack; }
+        State GetState() const { return state_; }
+        Result GetResult() const { return result_; }
+        uint16_t GetControlWord() const { return control_word_; }
+        int8_t GetOperationMode() const { return op_mode_; }
+        /// Cycles since Start(), total homing time once sequence has ended.
+        uint32_t GetCycles() const { return cycles_; }
+        static const char * ResultName(Result result);
+    private:
+        /// Fails homing and switches back to operating mode.
+        void Fail(Result result);
+
+        State    state_ = kIdle;
+        Result   result_ = kNone;
+        int8_t   operating_mode_ = kCSVelocity;
+        int8_t   op_mode_ = kCSVelocity;
+        uint16_t control_word_ = SM_GO_ENABLE;
+        uint32_t timeout_cycles_ = 0;
+        uint32_t cycles_ = 0;
+        uint32_t start_cycle_ = 0;
+        uint32_t switch_back_cycle_ = 0;
+};
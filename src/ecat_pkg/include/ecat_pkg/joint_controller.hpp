@@ -0,0 +1,201 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  joint_controller.hpp
+ * \brief Joint-space PD controller with velocity and acceleration feedforward
+ *        for cyclic synchronous torque mode.
+ *
+ * Torque target of each axis is
+ *   tau = kp (q_ref - q) + kd (v_ref - v) + kv v_ref + ka a_ref
+ * clamped to +-max_torque. Gains, setpoints and outputs are one array per
+ * quantity over all axes (structure of arrays), Compute() is one branch free
+ * loop over the axes that the compiler vectorizes.
+ *
+ * Units are the drive's : position in increments, velocity in rpm,
+ * acceleration in rpm/s, torque in per thousand of motor rated torque.
+ *
+ * Gains are changed from the executor thread (ROS parameters) while the
+ * cyclic thread runs, they are handed over with a triple buffer, so neither
+ * side blocks or sees a partially written gain set, \see triple_buffer.hpp
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+#include "triple_buffer.hpp"
+
+/// Gains of all axes, \see JointController
+template <size_t N>
+struct JointGains
+{
+    float kp[N] = {};             /// per thousand / increment
+    float kd[N] = {};             /// per thousand / rpm
+    float kv[N] = {};             /// per thousand / rpm, velocity feedforward (friction, back EMF)
+    float ka[N] = {};             /// per thousand / (rpm/s), acceleration feedforward (inertia)
+    float max_torque[N] = {};     /// per thousand, output limit
+};
+
+/// Reference trajectory of all axes for the current cycle.
+template <size_t N>
+struct JointSetpoints
+{
+    int32_t pos[N] = {};
+    int32_t vel[N] = {};
+    float   acc[N] = {};
+};
+
+/// Reference state of all axes, plain data so flight recorder can store it for replay.
+template <size_t N>
+struct JointControllerState
+{
+    JointSetpoints<N> setpoints;
+    /// Position reference with fraction of increment, so slow jogging doesn't stall.
+    double  jog_pos[N];
+    /// Axes whose reference was set by Hold() since they were last released.
+    uint8_t held[N];
+};
+
+template <size_t N>
+class JointController
+{
+    public:
+        /**
+         * @param increments_per_rev Encoder increments per motor revolution, used to
+         *                           integrate velocity references into position references.
+         * @param frequency          Control loop frequency in Hz.
+         */
+        void Configure(double increments_per_rev, uint32_t frequency)
+        {
+            increments_per_rpm_cycle_ = increments_per_rev / 60.0 / frequency;
+            frequency_ = frequency;
+        }
+
+        /// Executor thread : gains the cyclic thread uses from its next AcquireGains() on.
+        void SetGains(const JointGains<N> & gains)
+        {
+            gains_.Write() = gains;
+            gains_.Publish();
+            last_gains_ = gains;
+        }
+        /// Executor thread : gains last passed to SetGains().
+        const JointGains<N> & GetGains() const { return last_gains_; }
+
+        /// Cyclic thread : takes gains published since last call, @return true if they changed.
+        bool AcquireGains() { return gains_.Acquire(); }
+        /// Cyclic thread : gains Compute() uses, last acquired ones.
+        const JointGains<N> & GetActiveGains() const { return gains_.Read(); }
+        /**
+         * @brief Replay : makes recorded gains the active ones, \see EthercatLifeCycle::Replay()
+         *        Uses writer side of gain exchange, SetGains() mustn't run at the same time.
+         */
+        void SetActiveGains(const JointGains<N> & gains)
+        {
+            gains_.Write() = gains;
+            gains_.Publish();
+            gains_.Acquire();
+        }
+
+        /**
+         * @brief Cyclic thread : sets reference of one axis to its actual position at rest.
+         *        Has to be called when an axis is enabled, so it starts without a jump.
+         */
+        void Hold(size_t axis, int32_t actual_pos)
+        {
+            state_.jog_pos[axis]       = actual_pos;
+            state_.setpoints.pos[axis] = actual_pos;
+            state_.setpoints.vel[axis] = 0;
+            state_.setpoints.acc[axis] = 0;
+            state_.held[axis]          = 1;
+        }
+
+        /**
+         * @brief Cyclic thread : invalidates reference of an axis that isn't controlled any more.
+         *        Its torque is 0 and it doesn't jog until it's held again.
+         */
+        void Release(size_t axis) { state_.held[axis] = 0; }
+
+        /// Cyclic thread : whether axis has a valid reference, \see Hold()
+        bool IsHeld(size_t axis) const { return state_.held[axis]; }
+
+        /**
+         * @brief Cyclic thread : moves reference of one axis with given velocity for one cycle,
+         *        acceleration feedforward is the change of velocity reference. Axes that
+         *        aren't held keep their invalid reference, it would pull them to encoder zero.
+         */
+        void Jog(size_t axis, int32_t velocity)
+        {
+            if(!state_.held[axis]){
+                return;
+            }
+            JointSetpoints<N> & sp = state_.setpoints;
+            state_.jog_pos[axis] += velocity * increments_per_rpm_cycle_;
+            sp.acc[axis] = float(velocity - sp.vel[axis]) * frequency_;
+            sp.vel[axis] = velocity;
+            sp.pos[axis] = int32_t(state_.jog_pos[axis]);
+        }
+
+        /// Cyclic thread : setpoints can also be written directly, e.g. by a trajectory generator.
+        JointSetpoints<N> & Setpoints() { return state_.setpoints; }
+
+        const JointControllerState<N> & GetState() const { return state_; }
+        /// Continues from a recorded state, \see EthercatLifeCycle::Replay()
+        void SetState(const JointControllerState<N> & state) { state_ = state; }
+
+        /**
+         * @brief Cyclic thread : computes torque targets of all N axes from actual
+         *        position and estimated velocity with last acquired gains, 0 for axes
+         *        that aren't held.
+         */
+        void Compute(const int32_t * actual_pos, const float * velocity, int16_t * target_tor) const
+        {
+            const JointGains<N> & g = gains_.Read();
+            const JointSetpoints<N> & sp = state_.setpoints;
+            for(size_t i = 0 ; i < N ; i++){
+                // Integer difference first, wraps correctly when encoder overflows.
+                const float pos_err = float(int32_t(uint32_t(sp.pos[i]) - uint32_t(actual_pos[i])));
+                const float vel_err = float(sp.vel[i]) - velocity[i];
+                const float tau = g.kp[i] * pos_err + g.kd[i] * vel_err +
+                                  g.kv[i] * float(sp.vel[i]) + g.ka[i] * sp.acc[i];
+                const float limited = std::min(std::max(tau, -g.max_torque[i]), g.max_torque[i]);
+                target_tor[i] = int16_t(state_.held[i] ? limited : 0.0f);
+            }
+        }
+
+    private:
+        TripleBuffer<JointGains<N>> gains_;
+        JointGains<N> last_gains_;
+        JointControllerState<N> state_ = {};
+        double increments_per_rpm_cycle_ = 0;
+        float  frequency_ = 0;
+};
@@ -0,0 +1,415 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  kinematics.hpp
+ * \brief Allocation-free kinematics of serial robots given as a DH table.
+ *
+ * SerialChain<N> gives forward kinematics, geometric Jacobian, position
+ * inverse kinematics (damped least squares) and gravity torques for N joints. All of them work
+ * on fixed-size arrays on the stack, so they can be called in the 1 kHz loop.
+ *
+ * Batch functions evaluate thousands of configurations, e.g. for workspace
+ * analysis or checking a planned trajectory. Inputs and outputs are one array
+ * per coordinate (structure of arrays). ForwardBatch() processes samples in
+ * blocks of kBlock, its inner loops run over samples of a block without
+ * branches and are marked "omp simd", so they vectorize across samples with
+ * the package's -O2 -fopenmp-simd. libm's sin/cos are calls that stop
+ * vectorization without -ffast-math, block loops use SinCos() instead.
+ *
+ * Lengths are in mm, angles in radians, standard DH convention :
+ * T_i = Rot_z(theta_i) Trans_z(d_i) Trans_x(a_i) Rot_x(alpha_i)
+ *******************************************************************************/
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+namespace Kinematics
+{
+/// DH parameters of one joint and its limits, joint variable is added to theta or d.
+struct DhLink
+{
+    double a;
+    double alpha;
+    double d;
+    double theta;
+    bool   prismatic;
+    double q_min;
+    double q_max;
+};
+
+/// Frame in base coordinates, x/y/z are its axes and p its origin.
+struct Frame
+{
+    double x[3];
+    double y[3];
+    double z[3];
+    double p[3];
+};
+
+/// Options of position inverse kinematics.
+struct IkOptions
+{
+    int    max_iterations = 50;
+    /// Position error in mm at which solution is accepted.
+    double tolerance = 1e-3;
+    /// Damping, keeps steps bounded near singularities at the cost of slower convergence.
+    double damping = 1e-2;
+};
+
+/// Mass of the link moved by a joint, center of mass is given in the joint's DH frame (after its transform).
+struct LinkMass
+{
+    double mass;
+    double com[3];
+};
+
+/**
+ * sin and cos of x, branch free so loops over it vectorize. Argument is reduced
+ * to [-pi/4, pi/4] with a three part pi/2 (exact for |x| < 1e5) and fdlibm's
+ * kernel polynomials are evaluated on it, error is within a few ulp of libm.
+ */
+inline void SinCos(double x, double & sin_x, double & cos_x)
+{
+    // Rounds to nearest integer with plain arithmetic, valid for |x| < 2^51, no libm call.
+    const double kRound = 6755399441055744.0;
+    const double k = (x * 6.36619772367581382433e-01 + kRound) - kRound;
+    const int32_t quadrant = int32_t(k);
+    const double r = ((x - k * 1.57079632673412561417e+00) - k * 6.07710050630396597660e-11)
+                     - k * 2.02226624871116645580e-21;
+    const double z = r * r;
+    const double sin_r = r + r * z * (-1.66666666666666324348e-01 + z * (8.33333333332248946124e-03 +
+                         z * (-1.98412698298579493134e-04 + z * (2.75573137070700676789e-06 +
+                         z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+    const double cos_r = 1.0 - 0.5 * z + z * z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 +
+                         z * (2.48015872894767294178e-05 + z * (-2.75573143513906633035e-07 +
+                         z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+    // x = quadrant pi/2 + r : odd quadrants swap sin and cos, quadrants 2,3 negate sin and 1,2 negate cos.
+    const bool swap = quadrant & 1;
+    const double s = swap ? cos_r : sin_r;
+    const double c = swap ? sin_r : cos_r;
+    sin_x = (quadrant & 2) ? -s : s;
+    cos_x = ((quadrant + 1) & 2) ? -c : c;
+}
+
+template <int N>
+class SerialChain
+{
+    public:
+        static constexpr int kNumOfJoints = N;
+        /// Samples batch functions process together, a block's working set stays in L1 cache.
+        static constexpr int kBlock = 64;
+
+        explicit SerialChain(const DhLink (&links)[N])
+        {
+            for(int i = 0 ; i < N ; i++){
+                links_[i] = links[i];
+                cos_alpha_[i] = std::cos(links[i].alpha);
+                sin_alpha_[i] = std::sin(links[i].alpha);
+            }
+        }
+        const DhLink & GetLink(int i) const { return links_[i]; }
+
+        /// Computes tool frame for joint values q.
+        void Forward(const double (&q)[N], Frame & tip) const
+        {
+            SetIdentity(tip);
+            for(int i = 0 ; i < N ; i++){
+                Append(tip, i, q[i]);
+            }
+        }
+        /**
+         * @brief Computes geometric Jacobian in base frame, rows are vx, vy, vz, wx, wy, wz.
+         *        Tool frame is computed on the way and returned in tip.
+         */
+        void Jacobian(const double (&q)[N], double (&jac)[6][N], Frame & tip) const
+        {
+            double axis[N][3], origin[N][3];
+            SetIdentity(tip);
+            for(int i = 0 ; i < N ; i++){
+                for(int k = 0 ; k < 3 ; k++){
+                    axis[i][k]   = tip.z[k];
+                    origin[i][k] = tip.p[k];
+                }
+                Append(tip, i, q[i]);
+            }
+            for(int i = 0 ; i < N ; i++){
+                const double * z = axis[i];
+                if(links_[i].prismatic){
+                    for(int k = 0 ; k < 3 ; k++){
+                        jac[k][i]     = z[k];
+                        jac[k + 3][i] = 0;
+                    }
+                }else{
+                    const double r[3] = {tip.p[0] - origin[i][0], tip.p[1] - origin[i][1], tip.p[2] - origin[i][2]};
+                    jac[0][i] = z[1] * r[2] - z[2] * r[1];
+                    jac[1][i] = z[2] * r[0] - z[0] * r[2];
+                    jac[2][i] = z[0] * r[1] - z[1] * r[0];
+                    for(int k = 0 ; k < 3 ; k++){
+                        jac[k + 3][i] = z[k];
+                    }
+                }
+            }
+        }
+        /**
+         * @brief Joint torques that hold the chain still against gravity, i.e. -J_c^T m g summed over links.
+         *        Links are accumulated from the tool backwards, so it costs one forward pass.
+         * @param gravity Gravity acceleration in base frame in m/s^2, e.g. {0, 0, -9.81}.
+         * @param tau     Nm for revolute and N for prismatic joints.
+         */
+        void GravityTorque(const double (&q)[N], const LinkMass (&links)[N], const double (&gravity)[3],
+                           double (&tau)[N]) const
+        {
+            double axis[N][3], origin[N][3], com[N][3];
+            Frame f;
+            SetIdentity(f);
+            for(int i = 0 ; i < N ; i++){
+                for(int k = 0 ; k < 3 ; k++){
+                    axis[i][k]   = f.z[k];
+                    origin[i][k] = f.p[k];
+                }
+                Append(f, i, q[i]);
+                const double * c = links[i].com;
+                for(int k = 0 ; k < 3 ; k++){
+                    com[i][k] = f.p[k] + c[0] * f.x[k] + c[1] * f.y[k] + c[2] * f.z[k];
+                }
+            }
+            // Mass and first moment (kg mm) of links i..N-1.
+            double m = 0, mc[3] = {0, 0, 0};
+            for(int i = N - 1 ; i >= 0 ; i--){
+                m += links[i].mass;
+                for(int k = 0 ; k < 3 ; k++){
+                    mc[k] += links[i].mass * com[i][k];
+                }
+                const double * z = axis[i];
+                if(links_[i].prismatic){
+                    tau[i] = -m * (z[0] * gravity[0] + z[1] * gravity[1] + z[2] * gravity[2]);
+                }else{
+                    const double r[3] = {mc[0] - m * origin[i][0], mc[1] - m * origin[i][1], mc[2] - m * origin[i][2]};
+                    const double t[3] = {z[1] * r[2] - z[2] * r[1], z[2] * r[0] - z[0] * r[2], z[0] * r[1] - z[1] * r[0]};
+                    tau[i] = -1e-3 * (t[0] * gravity[0] + t[1] * gravity[1] + t[2] * gravity[2]);
+                }
+            }
+        }
+        /**
+         * @brief Solves joint values that bring tool origin to target, starting from q. Joint limits are enforced.
+         * @return Number of iterations taken, -1 if target wasn't reached within options.max_iterations.
+         *         q holds last iterate in either case.
+         */
+        int Inverse(const double (&target)[3], double (&q)[N], const IkOptions & options = IkOptions()) const
+        {
+            double jac[6][N];
+            Frame tip;
+            for(int it = 0 ; ; it++){
+                Jacobian(q, jac, tip);
+                double e[3];
+                for(int k = 0 ; k < 3 ; k++){
+                    e[k] = target[k] - tip.p[k];
+                }
+                if(e[0] * e[0] + e[1] * e[1] + e[2] * e[2] <= options.tolerance * options.tolerance){
+                    return it;
+                }
+                if(it == options.max_iterations){
+                    return -1;
+                }
+                // dq = J^T (J J^T + l^2 I)^-1 e, with 3x3 system of position rows.
+                double a[6];
+                Gram(jac, options.damping, a);
+                double w[3];
+                Solve3(a, e, w);
+                for(int i = 0 ; i < N ; i++){
+                    q[i] += jac[0][i] * w[0] + jac[1][i] * w[1] + jac[2][i] * w[2];
+                    q[i] = std::min(std::max(q[i], links_[i].q_min), links_[i].q_max);
+                }
+            }
+        }
+        /**
+         * @brief Tool positions of count configurations.
+         * @param q Joint values, q[i][s] is joint i of sample s.
+         * @param x,y,z Tool position of each sample.
+         */
+        void ForwardBatch(const double * const q[N], size_t count, double * x, double * y, double * z) const
+        {
+            BlockFrames f;
+            for(size_t begin = 0 ; begin < count ; begin += kBlock){
+                const int n = int(std::min<size_t>(kBlock, count - begin));
+                const double * qb[N];
+                for(int i = 0 ; i < N ; i++){
+                    qb[i] = q[i] + begin;
+                }
+                ForwardBlock(qb, n, f);
+                std::copy(f.p[0], f.p[0] + n, x + begin);
+                std::copy(f.p[1], f.p[1] + n, y + begin);
+                std::copy(f.p[2], f.p[2] + n, z + begin);
+            }
+        }
+        /**
+         * @brief Position inverse kinematics of count targets. Each sample iterates on its own, samples
+         *        converge after different numbers of iterations so running a block in lockstep is slower.
+         * @param target Target positions, target[k][s] is coordinate k of sample s.
+         * @param q      Initial guesses on entry, solutions on return, q[i][s] is joint i of sample s.
+         * @param converged If not NULL, 1 for samples that reached their target and 0 otherwise.
+         * @return Number of samples that reached their target.
+         */
+        size_t InverseBatch(const double * const target[3], double * const q[N], size_t count,
+                            uint8_t * converged, const IkOptions & options = IkOptions()) const
+        {
+            size_t reached = 0;
+            for(size_t s = 0 ; s < count ; s++){
+                const double t[3] = {target[0][s], target[1][s], target[2][s]};
+                double qs[N];
+                for(int i = 0 ; i < N ; i++){
+                    qs[i] = q[i][s];
+                }
+                const bool ok = Inverse(t, qs, options) >= 0;
+                for(int i = 0 ; i < N ; i++){
+                    q[i][s] = qs[i];
+                }
+                if(converged){
+                    converged[s] = ok;
+                }
+                reached += ok;
+            }
+            return reached;
+        }
+    private:
+        /// Frames of a block of samples, x[k][s] is coordinate k of x axis of sample s.
+        struct BlockFrames
+        {
+            double x[3][kBlock];
+            double y[3][kBlock];
+            double z[3][kBlock];
+            double p[3][kBlock];
+        };
+
+        static void SetIdentity(Frame & f)
+        {
+            for(int k = 0 ; k < 3 ; k++){
+                f.x[k] = k == 0;
+                f.y[k] = k == 1;
+                f.z[k] = k == 2;
+                f.p[k] = 0;
+            }
+        }
+        /**
+         * Post-multiplies f with transform of joint i. With u = cos(theta) x + sin(theta) y and
+         * v = -sin(theta) x + cos(theta) y : x' = u, y' = cos(alpha) v + sin(alpha) z,
+         * z' = -sin(alpha) v + cos(alpha) z, p' = p + a u + d z.
+         */
+        void Append(Frame & f, int i, double q) const
+        {
+            const DhLink & l = links_[i];
+            const double theta = l.prismatic ? l.theta : l.theta + q;
+            const double d     = l.prismatic ? l.d + q : l.d;
+            const double ct = std::cos(theta), st = std::sin(theta);
+            const double ca = cos_alpha_[i], sa = sin_alpha_[i];
+            for(int k = 0 ; k < 3 ; k++){
+                const double u = ct * f.x[k] + st * f.y[k];
+                const double v = ct * f.y[k] - st * f.x[k];
+                const double z = f.z[k];
+                f.p[k] += l.a * u + d * z;
+                f.x[k] = u;
+                f.y[k] = ca * v + sa * z;
+                f.z[k] = ca * z - sa * v;
+            }
+        }
+        /// Same as Append() for n samples of a block.
+        void ForwardBlock(const double * const q[N], int n, BlockFrames & f) const
+        {
+            for(int k = 0 ; k < 3 ; k++){
+                std::fill(f.x[k], f.x[k] + n, double(k == 0));
+                std::fill(f.y[k], f.y[k] + n, double(k == 1));
+                std::fill(f.z[k], f.z[k] + n, double(k == 2));
+                std::fill(f.p[k], f.p[k] + n, 0.0);
+            }
+            double ct[kBlock], st[kBlock], d[kBlock];
+            for(int i = 0 ; i < N ; i++){
+                const DhLink & l = links_[i];
+                const double pr = l.prismatic ? 1.0 : 0.0;
+                const double ca = cos_alpha_[i], sa = sin_alpha_[i];
+                const double * __restrict qi = q[i];
+                #pragma omp simd
+                for(int s = 0 ; s < n ; s++){
+                    SinCos(l.theta + (1 - pr) * qi[s], st[s], ct[s]);
+                    d[s] = l.d + pr * qi[s];
+                }
+                for(int k = 0 ; k < 3 ; k++){
+                    double * __restrict fx = f.x[k];
+                    double * __restrict fy = f.y[k];
+                    double * __restrict fz = f.z[k];
+                    double * __restrict fp = f.p[k];
+                    #pragma omp simd
+                    for(int s = 0 ; s < n ; s++){
+                        const double u = ct[s] * fx[s] + st[s] * fy[s];
+                        const double v = ct[s] * fy[s] - st[s] * fx[s];
+                        const double z = fz[s];
+                        fp[s] += l.a * u + d[s] * z;
+                        fx[s] = u;
+                        fy[s] = ca * v + sa * z;
+                        fz[s] = ca * z - sa * v;
+                    }
+                }
+            }
+        }
+        /// Upper triangle of Jv Jv^T + damping^2 I as a00, a01, a02, a11, a12, a22.
+        static void Gram(const double (&jac)[6][N], double damping, double (&a)[6])
+        {
+            const int row[6] = {0, 0, 0, 1, 1, 2};
+            const int col[6] = {0, 1, 2, 1, 2, 2};
+            for(int m = 0 ; m < 6 ; m++){
+                a[m] = row[m] == col[m] ? damping * damping : 0;
+                for(int i = 0 ; i < N ; i++){
+                    a[m] += jac[row[m]][i] * jac[col[m]][i];
+                }
+            }
+        }
+        /// Solves symmetric 3x3 system given by its upper triangle with Cramer's rule.
+        static void Solve3(const double (&a)[6], const double (&b)[3], double (&w)[3])
+        {
+            const double c00 = a[3] * a[5] - a[4] * a[4];
+            const double c01 = a[2] * a[4] - a[1] * a[5];
+            const double c02 = a[1] * a[4] - a[2] * a[3];
+            const double c11 = a[0] * a[5] - a[2] * a[2];
+            const double c12 = a[1] * a[2] - a[0] * a[4];
+            const double c22 = a[0] * a[3] - a[1] * a[1];
+            const double inv_det = 1.0 / (a[0] * c00 + a[1] * c01 + a[2] * c02);
+            w[0] = (c00 * b[0] + c01 * b[1] + c02 * b[2]) * inv_det;
+            w[1] = (c01 * b[0] + c11 * b[1] + c12 * b[2]) * inv_det;
+            w[2] = (c02 * b[0] + c12 * b[1] + c22 * b[2]) * inv_det;
+        }
+
+        DhLink links_[N];
+        double cos_alpha_[N];
+        double sin_alpha_[N];
+};
+}
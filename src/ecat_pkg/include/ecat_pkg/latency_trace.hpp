@@ -0,0 +1,99 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  latency_trace.hpp
+ * \brief Input-to-actuation latency tracing for a single input path.
+ *
+ * Input callbacks store source timestamp and correlation id of the latest input.
+ * Control thread marks new inputs as latched when the control logic uses them
+ * and completes the trace after ecrt_master_send(). All timestamps are
+ * CLOCK_REALTIME, same clock as the source stamps of the input nodes.
+ * Statistics are atomics, so they can be read from executor thread while the
+ * control thread keeps writing.
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "ecat_msgs/msg/input_latency.hpp"
+
+class LatencyTrace
+{
+    public:
+        /// Histogram bin width and number of bins, last bin collects everything above.
+        static const uint32_t kBinWidthNs = 100000;
+        static const uint32_t kNumOfBins  = ecat_msgs::msg::InputLatency::NUM_OF_BINS;
+
+    /**
+     * @brief Stores source stamp of latest input, called from input callbacks.
+     * @param source_ns Source timestamp in ns (CLOCK_REALTIME).
+     * @param id Correlation id of the input.
+     */
+        void SetSource(int64_t source_ns, uint64_t id);
+
+    /**
+     * @brief Called by control thread when inputs are used by control logic.
+     *        Marks latest input as latched if it wasn't latched before. Real-time safe.
+     */
+        void Latch(int64_t now_ns);
+
+    /**
+     * @brief Called by control thread after frame is sent, records latched input. Real-time safe.
+     */
+        void Sent(int64_t now_ns);
+
+    /**
+     * @brief Fills latency message with cumulative statistics, doesn't allocate.
+     *        Reads all bins, so it's still kept out of the control thread.
+     */
+        void Fill(ecat_msgs::msg::InputLatency & msg) const;
+
+    private:
+        /// Written by input callbacks.
+        std::atomic<uint64_t> source_id_{0};
+        std::atomic<int64_t>  source_ns_{0};
+
+        /// Only used by control thread.
+        int64_t  latched_source_ns_ = 0;
+        uint64_t latched_id_ = 0;
+        int64_t  latch_ns_ = 0;
+        bool     pending_ = false;
+
+        /// Statistics, written by control thread.
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> last_id_{0};
+        std::atomic<uint64_t> latch_sum_ns_{0};
+        std::atomic<uint64_t> latch_max_ns_{0};
+        std::atomic<uint64_t> send_sum_ns_{0};
+        std::atomic<uint64_t> send_max_ns_{0};
+        std::atomic<uint64_t> histogram_[kNumOfBins] = {};
+};
@@ -0,0 +1,106 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  loop_statistics.hpp
+ * \brief Per window statistics of control loop, used when MEASURE_TIMING is set.
+ *
+ * Execution time of each cycle is put into a fixed histogram. Cycles are grouped
+ * into windows, for each window page fault and context switch deltas of the
+ * control thread are sampled by getrusage(RUSAGE_THREAD). Windows which contain
+ * execution time spikes are reported together with their fault/switch deltas, so
+ * latency outliers can be related to their cause.
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <sys/resource.h>
+
+class LoopStatistics
+{
+    public:
+        /// Histogram bin width and number of bins, last bin collects everything above.
+        static const uint32_t kBinWidthNs    = 5000;
+        static const uint32_t kNumOfBins     = 200;
+        /// Number of stored windows, oldest windows are overwritten.
+        static const uint32_t kMaxNumOfWindows = 3600;
+
+        /// Statistics of single window.
+        struct WindowStats
+        {
+            uint32_t index;
+            uint32_t exec_max_ns;
+            uint32_t latency_max_ns;
+            uint32_t num_of_spikes;      /// Cycles with execution time above spike threshold.
+            int64_t  minor_faults;
+            int64_t  major_faults;
+            int64_t  voluntary_switches;
+            int64_t  involuntary_switches;
+        };
+
+    /**
+     * @brief Sets window length and spike threshold. Doesn't sample anything yet.
+     * @param window_cycles Number of cycles in single window.
+     * @param spike_threshold_ns Cycles with longer execution time are counted as spike.
+     */
+        void Configure(uint32_t window_cycles, uint32_t spike_threshold_ns);
+
+    /**
+     * @brief Clears statistics and takes initial resource usage sample. 
+     *        Has to be called from control thread, since RUSAGE_THREAD is sampled.
+     */
+        void Start();
+
+    /**
+     * @brief Adds single cycle to current window, closes window if it's full.
+     *        Real-time safe, only calls getrusage once per window.
+     */
+        void AddCycle(uint32_t exec_ns, uint32_t latency_ns);
+
+    /**
+     * @brief Prints histogram, windows with spikes and fault/switch correlation summary.
+     *        Allocates due to logging, call after control loop is finished.
+     */
+        void Print() const;
+
+    private:
+        void CloseWindow();
+
+        uint32_t window_cycles_ = 1000;
+        uint32_t spike_threshold_ns_ = 250000;
+
+        uint64_t histogram_[kNumOfBins] = {};
+        WindowStats windows_[kMaxNumOfWindows] = {};
+        uint32_t num_of_windows_ = 0;
+
+        WindowStats current_ = {};
+        uint32_t cycles_in_window_ = 0;
+        struct rusage last_usage_ = {};
+};
@@ -63,6 +63,7 @@
 #define OD_MOTOR_DATA_NUMBER_OF_POLE_PAIRS				0X3001,0X03	 // RW: uint8_t
 #define OD_MOTOR_DATA_THERMAL_TIME_CONSTANT_WINDINGS	0X3001,0X04	 // RW: uint16_t
 #define OD_MOTOR_DATA_TORQUE_CONSTANT					0X3001,0X05	 // RW: uint32_t unit is uNm/A
+#define OD_GEAR_CONFIGURATION							0X3003       // Record of 4 uint32_t entries, written with complete access.
 #define OD_GEAR_REDUCTION_NUMERATOR 					0X3003,0X01  // RW: uint32_t
 #define OD_GEAR_REDUCTION_DENOMINATOR					0X3003,0X02	 // RW: uint32_t
 #define OD_GEAR_MAX_INPUT_SPEED							0X3003,0X03  // RW: uint32_t
@@ -93,8 +94,19 @@
 #define OD_VELOCITY_ENCODER_RESOLUTION_NUM      		0x6094,0x01
 #define OD_VELOCITY_ENCODER_RESOLUTION_DEN      		0x6094,0x02
 
+#define OD_HOMING_METHOD                        		0x6098,0x00	  // RW: int8_t
+#define OD_HOMING_SPEED_SWITCH_SEARCH           		0x6099,0x01	  // RW: uint32_t
+#define OD_HOMING_SPEED_ZERO_SEARCH             		0x6099,0x02	  // RW: uint32_t
+#define OD_HOMING_ACCELERATION                  		0x609A,0x00	  // RW: uint32_t
+#define OD_HOME_OFFSET_MOVE_DISTANCE            		0x30B1,0x00	  // RW: int32_t   moved away from home switch/limit after it's found.
+#define OD_HOMING_CURRENT_THRESHOLD             		0x30B2,0x00	  // RW: uint16_t  unit is mA, for homing on mechanical limit.
+
+#define OD_VELOCITY_CONTROLLER_PARAMETER_SET      		0x30A2        // Record of 4 uint32_t gains, written with complete access.
 #define OD_VELOCITY_CONTROLLER_PGAIN		      		0x30A2,0x01	  // RW: uint32_t  \see EPOS4-Firmware-Specification pg. 167
 #define OD_VELOCITY_CONTROLLER_IGAIN		      		0x30A2,0x02	  // RW: uint32_t  \see EPOS4-Firmware-Specification pg. 167
+#define OD_CURRENT_CONTROLLER_PARAMETER_SET      		0x30A0        // Record of 2 uint32_t gains, written with complete access.
+#define OD_CURRENT_CONTROLLER_PGAIN		      		0x30A0,0x01	  // RW: uint32_t  unit is uV/A
+#define OD_CURRENT_CONTROLLER_IGAIN		      		0x30A0,0x02	  // RW: uint32_t  unit is uV/(A*ms)
 
 
 #define OD_DIGITAL_INPUTS			  0x60FD,0x00
@@ -127,6 +139,7 @@
 #define SM_GO_ENABLE               	0X0F
 #define SM_GO_SWITCH_ON_DISABLE    	0x00
 #define SM_RUN                    	0x1F
+#define SM_START_HOMING            	0x1F       // In homing mode bit 4 starts homing, clearing it stops.
 #define SM_EXPEDITE               	0x3F       //like run, but dont finish actual position profile
 #define SM_QUICKSTOP              	0x02 
 #define SM_RELATIVE_POS				0X7F
@@ -0,0 +1,417 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  pdo_layout.hpp
+ * \brief Compile-time PDO layouts of supported slave types.
+ *
+ * Each slave type is described once as a Layout of sync managers, PDOs and
+ * typed entries. The layout generates the ec_pdo_entry_info_t, ec_pdo_info_t
+ * and ec_sync_info_t tables passed to ecrt_slave_config_pdos(), registers its
+ * entries in a domain and gives a typed View over the domain image.
+ *
+ * IgH maps each sync manager's PDOs as one contiguous block in the domain, so
+ * byte offset of an entry within its sync manager is a compile-time constant.
+ * View keeps one pointer per sync manager, Get<Entry>()/Set<Entry>() compile
+ * to a load/store at a fixed displacement from that pointer. Register() checks
+ * the offsets IgH assigned against the layout, so a mismatch fails at
+ * configuration and not in the cyclic loop.
+ *******************************************************************************/
+#pragma once
+
+#include <type_traits>
+
+#include "ecat_globals.hpp"
+
+namespace PdoLayout
+{
+/**
+ * @brief Single PDO entry.
+ * @tparam Index,Subindex Object dictionary entry, OD_* definitions expand into both.
+ * @tparam T     Type of the entry in process image, also gives its bit length.
+ * @tparam Field OffsetPDO member registered domain offset is stored into, nullptr if there is none.
+ *               Offsets in OffsetPDO are what flight recorder saves and View::Bind() uses.
+ */
+template <uint16_t Index, uint8_t Subindex, typename T, uint32_t OffsetPDO::* Field = nullptr>
+struct Entry
+{
+    typedef T Type;
+    static constexpr uint16_t kIndex     = Index;
+    static constexpr uint8_t  kSubindex  = Subindex;
+    static constexpr uint8_t  kBitLength = sizeof(T) * 8;
+    static constexpr bool     kHasField  = Field != nullptr;
+    static constexpr uint32_t OffsetPDO::* GetField() { return Field; }
+};
+
+/// Reads/writes entry types from/to process image, byte order is handled by EC_READ/EC_WRITE macros.
+template <typename T> struct Access;
+template <> struct Access<uint8_t>  { static uint8_t  Read(const uint8_t * p) { return EC_READ_U8(p);  } static void Write(uint8_t * p, uint8_t v)  { EC_WRITE_U8(p, v);  } };
+template <> struct Access<int8_t>   { static int8_t   Read(const uint8_t * p) { return EC_READ_S8(p);  } static void Write(uint8_t * p, int8_t v)   { EC_WRITE_S8(p, v);  } };
+template <> struct Access<uint16_t> { static uint16_t Read(const uint8_t * p) { return EC_READ_U16(p); } static void Write(uint8_t * p, uint16_t v) { EC_WRITE_U16(p, v); } };
+template <> struct Access<int16_t>  { static int16_t  Read(const uint8_t * p) { return EC_READ_S16(p); } static void Write(uint8_t * p, int16_t v)  { EC_WRITE_S16(p, v); } };
+template <> struct Access<uint32_t> { static uint32_t Read(const uint8_t * p) { return EC_READ_U32(p); } static void Write(uint8_t * p, uint32_t v) { EC_WRITE_U32(p, v); } };
+template <> struct Access<int32_t>  { static int32_t  Read(const uint8_t * p) { return EC_READ_S32(p); } static void Write(uint8_t * p, int32_t v)  { EC_WRITE_S32(p, v); } };
+
+/// @return Index of first true element after the leading placeholder minus one, -1 if there is none.
+template <size_t N>
+constexpr int FirstMatch(const bool (&match)[N])
+{
+    for(size_t i = 1 ; i < N ; i++){
+        if(match[i]) return int(i) - 1;
+    }
+    return -1;
+}
+
+/**
+ * @brief PDO with its entries in mapping order.
+ */
+template <uint16_t Index, typename... Entries>
+struct Pdo
+{
+    static constexpr uint16_t kIndex       = Index;
+    static constexpr unsigned kNumOfEntries = sizeof...(Entries);
+    static ec_pdo_entry_info_t entries_[sizeof...(Entries)];
+
+    /// @return Size of PDO in bytes.
+    static constexpr int Size()
+    {
+        const int sizes[] = {0, int(sizeof(typename Entries::Type))...};
+        int size = 0;
+        for(int s : sizes) size += s;
+        return size;
+    }
+    /// @return Byte offset of entry E in this PDO, -1 if E isn't part of it.
+    template <typename E>
+    static constexpr int OffsetOf()
+    {
+        const bool match[] = {false, std::is_same<E, Entries>::value...};
+        const int  sizes[] = {0, int(sizeof(typename Entries::Type))...};
+        const int  found   = FirstMatch(match);
+        int offset = 0;
+        for(int i = 0 ; i < found ; i++) offset += sizes[i + 1];
+        return found < 0 ? -1 : offset;
+    }
+    /// @return true if at least one entry has an OffsetPDO field.
+    static constexpr bool HasField()
+    {
+        const bool has[] = {false, Entries::kHasField...};
+        return FirstMatch(has) >= 0;
+    }
+    /// @return Offset of sync manager block derived from first entry with OffsetPDO field, -1 if there is none.
+    static int SyncBase(const OffsetPDO & offsets, int pdo_offset)
+    {
+        int base = -1;
+        int expand[] = {0, (base < 0 && Entries::kHasField ? 
+                            (base = int(offsets.*Entries::GetField()) - pdo_offset - OffsetOf<Entries>()) : 0)...};
+        (void)expand;
+        return base;
+    }
+    /**
+     * @brief Registers all entries, checks that each one is at its compile-time offset.
+     * @param sync_base Domain offset of sync manager block, set by first registered entry if negative.
+     * @param pdo_offset Offset of this PDO in its sync manager block.
+     * @return 0 if succesful, otherwise -1.
+     */
+    static int Register(ec_slave_config_t * sc, ec_domain_t * domain, OffsetPDO & offsets, int & sync_base, int pdo_offset)
+    {
+        int err = 0;
+        int expand[] = {0, (err |= RegisterEntry<Entries>(sc, domain, offsets, sync_base, pdo_offset))...};
+        (void)expand;
+        return err;
+    }
+  private:
+    template <typename E>
+    static int RegisterEntry(ec_slave_config_t * sc, ec_domain_t * domain, OffsetPDO & offsets, int & sync_base, int pdo_offset)
+    {
+        int offset = ecrt_slave_config_reg_pdo_entry(sc, E::kIndex, E::kSubindex, domain, NULL);
+        if(offset < 0){
+            return -1;
+        }
+        const int expected = pdo_offset + OffsetOf<E>();
+        if(sync_base < 0){
+            sync_base = offset - expected;
+        }else if(offset != sync_base + expected){
+            return -1;
+        }
+        if(E::kHasField){
+            offsets.*E::GetField() = offset;
+        }
+        return 0;
+    }
+};
+template <uint16_t Index, typename... Entries>
+ec_pdo_entry_info_t Pdo<Index, Entries...>::entries_[sizeof...(Entries)] = {
+    {Entries::kIndex, Entries::kSubindex, Entries::kBitLength}...
+};
+
+/**
+ * @brief Sync manager with its assigned PDOs, without PDOs for mailbox sync managers.
+ */
+template <uint8_t Index, ec_direction_t Dir, ec_watchdog_mode_t Watchdog, typename... Pdos>
+struct SyncManager
+{
+    static constexpr uint8_t            kIndex     = Index;
+    static constexpr ec_direction_t     kDirection = Dir;
+    static constexpr ec_watchdog_mode_t kWatchdog  = Watchdog;
+    static constexpr unsigned           kNumOfPdos = sizeof...(Pdos);
+    static ec_pdo_info_t pdos_[sizeof...(Pdos)];
+
+    static ec_pdo_info_t * GetPdos() { return pdos_; }
+
+    /// @return Byte offset of entry E in this sync manager's block, -1 if E isn't mapped here.
+    template <typename E>
+    static constexpr int OffsetOf()
+    {
+        const bool match[]   = {false, (Pdos::template OffsetOf<E>() >= 0)...};
+        const int  offsets[] = {0, Pdos::template OffsetOf<E>()...};
+        const int  sizes[]   = {0, Pdos::Size()...};
+        const int  found     = FirstMatch(match);
+        int offset = 0;
+        for(int i = 0 ; i < found ; i++) offset += sizes[i + 1];
+        return found < 0 ? -1 : offset + offsets[found + 1];
+    }
+    static constexpr bool HasField()
+    {
+        const bool has[] = {false, Pdos::HasField()...};
+        return FirstMatch(has) >= 0;
+    }
+    static int SyncBase(const OffsetPDO & offsets)
+    {
+        const int sizes[] = {0, Pdos::Size()...};
+        const int bases[] = {0, Pdos::SyncBase(offsets, PdoOffset(sizes, Pdos::kIndex))...};
+        for(size_t i = 1 ; i < sizeof(bases)/sizeof(bases[0]) ; i++){
+            if(bases[i] >= 0) return bases[i];
+        }
+        return -1;
+    }
+    static int Register(ec_slave_config_t * sc, ec_domain_t * domain, OffsetPDO & offsets)
+    {
+        const int sizes[] = {0, Pdos::Size()...};
+        int sync_base = -1;
+        int err = 0;
+        int expand[] = {0, (err |= Pdos::Register(sc, domain, offsets, sync_base, PdoOffset(sizes, Pdos::kIndex)))...};
+        (void)expand;
+        return err;
+    }
+  private:
+    /// @return Offset of PDO with given index in this sync manager's block.
+    static int PdoOffset(const int (&sizes)[sizeof...(Pdos) + 1], uint16_t pdo_index)
+    {
+        const uint16_t indexes[] = {0, Pdos::kIndex...};
+        int offset = 0;
+        for(size_t i = 1 ; i < sizeof...(Pdos) + 1 && indexes[i] != pdo_index ; i++) offset += sizes[i];
+        return offset;
+    }
+};
+template <uint8_t Index, ec_direction_t Dir, ec_watchdog_mode_t Watchdog, typename... Pdos>
+ec_pdo_info_t SyncManager<Index, Dir, Watchdog, Pdos...>::pdos_[sizeof...(Pdos)] = {
+    {Pdos::kIndex, Pdos::kNumOfEntries, Pdos::entries_}...
+};
+
+/// Mailbox sync managers have no PDOs.
+template <uint8_t Index, ec_direction_t Dir, ec_watchdog_mode_t Watchdog>
+struct SyncManager<Index, Dir, Watchdog>
+{
+    static constexpr uint8_t            kIndex     = Index;
+    static constexpr ec_direction_t     kDirection = Dir;
+    static constexpr ec_watchdog_mode_t kWatchdog  = Watchdog;
+    static constexpr unsigned           kNumOfPdos = 0;
+    static ec_pdo_info_t * GetPdos() { return NULL; }
+    template <typename E>
+    static constexpr int OffsetOf() { return -1; }
+    static constexpr bool HasField() { return false; }
+    static int SyncBase(const OffsetPDO &) { return -1; }
+    static int Register(ec_slave_config_t *, ec_domain_t *, OffsetPDO &) { return 0; }
+};
+
+/**
+ * @brief PDO layout of a slave type.
+ */
+template <typename... SyncManagers>
+struct Layout
+{
+    static constexpr unsigned kNumOfSyncs = sizeof...(SyncManagers);
+
+    /// @return Sync manager configuration for ecrt_slave_config_pdos(), terminated with 0xff.
+    static ec_sync_info_t * Syncs()
+    {
+        static ec_sync_info_t syncs[sizeof...(SyncManagers) + 1] = {
+            {SyncManagers::kIndex, SyncManagers::kDirection, SyncManagers::kNumOfPdos,
+             SyncManagers::GetPdos(), SyncManagers::kWatchdog}...,
+            {0xff, EC_DIR_INVALID, 0, NULL, EC_WD_DEFAULT}
+        };
+        return syncs;
+    }
+    /// @return Index of sync manager entry E is mapped to, -1 if E isn't part of this layout.
+    template <typename E>
+    static constexpr int SyncOf()
+    {
+        const bool match[] = {false, (SyncManagers::template OffsetOf<E>() >= 0)...};
+        return FirstMatch(match);
+    }
+    /// @return Byte offset of entry E in its sync manager's block.
+    template <typename E>
+    static constexpr int OffsetOf()
+    {
+        const int offsets[] = {0, SyncManagers::template OffsetOf<E>()...};
+        return SyncOf<E>() < 0 ? -1 : offsets[SyncOf<E>() + 1];
+    }
+    /// @return true if sync manager of E can be located from OffsetPDO, \see View::Bind().
+    template <typename E>
+    static constexpr bool IsBindable()
+    {
+        const bool has[] = {false, SyncManagers::HasField()...};
+        return SyncOf<E>() >= 0 && has[SyncOf<E>() + 1];
+    }
+    /// Domain offsets of sync manager blocks derived from OffsetPDO, -1 for blocks without fields.
+    static void SyncBases(const OffsetPDO & offsets, int (&bases)[sizeof...(SyncManagers)])
+    {
+        const int b[] = {0, SyncManagers::SyncBase(offsets)...};
+        for(size_t i = 0 ; i < sizeof...(SyncManagers) ; i++) bases[i] = b[i + 1];
+    }
+    /**
+     * @brief Registers all entries of this layout in domain and stores offsets in OffsetPDO.
+     * @return 0 if succesful, -1 if registration failed or IgH placed an entry at an unexpected offset.
+     */
+    static int Register(ec_slave_config_t * sc, ec_domain_t * domain, OffsetPDO & offsets)
+    {
+        int err = 0;
+        int expand[] = {0, (err |= SyncManagers::Register(sc, domain, offsets))...};
+        (void)expand;
+        return err;
+    }
+};
+
+/**
+ * @brief Typed view of one slave's process data in a domain image.
+ */
+template <typename L>
+class View
+{
+    public:
+        /**
+         * @brief Points view to domain image, sync manager blocks are located through offsets.
+         *        Has to be called again if domain image or offsets change (e.g. replay).
+         */
+        void Bind(uint8_t * domain, const OffsetPDO & offsets)
+        {
+            int bases[L::kNumOfSyncs];
+            L::SyncBases(offsets, bases);
+            for(unsigned i = 0 ; i < L::kNumOfSyncs ; i++){
+                sync_data_[i] = bases[i] < 0 ? NULL : domain + bases[i];
+            }
+        }
+        template <typename E>
+        typename E::Type Get() const
+        {
+            static_assert(L::template IsBindable<E>(), "Entry isn't mapped or its sync manager has no OffsetPDO field.");
+            return Access<typename E::Type>::Read(sync_data_[L::template SyncOf<E>()] + L::template OffsetOf<E>());
+        }
+        template <typename E>
+        void Set(typename E::Type value)
+        {
+            static_assert(L::template IsBindable<E>(), "Entry isn't mapped or its sync manager has no OffsetPDO field.");
+            Access<typename E::Type>::Write(sync_data_[L::template SyncOf<E>()] + L::template OffsetOf<E>(), value);
+        }
+    private:
+        uint8_t * sync_data_[L::kNumOfSyncs] = {};
+};
+
+/*****************************************************************************/
+/// CiA402 drive entries.
+typedef Entry<OD_CONTROL_WORD,          uint16_t, &OffsetPDO::control_word>   ControlWord;
+typedef Entry<OD_TARGET_POSITION,       int32_t,  &OffsetPDO::target_pos>     TargetPosition;
+typedef Entry<OD_TARGET_VELOCITY,       int32_t,  &OffsetPDO::target_vel>     TargetVelocity;
+typedef Entry<OD_TARGET_TORQUE,         int16_t,  &OffsetPDO::target_tor>     TargetTorque;
+typedef Entry<OD_TORQUE_OFFSET,         int16_t,  &OffsetPDO::torque_offset>  TorqueOffset;
+typedef Entry<OD_OPERATION_MODE,        int8_t,   &OffsetPDO::op_mode>        OperationMode;
+typedef Entry<OD_DIGITAL_OUTPUTS,       uint32_t>                             DigitalOutputs;
+typedef Entry<OD_STATUS_WORD,           uint16_t, &OffsetPDO::status_word>    StatusWord;
+typedef Entry<OD_POSITION_ACTUAL_VAL,   int32_t,  &OffsetPDO::actual_pos>     PositionActualValue;
+typedef Entry<OD_VELOCITY_ACTUAL_VALUE, int32_t,  &OffsetPDO::actual_vel>     VelocityActualValue;
+typedef Entry<OD_TORQUE_ACTUAL_VALUE,   int16_t,  &OffsetPDO::actual_tor>     TorqueActualValue;
+typedef Entry<OD_OPERATION_MODE_DISPLAY,int8_t,   &OffsetPDO::op_mode_display> OperationModeDisplay;
+typedef Entry<OD_DIGITAL_INPUTS,        uint32_t>                             DigitalInputs;
+
+/**
+ * Maxon EPOS4, Vendor ID 0x000000fb, Product code 0x61500000, Revision number 0x01600000.
+ * SM0/SM1 are reserved for SDO communication. EC_WD_ENABLE on SM2 makes slave throw
+ * an error if it doesn't receive outputs within watchdog interval.
+ * Mode of operation is mapped so drives can switch to homing and back in the cyclic loop.
+ */
+typedef Layout<
+    SyncManager<0, EC_DIR_OUTPUT, EC_WD_DISABLE>,
+    SyncManager<1, EC_DIR_INPUT,  EC_WD_DISABLE>,
+    SyncManager<2, EC_DIR_OUTPUT, EC_WD_ENABLE,         // RxPDO, master sends commands.
+        Pdo<0x1600, ControlWord, TargetVelocity, TargetPosition, TargetTorque, TorqueOffset, OperationMode>>,
+    SyncManager<3, EC_DIR_INPUT,  EC_WD_DISABLE,        // TxPDO, master receives feedback.
+        Pdo<0x1a00, StatusWord, PositionActualValue, VelocityActualValue, TorqueActualValue, OperationModeDisplay>>
+> MaxonEpos4;
+
+/// Elmo Gold Solo Twitter.
+typedef Layout<
+    SyncManager<0, EC_DIR_OUTPUT, EC_WD_DISABLE>,
+    SyncManager<1, EC_DIR_INPUT,  EC_WD_DISABLE>,
+    SyncManager<2, EC_DIR_OUTPUT, EC_WD_ENABLE,
+        Pdo<0x1600, TargetPosition, DigitalOutputs, ControlWord>,
+        Pdo<0x1607, TargetVelocity>>,
+    SyncManager<3, EC_DIR_INPUT,  EC_WD_DISABLE,
+        Pdo<0x1a00, PositionActualValue, DigitalInputs, StatusWord>,
+        Pdo<0x1a07, VelocityActualValue>>
+> ElmoGoldSoloTwitter;
+
+/// Custom EasyCAT slave entries, add your variables here and to \see OffsetPDO if they have to be recorded.
+typedef Entry<0x0005, 0x01, uint16_t> EasyCatOutputAnalog1;
+typedef Entry<0x0005, 0x02, uint16_t> EasyCatOutputAnalog2;
+typedef Entry<0x0005, 0x03, uint16_t> EasyCatOutputAnalog3;
+typedef Entry<0x0005, 0x04, uint8_t>  EasyCatOutputDigital4;
+typedef Entry<0x0005, 0x05, uint8_t>  EasyCatOutputDigital5;
+typedef Entry<0x0005, 0x06, uint8_t>  EasyCatOutputDigital1;
+typedef Entry<0x0005, 0x07, uint8_t>  EasyCatOutputDigital2;
+typedef Entry<0x0005, 0x08, uint8_t>  EasyCatOutputDigital3;
+typedef Entry<0x0006, 0x01, uint16_t> EasyCatInputAnalog1;
+typedef Entry<0x0006, 0x02, uint16_t> EasyCatInputAnalog2;
+typedef Entry<0x0006, 0x03, uint16_t> EasyCatInputAnalog3;
+typedef Entry<0x0006, 0x04, uint8_t>  EasyCatInputDigital4;
+typedef Entry<0x0006, 0x05, uint8_t,  &OffsetPDO::emergency_switch> EasyCatEmergencySwitch;
+typedef Entry<0x0006, 0x06, uint8_t,  &OffsetPDO::r_limit_switch>   EasyCatRightLimitSwitch;
+typedef Entry<0x0006, 0x07, uint8_t,  &OffsetPDO::l_limit_switch>   EasyCatLeftLimitSwitch;
+typedef Entry<0x0006, 0x08, uint8_t>  EasyCatInputDigital3;
+
+/// Custom EasyCAT slave, has no mailbox so process data uses SM0/SM1.
+typedef Layout<
+    SyncManager<0, EC_DIR_OUTPUT, EC_WD_ENABLE,
+        Pdo<0x1600, EasyCatOutputAnalog1, EasyCatOutputAnalog2, EasyCatOutputAnalog3, EasyCatOutputDigital4,
+                    EasyCatOutputDigital5, EasyCatOutputDigital1, EasyCatOutputDigital2, EasyCatOutputDigital3>>,
+    SyncManager<1, EC_DIR_INPUT,  EC_WD_DISABLE,
+        Pdo<0x1a00, EasyCatInputAnalog1, EasyCatInputAnalog2, EasyCatInputAnalog3, EasyCatInputDigital4,
+                    EasyCatEmergencySwitch, EasyCatRightLimitSwitch, EasyCatLeftLimitSwitch, EasyCatInputDigital3>>
+> EasyCat;
+}
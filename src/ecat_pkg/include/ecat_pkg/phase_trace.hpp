@@ -0,0 +1,156 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  phase_trace.hpp
+ * \brief Lightweight per-thread phase trace, exported in Chrome/Perfetto JSON format.
+ *
+ * Each registered thread owns a ring of (timestamp, phase) events. A mark ends the
+ * previous phase of the thread and starts the given one, kIdle only ends it.
+ * Timestamps are TSC ticks on x86 and CLOCK_MONOTONIC elsewhere, ticks are
+ * converted to time when the trace is dumped, assuming an invariant TSC.
+ * Marking is a timestamp read and two stores, it doesn't allocate or lock.
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+namespace PhaseTrace
+{
+/// Traced phases, names are given in phase_trace.cpp
+enum Phase : uint32_t
+{
+    kIdle = 0,
+    /// Control loop phases.
+    kSleep,
+    kReceive,
+    kDomainProcess,
+    kStatusCheck,
+    kPublish,
+    kRead,
+    kStateMachine,
+    kUpdate,
+    kWrite,
+    kRecord,
+    kQueue,
+    kSync,
+    kSend,
+    /// Executor callbacks.
+    kJoystickCallback,
+    kHapticCallback,
+    kGuiCallback,
+    kLatencyTimer,
+    kTraceDump,
+    /// Flight recorder writer.
+    kRecorderWrite,
+    kNumOfPhases
+};
+
+const uint32_t kMaxNumOfThreads = 8;
+/// Events per thread, ~20 seconds of control loop at 1 kHz.
+const uint32_t kRingSize = 1 << 18;
+
+struct Event
+{
+    uint64_t timestamp;
+    uint32_t phase;
+};
+
+struct ThreadRing
+{
+    char name[32];
+    /// Cleared when owner thread exits, ring is then reused by next thread with the same name.
+    std::atomic<bool> in_use;
+    std::atomic<uint64_t> head;
+    Event events[kRingSize];
+};
+
+/// Ring of calling thread, nullptr if thread isn't registered.
+extern thread_local ThreadRing * t_ring;
+
+inline uint64_t ReadTimestamp()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return uint64_t(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Marks start of given phase for calling thread. No-op for unregistered threads.
+ */
+inline void Mark(Phase phase)
+{
+    ThreadRing * ring = t_ring;
+    if(!ring) return;
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    Event & event  = ring->events[head % kRingSize];
+    event.timestamp = ReadTimestamp();
+    event.phase     = phase;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+/// Marks phase in constructor and idle in destructor, for callbacks.
+class Scope
+{
+    public:
+        explicit Scope(Phase phase) { Mark(phase); }
+        ~Scope() { Mark(kIdle); }
+};
+
+/**
+ * @brief Takes time reference for timestamp conversion. Call once at startup.
+ */
+void Init();
+
+/**
+ * @brief Assigns a ring to calling thread. Ring of an exited thread with the same name
+ *        is reused, so threads restarted on each activation keep a single ring,
+ *        otherwise a new ring is allocated. Not real-time safe, call before loop starts.
+ * @return 0 if succesful, -1 if maximum number of threads is reached.
+ */
+int RegisterThread(const char * name);
+
+/**
+ * @brief Writes last given seconds of all registered threads as Chrome JSON trace,
+ *        which can be opened in Perfetto UI or chrome://tracing.
+ * @return 0 if succesful, -1 otherwise.
+ */
+int DumpChromeTrace(const std::string & path, double seconds);
+}  // namespace PhaseTrace
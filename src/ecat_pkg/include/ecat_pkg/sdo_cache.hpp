@@ -0,0 +1,150 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  sdo_cache.hpp
+ * \brief Skips startup SDO writes of parameters drives already hold.
+ *
+ * Drivers collect startup parameters of a drive into an SdoParameterSet
+ * instead of queueing them directly. Without a cache every write is queued
+ * with ecrt_slave_config_sdo*() as before.
+ *
+ * With a cache, last written parameter set of each drive is kept in a file,
+ * keyed by vendor id, product code and serial number. Hash of that set is
+ * written to the drive's custom persistent memory (0x210C:01) with the
+ * parameters, so it is as persistent as the parameters themselves : if the
+ * drive was power cycled without storing, both fall back together. At next
+ * configuration the hash is uploaded, and if it matches the cached set only
+ * parameters that differ from it are queued.
+ *
+ * @note Skipped parameters aren't part of slave's startup configuration, if a
+ *       drive loses unstored parameters during operation master won't rewrite
+ *       them on reconfiguration. Store parameters on drives (0x1010) when using it.
+ *******************************************************************************/
+#pragma once
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "ecat_slave.hpp"
+
+/// Single startup SDO download.
+typedef struct
+{
+    uint16_t index;
+    uint8_t  subindex;
+    uint8_t  size;      // in bytes, 1, 2 or 4
+    uint32_t value;
+    /// Consecutive complete access writes of same index are downloaded as one packed buffer.
+    bool     complete_access;
+} SdoWrite;
+
+/**
+ * @brief Startup SDO writes of one slave in the order they have to be downloaded.
+ *        Method signatures follow ecrt_slave_config_sdo*() so drivers can be written the same way.
+ */
+class SdoParameterSet
+{
+    public:
+        int Sdo8(uint16_t index, uint8_t subindex, uint8_t value)   { return Add(index, subindex, 1, value); }
+        int Sdo16(uint16_t index, uint8_t subindex, uint16_t value) { return Add(index, subindex, 2, value); }
+        int Sdo32(uint16_t index, uint8_t subindex, uint32_t value) { return Add(index, subindex, 4, value); }
+        /**
+         * @brief Writes subindexes 1..N of a record with one complete access download instead of N transfers.
+         *        Values are given in subindex order, their types give entry sizes. Entries are packed without
+         *        gaps, so it is only for records without padding in the object dictionary (e.g. 0x30A2).
+         * @return 0 if succesful, otherwise -1.
+         */
+        template <typename... T>
+        int SdoComplete(uint16_t index, T... values)
+        {
+            uint8_t subindex = 0;
+            int err = 0;
+            int expand[] = {0, (err |= AddComplete(index, ++subindex, values))...};
+            (void)expand;
+            return err;
+        }
+
+        const std::vector<SdoWrite> & GetWrites() const { return writes_; }
+        /// FNV-1a hash of all writes, order matters.
+        static uint32_t Hash(const std::vector<SdoWrite> & writes);
+        /**
+         * @brief Queues writes as startup SDOs of slave configuration.
+         * @return 0 if succesful, otherwise -1.
+         */
+        static int Queue(ec_slave_config_t * sc, const SdoWrite & write);
+        static int QueueAll(ec_slave_config_t * sc, const std::vector<SdoWrite> & writes);
+        /// Queues count complete access writes of same index as one ecrt_slave_config_complete_sdo().
+        static int QueueComplete(ec_slave_config_t * sc, const SdoWrite * writes, size_t count);
+    private:
+        /// Writing same object twice keeps the last value at position of first write.
+        int Add(uint16_t index, uint8_t subindex, uint8_t size, uint32_t value, bool complete_access = false);
+        template <typename V>
+        int AddComplete(uint16_t index, uint8_t subindex, V value)
+        {
+            static_assert(sizeof(V) == 1 || sizeof(V) == 2 || sizeof(V) == 4, "SDO entries are 8, 16 or 32 bits.");
+            return Add(index, subindex, sizeof(V), uint32_t(value), true);
+        }
+        std::vector<SdoWrite> writes_;
+};
+
+/**
+ * @brief File backed cache of parameter sets written to drives.
+ */
+class SdoParameterCache
+{
+    public:
+        /**
+         * @brief Loads cache file, a missing file is an empty cache.
+         * @return 0 if succesful, -1 if file exists but can't be parsed.
+         */
+        int Open(const std::string & file);
+        bool IsOpen() const { return open_; }
+        /**
+         * @brief Queues writes of set the drive doesn't already hold as startup SDOs and records set in cache.
+         *        Hash of set is queued as well whenever something is written.
+         * @param master Requested master the slave is connected to, used to upload stored hash.
+         * @return 0 if succesful, otherwise -1.
+         */
+        int Queue(ec_master_t * master, EthercatSlave & slave, const SdoParameterSet & set);
+        /**
+         * @brief Writes cache to file given in Open().
+         * @return 0 if succesful, otherwise -1.
+         */
+        int Save() const;
+    private:
+        /// Vendor id, product code, serial number.
+        typedef std::tuple<uint32_t, uint32_t, uint32_t> Key;
+        std::map<Key, std::vector<SdoWrite>> entries_;
+        std::string file_;
+        bool open_ = false;
+};
@@ -0,0 +1,149 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  secondary_master.hpp
+ * \brief Additional EtherCAT masters driven by their own cyclic threads.
+ *
+ * Control logic runs in the control thread of the first master. Each additional
+ * master (e.g. a second NIC/segment) gets a SecondaryMaster which runs its own
+ * pinned real-time thread doing receive/process/queue/send for its domain.
+ *
+ * Threads don't share locks. Process data is exchanged as whole domain images
+ * through two triple buffers per master : secondary thread publishes its input
+ * image every cycle, control thread publishes the image it wrote setpoints into.
+ * Control logic reads and writes slaves of secondary masters through a shadow
+ * image owned by control thread, so ReadFromSlaves()/WriteToSlaves*() don't
+ * need to know which master a slave belongs to.
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "ecat_node.hpp"
+#include "triple_buffer.hpp"
+
+namespace EthercatCommunication
+{
+/**
+ * @brief Lock-free single producer/single consumer exchange of latest domain image.
+ */
+class ImageExchange
+{
+    public:
+        /// Allocates buffers, has to be called before exchange starts.
+        void Resize(size_t size) { images_.Reset(std::vector<uint8_t>(size, 0)); }
+        /// @return Buffer producer writes next image into.
+        uint8_t * WriteBuffer() { return images_.Write().data(); }
+        /// Makes image in write buffer available to consumer.
+        void Publish() { images_.Publish(); }
+        /**
+         * @brief Takes latest published image, if there is a new one.
+         * @return true if ReadBuffer() now holds an image that wasn't read before.
+         */
+        bool Acquire() { return images_.Acquire(); }
+        /// @return Latest acquired image.
+        const uint8_t * ReadBuffer() const { return images_.Read().data(); }
+    private:
+        TripleBuffer<std::vector<uint8_t>> images_;
+};
+
+class SecondaryMaster
+{
+    public:
+        /**
+         * Cycles without a new output image from control thread after which this master stops
+         * queueing its domain. Slaves' sync manager watchdogs then trip like they would with a single
+         * master, instead of last setpoints being resent while control thread is stalled or gone.
+         */
+        static const uint32_t kMaxStaleOutputCycles = 10;
+
+        /**
+         * @param master_index  Index of the master in /etc/ethercat.conf.
+         * @param first_slave   Global index of first slave on this master.
+         * @param num_of_slaves Number of slaves on this master.
+         * @param cpu           CPU the cyclic thread is pinned to, -1 leaves affinity unchanged.
+         */
+        SecondaryMaster(uint32_t master_index, int first_slave, int num_of_slaves, int cpu);
+        ~SecondaryMaster();
+
+        /// Wrapped master, configured the same way as the first master.
+        EthercatNode & GetNode() { return *node_; }
+
+        /**
+         * @brief Allocates exchange buffers and makes slaves of this master accessible through
+         *        control node, slave entries of control node point to the shadow image.
+         * @note  Has to be called after RegisterDomain().
+         * @param control_node Node whose slaves_ control logic uses.
+         */
+        void AttachTo(EthercatNode & control_node);
+
+        /**
+         * @brief Starts cyclic thread with SCHED_FIFO priority.
+         * @param start_time First wake up time, cycles are aligned to control thread's start time.
+         * @param phase_shift_ns Offset of this master's cycle relative to control thread.
+         * @return 0 if succesful, otherwise -1.
+         */
+        int  Start(const struct timespec & start_time, int32_t phase_shift_ns, int priority);
+        /// Stops and joins cyclic thread, can be called more than once.
+        void Stop();
+
+        /// Control thread : copies latest input image of this master into shadow image.
+        void ReceiveImage();
+        /// Control thread : publishes shadow image, it will be sent on next cycle of this master.
+        void SendImage();
+
+        /// @return Latest application layer states of this master's slaves, updated once per second.
+        uint8_t GetAlStates() const { return al_states_.load(std::memory_order_relaxed); }
+        /// @return Number of control cycles in which there was no new image from this master.
+        uint64_t GetMissedImages() const { return missed_images_; }
+        /// @return Number of times this master stopped queueing because control thread didn't send images.
+        uint64_t GetOutputStalls() const { return output_stalls_.load(std::memory_order_relaxed); }
+    private:
+        static void * PassCyclicExchange(void * arg);
+        void CyclicExchange();
+
+        std::unique_ptr<EthercatNode> node_;
+        ImageExchange inputs_;      /// Secondary thread -> control thread.
+        ImageExchange outputs_;     /// Control thread -> secondary thread.
+        std::vector<uint8_t> shadow_;
+        size_t image_size_ = 0;
+        uint8_t * domain_data_ = NULL;
+        int cpu_;
+        struct timespec start_time_ = {};
+        pthread_t thread_;
+        bool started_ = false;
+        std::atomic<bool> running_{false};
+        std::atomic<uint8_t> al_states_{0};
+        std::atomic<uint64_t> output_stalls_{0};
+        uint64_t missed_images_ = 0;
+};
+}
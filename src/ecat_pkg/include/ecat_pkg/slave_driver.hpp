@@ -0,0 +1,320 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  slave_driver.hpp
+ * \brief Statically dispatched drivers of supported slave types.
+ *
+ * A driver bundles everything that is specific to one slave type: its PDO
+ * layout, DC configuration, startup SDO parameters and how its process data
+ * is decoded into feedback and encoded from commands each cycle.
+ *
+ * Drivers derive from Driver<Derived, Layout> (CRTP), there are no virtual
+ * functions. Slaves of the same type are kept in a Batch, and the bus
+ * topology is a DriverSet of batches. DriverSet::ForEach() expands into one
+ * plain loop per batch at compile time, so the cyclic code is the same loop
+ * over a typed view that was written by hand before.
+ *
+ * To add a device, define its layout in pdo_layout.hpp, derive a driver here
+ * and add a batch of it to Drivers below.
+ *******************************************************************************/
+#pragma once
+
+#include <tuple>
+#include <utility>
+#include <type_traits>
+
+#include "ecat_globals.hpp"
+#include "ecat_slave.hpp"
+#include "pdo_layout.hpp"
+#include "sdo_cache.hpp"
+
+#include <rclcpp/rclcpp.hpp>
+
+namespace SlaveDriver
+{
+/**
+ * @brief Startup SDOs of CiA402 drives for each operation mode, collected into sdos. \see sdo_cache.hpp
+ * @return 0 if succesful, otherwise -1.
+ */
+int ConfigureCia402Sdos(SdoParameterSet & sdos, const ProfilePosParam & P);
+int ConfigureCia402Sdos(SdoParameterSet & sdos, const ProfileVelocityParam & P);
+int ConfigureCia402Sdos(SdoParameterSet & sdos, const CSPositionModeParam & P);
+int ConfigureCia402Sdos(SdoParameterSet & sdos, const CSVelocityModeParam & P);
+int ConfigureCia402Sdos(SdoParameterSet & sdos, const CSTorqueModeParam & P);
+/// Homing SDOs don't change operation mode, following error and decelerations come from operating mode parameters.
+int ConfigureCia402Sdos(SdoParameterSet & sdos, const HomingParam & P);
+
+/**
+ * @brief Common part of all drivers.
+ * @tparam Derived Driver type, may override kAssignActivate, kSync0Shift, ConfigureSdos() and Decode().
+ * @tparam L       PDO layout of the slave, \see pdo_layout.hpp
+ */
+template <typename Derived, typename L>
+class Driver
+{
+    public:
+        typedef L Layout;
+        /// True for CiA402 servo drives, only those are visited by DriverSet::ForEachDrive().
+        static constexpr bool     kIsServoDrive   = false;
+        /// AssignActivate word from slave's ESI file.
+        static constexpr uint16_t kAssignActivate = 0x0300;
+        /// SYNC0 shift in ns.
+        static constexpr int32_t  kSync0Shift     = 0;
+        /// True if slave has 0x210C:01 to hold hash of its parameters, \see SdoParameterCache
+        static constexpr bool     kCachesSdos     = false;
+
+        /**
+         * @brief Configures sync managers and PDOs of slave and registers its entries in domain.
+         * @return 0 if succesful, otherwise -1.
+         */
+        int MapPdos(EthercatSlave & slave, ec_domain_t * domain)
+        {
+            if(ecrt_slave_config_pdos(slave.slave_config_, EC_END, L::Syncs())){
+                RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Slave PDO configuration failed... ");
+                return -1;
+            }
+            if(L::Register(slave.slave_config_, domain, slave.offset_)){
+                RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Slave PDO registration failed... ");
+                return -1;
+            }
+            return 0;
+        }
+        /// Configures DC synchronization of slave.
+        void ConfigDc(EthercatSlave & slave) const
+        {
+            ecrt_slave_config_dc(slave.slave_config_, Derived::kAssignActivate, PERIOD_NS, Derived::kSync0Shift, 0, 0);
+        }
+        /**
+         * @brief Adds startup SDOs for parameter set P to sdos, slaves without such parameters ignore it.
+         * @return 0 if succesful, otherwise -1.
+         */
+        template <typename P>
+        int ConfigureSdos(SdoParameterSet &, const P &)
+        {
+            return 0;
+        }
+        /// Points PDO view to slave's domain image, \see PdoLayout::View::Bind().
+        void Bind(const EthercatSlave & slave)
+        {
+            pdo_.Bind(slave.slave_pdo_domain_, slave.offset_);
+        }
+        /// Copies inputs of slave into feedback message, slave is global slave index.
+        template <typename Feedback>
+        void Decode(Feedback &, int) const
+        {
+        }
+
+        PdoLayout::View<L> pdo_;
+};
+
+/**
+ * @brief CiA402 servo drive, drive index equals global slave index.
+ *        Entries that aren't in layout L are skipped, so drives with smaller mappings share this code.
+ */
+template <typename Derived, typename L>
+class Cia402Drive : public Driver<Derived, L>
+{
+    public:
+        static constexpr bool kIsServoDrive = true;
+        /// Homing needs mode of operation and its display in process data, \see homing.hpp
+        static constexpr bool kCanHome = L::template IsBindable<PdoLayout::OperationMode>() &&
+                                         L::template IsBindable<PdoLayout::OperationModeDisplay>();
+
+        template <typename P>
+        int ConfigureSdos(SdoParameterSet & sdos, const P & params)
+        {
+            return ConfigureCia402Sdos(sdos, params);
+        }
+        template <typename Feedback>
+        void Decode(Feedback & fb, int drive) const
+        {
+            ReadIfMapped<PdoLayout::PositionActualValue>(fb.actual_pos[drive]);
+            ReadIfMapped<PdoLayout::VelocityActualValue>(fb.actual_vel[drive]);
+            ReadIfMapped<PdoLayout::StatusWord>(fb.status_word[drive]);
+            ReadIfMapped<PdoLayout::TorqueActualValue>(fb.actual_tor[drive]);
+            ReadIfMapped<PdoLayout::OperationModeDisplay>(fb.op_mode_display[drive]);
+        }
+        void EncodeControlWord(uint16_t control_word)
+        {
+            this->pdo_.template Set<PdoLayout::ControlWord>(control_word);
+        }
+        void EncodeVelocity(uint16_t control_word, int32_t target_vel)
+        {
+            this->pdo_.template Set<PdoLayout::ControlWord>(control_word);
+            this->pdo_.template Set<PdoLayout::TargetVelocity>(target_vel);
+        }
+        void EncodePosition(uint16_t control_word, int32_t target_pos)
+        {
+            this->pdo_.template Set<PdoLayout::ControlWord>(control_word);
+            this->pdo_.template Set<PdoLayout::TargetPosition>(target_pos);
+        }
+        /// Target torque and torque offset are only sent to drives that map them.
+        void EncodeTorque(uint16_t control_word, int16_t target_tor, int16_t torque_offset)
+        {
+            this->pdo_.template Set<PdoLayout::ControlWord>(control_word);
+            WriteIfMapped<PdoLayout::TargetTorque>(target_tor);
+            WriteIfMapped<PdoLayout::TorqueOffset>(torque_offset);
+        }
+        void EncodeOperationMode(int8_t op_mode)
+        {
+            WriteIfMapped<PdoLayout::OperationMode>(op_mode);
+        }
+        /// Drive follows its own profile while homing, targets are held at actual position so nothing jumps after it.
+        void EncodeHoming(uint16_t control_word, int8_t op_mode, int32_t actual_pos)
+        {
+            this->pdo_.template Set<PdoLayout::ControlWord>(control_word);
+            WriteIfMapped<PdoLayout::OperationMode>(op_mode);
+            WriteIfMapped<PdoLayout::TargetPosition>(actual_pos);
+            WriteIfMapped<PdoLayout::TargetVelocity>(0);
+            WriteIfMapped<PdoLayout::TargetTorque>(0);
+        }
+    private:
+        template <typename E>
+        using Mapped = std::integral_constant<bool, L::template IsBindable<E>()>;
+
+        template <typename E, typename T>
+        void ReadIfMapped(T & dst) const { ReadIfMapped<E>(dst, Mapped<E>()); }
+        template <typename E, typename T>
+        void ReadIfMapped(T & dst, std::true_type) const { dst = this->pdo_.template Get<E>(); }
+        template <typename E, typename T>
+        void ReadIfMapped(T &, std::false_type) const {}
+
+        template <typename E>
+        void WriteIfMapped(typename E::Type value) { WriteIfMapped<E>(value, Mapped<E>()); }
+        template <typename E>
+        void WriteIfMapped(typename E::Type value, std::true_type) { this->pdo_.template Set<E>(value); }
+        template <typename E>
+        void WriteIfMapped(typename E::Type, std::false_type) {}
+};
+
+/// Maxon EPOS4 drive.
+class MaxonEpos4Driver : public Cia402Drive<MaxonEpos4Driver, PdoLayout::MaxonEpos4>
+{
+    public:
+        static constexpr bool kCachesSdos = true;
+};
+
+/// Elmo Gold Solo Twitter drive, has no torque entries mapped so it can't be used in torque mode.
+class ElmoGoldDriver : public Cia402Drive<ElmoGoldDriver, PdoLayout::ElmoGoldSoloTwitter>
+{
+};
+
+/// Custom EasyCAT slave with emergency button and limit switches.
+class EasyCatDriver : public Driver<EasyCatDriver, PdoLayout::EasyCat>
+{
+    public:
+        static constexpr int32_t kSync0Shift = 2000200000;
+
+        template <typename Feedback>
+        void Decode(Feedback & fb, int) const
+        {
+            fb.right_limit_switch_val = pdo_.Get<PdoLayout::EasyCatRightLimitSwitch>();
+            fb.left_limit_switch_val  = pdo_.Get<PdoLayout::EasyCatLeftLimitSwitch>();
+            fb.emergency_switch_val   = pdo_.Get<PdoLayout::EasyCatEmergencySwitch>();
+        }
+};
+
+/**
+ * @brief Count slaves of driver type D at consecutive global slave indexes starting at First.
+ */
+template <typename D, int First, int Count>
+class Batch
+{
+    public:
+        typedef D DriverType;
+        static constexpr int kFirst = First;
+        static constexpr int kCount = Count;
+
+        /// Calls f(driver, global slave index) for each slave of batch.
+        template <typename F>
+        void ForEach(F & f)
+        {
+            for(int i = 0 ; i < Count ; i++){
+                f(drivers_[i], First + i);
+            }
+        }
+    private:
+        D drivers_[Count];
+};
+
+template <typename D, int First>
+class Batch<D, First, 0>
+{
+    public:
+        typedef D DriverType;
+        static constexpr int kFirst = First;
+        static constexpr int kCount = 0;
+
+        template <typename F>
+        void ForEach(F &)
+        {
+        }
+};
+
+/**
+ * @brief Bus topology as a set of homogeneous batches, visited without virtual calls.
+ */
+template <typename... Batches>
+class DriverSet
+{
+    public:
+        /// Calls f(driver, global slave index) for every slave, f is instantiated once per driver type.
+        template <typename F>
+        void ForEach(F && f)
+        {
+            int expand[] = {0, (std::get<Batches>(batches_).ForEach(f), 0)...};
+            (void)expand;
+        }
+        /// Same as ForEach() but visits servo drives only, slave index equals drive index for them.
+        template <typename F>
+        void ForEachDrive(F && f)
+        {
+            int expand[] = {0, (VisitDrives(std::get<Batches>(batches_), f,
+                                std::integral_constant<bool, Batches::DriverType::kIsServoDrive>()), 0)...};
+            (void)expand;
+        }
+    private:
+        template <typename B, typename F>
+        static void VisitDrives(B & batch, F & f, std::true_type) { batch.ForEach(f); }
+        template <typename B, typename F>
+        static void VisitDrives(B &, F &, std::false_type) {}
+
+        std::tuple<Batches...> batches_;
+};
+
+/// Default topology : servo drives are first g_kNumberOfServoDrivers slaves, custom slave is FINAL_SLAVE.
+typedef Batch<MaxonEpos4Driver, 0, g_kNumberOfServoDrivers> ServoDrives;
+#if CUSTOM_SLAVE
+    typedef DriverSet<ServoDrives, Batch<EasyCatDriver, FINAL_SLAVE, 1>> Drivers;
+#else
+    typedef DriverSet<ServoDrives> Drivers;
+#endif
+}
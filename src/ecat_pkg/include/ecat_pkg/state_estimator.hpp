@@ -0,0 +1,156 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  state_estimator.hpp
+ * \brief Velocity and acceleration of all axes estimated from encoder position.
+ *
+ * Drives quantize velocity coarsely at low speed, so velocity and acceleration
+ * are estimated from actual position with a critically damped alpha-beta-gamma
+ * (fading memory) filter per axis. One smoothing factor theta in [0, 1) sets
+ * all three gains, larger theta smooths more and lags more :
+ *   g = 1 - theta^3, h = 1.5 (1 - theta)^2 (1 + theta), k = 0.5 (1 - theta)^3
+ *
+ * State is one single precision array per quantity over all axes and Update()
+ * is one branch free loop over them, vectorized with "omp simd" (-fopenmp-simd,
+ * no OpenMP runtime is used). Position estimate is kept relative to last
+ * measured position, encoder overflow only shows up in the integer difference
+ * of two measurements and is handled there.
+ *
+ * Velocity is in rpm and acceleration in rpm/s like drive velocities.
+ *******************************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// Configuration of all axes, flight recorder stores it so replay runs with the recorded one.
+template <size_t N>
+struct EstimatorParameters
+{
+    double increments_per_rev;  /// Encoder increments per motor revolution.
+    double theta[N];            /// Smoothing factor of each axis.
+};
+
+/// Filter state of all axes, plain data so flight recorder can store it for replay.
+template <size_t N>
+struct EstimatorState
+{
+    int32_t last_pos[N];    /// Last measured position, increments.
+    float   pos_err[N];     /// Position estimate minus last_pos, increments.
+    float   vel[N];         /// rpm
+    float   acc[N];         /// rpm/s
+    uint8_t initialized;
+};
+
+template <size_t N>
+class StateEstimator
+{
+    public:
+        /**
+         * @param params    Encoder resolution and smoothing factor of each axis.
+         * @param frequency Update frequency in Hz.
+         */
+        void Configure(const EstimatorParameters<N> & params, uint32_t frequency)
+        {
+            const double t = 1.0 / frequency;
+            // Increments per (rpm * s).
+            const double c = params.increments_per_rev / 60.0;
+            for(size_t i = 0 ; i < N ; i++){
+                const double theta = params.theta[i];
+                const double g = 1 - theta * theta * theta;
+                const double h = 1.5 * (1 - theta) * (1 - theta) * (1 + theta);
+                const double k = 0.5 * (1 - theta) * (1 - theta) * (1 - theta);
+                one_minus_g_[i] = float(1 - g);
+                vel_gain_[i]    = float(h / (t * c));
+                acc_gain_[i]    = float(2 * k / (t * t * c));
+            }
+            move_vel_ = float(t * c);
+            move_acc_ = float(0.5 * t * t * c);
+            dt_ = float(t);
+            params_ = params;
+            state_.initialized = 0;
+        }
+
+        /**
+         * @brief Updates estimates with positions measured in this cycle.
+         *        First update after Configure() only takes the positions, estimates start at rest.
+         */
+        void Update(const int32_t * __restrict actual_pos, float * __restrict vel, float * __restrict acc)
+        {
+            EstimatorState<N> & s = state_;
+            if(!s.initialized){
+                for(size_t i = 0 ; i < N ; i++){
+                    s.last_pos[i] = actual_pos[i];
+                    s.pos_err[i] = s.vel[i] = s.acc[i] = 0;
+                }
+                s.initialized = 1;
+            }
+            // Single precision halves the bytes per axis and doubles the lanes per vector, the filter is
+            // stable so rounding doesn't accumulate. Only moved has to be exact, it's an integer difference.
+            int32_t * __restrict last_pos = s.last_pos;
+            float * __restrict pos_err = s.pos_err;
+            float * __restrict est_vel = s.vel;
+            float * __restrict est_acc = s.acc;
+            const float * __restrict one_minus_g = one_minus_g_;
+            const float * __restrict vel_gain = vel_gain_;
+            const float * __restrict acc_gain = acc_gain_;
+            const float move_vel = move_vel_;
+            const float move_acc = move_acc_;
+            const float dt = dt_;
+            #pragma omp simd
+            for(size_t i = 0 ; i < N ; i++){
+                const float moved     = float(int32_t(uint32_t(actual_pos[i]) - uint32_t(last_pos[i])));
+                const float predicted = pos_err[i] + est_vel[i] * move_vel + est_acc[i] * move_acc;
+                const float residual  = moved - predicted;
+                pos_err[i]  = -one_minus_g[i] * residual;
+                est_vel[i] += est_acc[i] * dt + vel_gain[i] * residual;
+                est_acc[i] += acc_gain[i] * residual;
+                last_pos[i] = actual_pos[i];
+                vel[i] = est_vel[i];
+                acc[i] = est_acc[i];
+            }
+        }
+
+        const EstimatorParameters<N> & GetParameters() const { return params_; }
+        const EstimatorState<N> & GetState() const { return state_; }
+        /// Continues from a recorded state, \see EthercatLifeCycle::Replay()
+        void SetState(const EstimatorState<N> & state) { state_ = state; }
+
+    private:
+        EstimatorParameters<N> params_ = {};
+        EstimatorState<N> state_ = {};
+        float one_minus_g_[N] = {};
+        float vel_gain_[N] = {};
+        float acc_gain_[N] = {};
+        float move_vel_ = 0;
+        float move_acc_ = 0;
+        float dt_ = 0;
+};
@@ -0,0 +1,113 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  tlsf_message_pool.hpp
+ * \brief Preallocated message pool for subscriptions, backed by TLSF allocator.
+ *
+ * rclcpp's MessagePoolMemoryStrategy only accepts fixed-size messages and the
+ * default std::allocator. This strategy works with TLSF backed subscriptions
+ * and also with messages containing vectors (e.g. sensor_msgs::msg::Joy), pool
+ * messages are not reconstructed on borrow so vector capacity is reused.
+ *******************************************************************************/
+#pragma once
+
+#include <array>
+#include <memory>
+
+#include <rclcpp/message_memory_strategy.hpp>
+#include <tlsf_cpp/tlsf.hpp>   // C++ wrapper for Miguel Masmano Tello's implementation of the TLSF memory allocator
+
+template<typename T = void>
+using TLSFAllocator = tlsf_heap_allocator<T>;
+
+namespace EthercatLifeCycleNode
+{
+/**
+ * @brief Message memory strategy which borrows messages from a preallocated pool.
+ *
+ * @tparam MessageT Subscribed message type.
+ * @tparam Size Number of messages in the pool, one is enough for single threaded executor.
+ */
+template<typename MessageT, std::size_t Size>
+class TLSFMessagePoolMemoryStrategy
+    : public rclcpp::message_memory_strategy::MessageMemoryStrategy<MessageT, TLSFAllocator<void>>
+{
+    public:
+        RCLCPP_SMART_PTR_DEFINITIONS(TLSFMessagePoolMemoryStrategy)
+        using BaseStrategy = rclcpp::message_memory_strategy::MessageMemoryStrategy<MessageT, TLSFAllocator<void>>;
+
+        explicit TLSFMessagePoolMemoryStrategy(std::shared_ptr<TLSFAllocator<void>> allocator)
+        : BaseStrategy(allocator)
+        {
+            for(std::size_t i = 0 ; i < Size ; i++){
+                pool_[i].msg  = std::allocate_shared<MessageT>(*this->message_allocator_);
+                pool_[i].used = false;
+            }
+        }
+
+        /**
+         * @brief Borrows next free message from the pool. If all messages are in use,
+         *        falls back to TLSF allocation instead of throwing in the executor.
+         */
+        std::shared_ptr<MessageT> borrow_message() override
+        {
+            for(std::size_t i = 0 ; i < Size ; i++){
+                std::size_t index = (next_index_ + i) % Size;
+                if(!pool_[index].used){
+                    pool_[index].used = true;
+                    next_index_ = (index + 1) % Size;
+                    return pool_[index].msg;
+                }
+            }
+            return BaseStrategy::borrow_message();
+        }
+
+        void return_message(std::shared_ptr<MessageT> & msg) override
+        {
+            for(std::size_t i = 0 ; i < Size ; i++){
+                if(pool_[i].msg == msg){
+                    pool_[i].used = false;
+                    return;
+                }
+            }
+            BaseStrategy::return_message(msg);
+        }
+
+    private:
+        struct PoolMember
+        {
+            std::shared_ptr<MessageT> msg;
+            bool used;
+        };
+        std::array<PoolMember, Size> pool_;
+        std::size_t next_index_ = 0;
+};
+}  // namespace EthercatLifeCycleNode
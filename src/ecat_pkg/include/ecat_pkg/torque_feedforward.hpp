@@ -0,0 +1,104 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  torque_feedforward.hpp
+ * \brief Model based torque feedforward of servo drives in cyclic torque mode.
+ *
+ * Each cycle gravity torque is computed from measured joint positions with
+ * the robot's DH table and link masses, \see Kinematics::SerialChain, and
+ * friction from estimated velocities, \see StateEstimator :
+ *   tau_f = coulomb sat(v / friction_band) + viscous v
+ * Coulomb friction ramps linearly within friction_band, so it doesn't chatter
+ * around standstill. Result is in per thousand of rated torque and is sent as
+ * torque offset (0x60B2), drive adds it to target torque.
+ *
+ * One evaluation is a single pass over the joints with one sin/cos pair per
+ * joint, there is no allocation, it can run in every cycle at 4 kHz.
+ *******************************************************************************/
+#pragma once
+
+#include "kinematics.hpp"
+
+#include <cstdint>
+#include <algorithm>
+
+/// Robot model and drive units, one entry per drive.
+template <int N>
+struct FeedforwardModel
+{
+    Kinematics::DhLink   links[N];
+    Kinematics::LinkMass masses[N];
+    /// m/s^2 in base frame.
+    double gravity[3] = {0, 0, -9.81};
+    /// Joint value per encoder increment (gear ratio included) and joint value at position 0.
+    double joint_per_increment[N];
+    double joint_offset[N];
+    /// Joint torque (Nm, N for prismatic joints) that equals 1000 per thousand, rated torque times gear ratio.
+    double rated_torque[N];
+    float  coulomb[N];          /// per thousand
+    float  viscous[N];          /// per thousand / rpm
+    float  friction_band[N];    /// rpm, has to be positive
+    /// Limit of the sum in per thousand, a wrong model can't command more than that.
+    float  max_offset = 0;
+};
+
+template <int N>
+class TorqueFeedforward
+{
+    public:
+        explicit TorqueFeedforward(const FeedforwardModel<N> & model) : model_(model), chain_(model.links)
+        {
+        }
+
+        /// Model it was built from, flight recorder stores it for replay.
+        const FeedforwardModel<N> & GetModel() const { return model_; }
+
+        /// Computes torque offset of all N drives from actual position and estimated velocity.
+        void Compute(const int32_t * actual_pos, const float * velocity, int16_t * torque_offset) const
+        {
+            double q[N], gravity[N];
+            for(int i = 0 ; i < N ; i++){
+                q[i] = model_.joint_offset[i] + actual_pos[i] * model_.joint_per_increment[i];
+            }
+            chain_.GravityTorque(q, model_.masses, model_.gravity, gravity);
+            for(int i = 0 ; i < N ; i++){
+                const float v = velocity[i];
+                const float coulomb = std::min(std::max(v / model_.friction_band[i], -1.0f), 1.0f);
+                const float tau = float(gravity[i] * 1000.0 / model_.rated_torque[i]) +
+                                  model_.coulomb[i] * coulomb + model_.viscous[i] * v;
+                torque_offset[i] = int16_t(std::min(std::max(tau, -model_.max_offset), model_.max_offset));
+            }
+        }
+
+    private:
+        FeedforwardModel<N> model_;
+        Kinematics::SerialChain<N> chain_;
+};
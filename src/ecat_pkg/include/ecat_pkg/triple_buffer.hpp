@@ -0,0 +1,87 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  triple_buffer.hpp
+ * \brief Lock-free single writer/single reader exchange of the latest value.
+ *
+ * Three buffers : writer fills back buffer and swaps it with middle one,
+ * reader swaps middle buffer with its front buffer if it has been updated.
+ * Neither side ever waits or sees a partially written value, reader always
+ * gets the most recent complete one. Values written between two Acquire()
+ * calls are skipped, only the latest one is read.
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+template <typename T>
+class TripleBuffer
+{
+    public:
+        /// Sets all three buffers, e.g. to allocate them. Not thread safe, call before exchange starts.
+        void Reset(const T & value)
+        {
+            for(auto & buffer : buffers_){
+                buffer = value;
+            }
+        }
+        /// Writer : buffer to fill before Publish().
+        T & Write() { return buffers_[back_]; }
+        /// Writer : makes written value the latest one.
+        void Publish()
+        {
+            // Release makes written value visible to reader, acquire gets back buffer reader released.
+            back_ = middle_.exchange(back_ | kNewValue, std::memory_order_acq_rel) & kIndexMask;
+        }
+        /**
+         * @brief Reader : takes latest published value, if there is a new one.
+         * @return true if Read() now holds a value that wasn't read before.
+         */
+        bool Acquire()
+        {
+            if(!(middle_.load(std::memory_order_relaxed) & kNewValue)){
+                return false;
+            }
+            front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+            return true;
+        }
+        /// Reader : latest acquired value.
+        const T & Read() const { return buffers_[front_]; }
+    private:
+        static const uint8_t kIndexMask = 0x3;
+        static const uint8_t kNewValue  = 0x4;
+        T buffers_[3];
+        /// Index of middle buffer, kNewValue is set if writer published it after last Acquire().
+        std::atomic<uint8_t> middle_{1};
+        uint8_t back_  = 0;     /// Owned by writer.
+        uint8_t front_ = 2;     /// Owned by reader.
+};
@@ -0,0 +1,216 @@
+#include "alloc_tracker.hpp"
+#include "ecat_globals.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <execinfo.h>
+
+#if TRACK_RT_ALLOCATIONS
+/// glibc allocator entry points, interposed functions forward to these.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void  __libc_free(void* ptr);
+}
+#endif
+
+namespace
+{
+struct AllocationRecord
+{
+    AllocTracker::TrackedThread tag;
+    std::size_t size;
+    int depth;
+    void* frames[AllocTracker::kMaxBacktraceDepth];
+};
+
+std::atomic<bool>     g_tracking_enabled{false};
+std::atomic<uint64_t> g_allocation_count[AllocTracker::kNumOfTrackedThreads];
+std::atomic<uint32_t> g_num_of_records{0};
+AllocationRecord      g_records[AllocTracker::kMaxRecordedBacktraces];
+thread_local int      t_thread_tag = AllocTracker::kUntracked;
+/// Prevents recursion if backtrace() itself allocates.
+thread_local bool     t_in_tracker = false;
+
+inline void CountAllocation(std::size_t size)
+{
+    if(t_thread_tag == AllocTracker::kUntracked || t_in_tracker ||
+       !g_tracking_enabled.load(std::memory_order_relaxed)){
+        return;
+    }
+    g_allocation_count[t_thread_tag].fetch_add(1, std::memory_order_relaxed);
+#if TRACK_RT_ALLOCATIONS
+    uint32_t index = g_num_of_records.fetch_add(1, std::memory_order_relaxed);
+    if(index < AllocTracker::kMaxRecordedBacktraces){
+        t_in_tracker = true;
+        g_records[index].tag   = static_cast<AllocTracker::TrackedThread>(t_thread_tag);
+        g_records[index].size  = size;
+        g_records[index].depth = backtrace(g_records[index].frames, AllocTracker::kMaxBacktraceDepth);
+        t_in_tracker = false;
+    }
+#else
+    (void)size;
+#endif
+}
+
+#if TRACK_RT_ALLOCATIONS
+/// malloc already counts, operator new shouldn't count twice.
+inline void CountNewAllocation(std::size_t) {}
+#else
+inline void CountNewAllocation(std::size_t size) { CountAllocation(size); }
+#endif
+
+inline void* TrackedAllocate(std::size_t size)
+{
+    CountNewAllocation(size);
+    void* ptr = std::malloc(size ? size : 1);
+    if(!ptr){
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+}  // namespace
+
+void AllocTracker::Init()
+{
+    void* frames[2];
+    t_in_tracker = true;
+    backtrace(frames, 2);
+    t_in_tracker = false;
+}
+
+void AllocTracker::SetThreadTag(TrackedThread tag)
+{
+    t_thread_tag = tag;
+}
+
+void AllocTracker::Enable(bool enable)
+{
+    g_tracking_enabled.store(enable, std::memory_order_relaxed);
+}
+
+void AllocTracker::Reset()
+{
+    for(int i = 0 ; i < kNumOfTrackedThreads ; i++){
+        g_allocation_count[i].store(0, std::memory_order_relaxed);
+    }
+    g_num_of_records.store(0, std::memory_order_relaxed);
+}
+
+uint64_t AllocTracker::GetAllocationCount(TrackedThread tag)
+{
+    return g_allocation_count[tag].load(std::memory_order_relaxed);
+}
+
+uint32_t AllocTracker::PrintBacktraces(int fd)
+{
+    static const char* const kTagNames[kNumOfTrackedThreads] = {"untracked", "executor", "cyclic"};
+    uint32_t num_of_records = g_num_of_records.load(std::memory_order_relaxed);
+    if(num_of_records > kMaxRecordedBacktraces){
+        num_of_records = kMaxRecordedBacktraces;
+    }
+    for(uint32_t i = 0 ; i < num_of_records ; i++){
+        dprintf(fd, "Allocation %u in %s thread, %zu bytes :\n", i, kTagNames[g_records[i].tag], g_records[i].size);
+        backtrace_symbols_fd(g_records[i].frames, g_records[i].depth, fd);
+    }
+    return num_of_records;
+}
+
+#if TRACK_RT_ALLOCATIONS
+/// Replacement of C allocation functions, forwards to glibc.
+extern "C" {
+void* malloc(size_t size)
+{
+    CountAllocation(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size)
+{
+    CountAllocation(num * size);
+    return __libc_calloc(num, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    CountAllocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    CountAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    CountAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    CountAllocation(size);
+    void* mem = __libc_memalign(alignment, size);
+    if(!mem){
+        return ENOMEM;
+    }
+    *ptr = mem;
+    return 0;
+}
+
+void free(void* ptr)
+{
+    __libc_free(ptr);
+}
+}  // extern "C"
+#endif
+
+/// Replacement of global allocation functions.
+void* operator new(std::size_t size)
+{
+    return TrackedAllocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return TrackedAllocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    CountNewAllocation(size);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    CountNewAllocation(size);
+    return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
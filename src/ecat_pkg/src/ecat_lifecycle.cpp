@@ -1,27 +1,169 @@
 #include <ecat_lifecycle.hpp>
+#include <algorithm>
 
 using namespace EthercatLifeCycleNode ; 
 
+namespace
+{
+/// Mode drives are configured to in InitMaster(), drives return to it after homing.
+#if POSITION_MODE
+const int8_t kOperatingMode = kProfilePosition;
+#elif CYCLIC_POSITION_MODE
+const int8_t kOperatingMode = kCSPosition;
+#elif CYCLIC_VELOCITY_MODE
+const int8_t kOperatingMode = kCSVelocity;
+#elif CYCLIC_TORQUE_MODE
+const int8_t kOperatingMode = kCSTorque;
+#else
+const int8_t kOperatingMode = kProfileVelocity;
+#endif
+
+/// @return Gain array a joint controller parameter sets, NULL if name isn't one.
+float * JointGainOf(JointGains<g_kNumberOfServoDrivers> & gains, const std::string & name)
+{
+    if(name == "cst_kp")         return gains.kp;
+    if(name == "cst_kd")         return gains.kd;
+    if(name == "cst_kv")         return gains.kv;
+    if(name == "cst_ka")         return gains.ka;
+    if(name == "cst_max_torque") return gains.max_torque;
+    return NULL;
+}
+
+/// Copies a parameter that has one value for all drives or one value per drive, @return 0 if it has either.
+template <typename T>
+int CopyDriveValues(const rclcpp::Parameter & parameter, T * values)
+{
+    if(parameter.get_type() != rclcpp::ParameterType::PARAMETER_DOUBLE_ARRAY ||
+       (parameter.as_double_array().size() != 1 && parameter.as_double_array().size() != g_kNumberOfServoDrivers)){
+        return -1;
+    }
+    const std::vector<double> & array = parameter.as_double_array();
+    for(uint32_t i = 0 ; i < g_kNumberOfServoDrivers ; i++){
+        values[i] = array.size() == 1 ? array[0] : array[i];
+    }
+    return 0;
+}
+
+/// Same as CopyDriveValues() for bool arrays.
+int CopyDriveFlags(const rclcpp::Parameter & parameter, bool * values)
+{
+    if(parameter.get_type() != rclcpp::ParameterType::PARAMETER_BOOL_ARRAY ||
+       (parameter.as_bool_array().size() != 1 && parameter.as_bool_array().size() != g_kNumberOfServoDrivers)){
+        return -1;
+    }
+    const std::vector<bool> & array = parameter.as_bool_array();
+    for(uint32_t i = 0 ; i < g_kNumberOfServoDrivers ; i++){
+        values[i] = array.size() == 1 ? array[0] : array[i];
+    }
+    return 0;
+}
+}
+
 EthercatLifeCycle::EthercatLifeCycle(): LifecycleNode("ecat_node")
 {
-    
-    ecat_node_= std::make_unique<EthercatNode>();
-
-    received_data_.status_word.resize(g_kNumberOfServoDrivers);
-    received_data_.actual_pos.resize(g_kNumberOfServoDrivers);
-    received_data_.actual_vel.resize(g_kNumberOfServoDrivers);
-    received_data_.actual_tor.resize(g_kNumberOfServoDrivers);
-    received_data_.op_mode_display.resize(g_kNumberOfServoDrivers);
-
-    sent_data_.control_word.resize(g_kNumberOfServoDrivers);
-    sent_data_.target_pos.resize(g_kNumberOfServoDrivers);
-    sent_data_.target_vel.resize(g_kNumberOfServoDrivers);
-    sent_data_.target_tor.resize(g_kNumberOfServoDrivers);
+    // One entry per master (\see NUM_OF_MASTERS), master index in /etc/ethercat.conf and CPU its cyclic
+    // thread is pinned to. By default masters take the last CPUs, -1 leaves thread affinity unchanged.
+    std::vector<int64_t> default_indices, default_cpus;
+    const long num_of_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for(int m = 0 ; m < NUM_OF_MASTERS ; m++){
+        default_indices.push_back(m);
+        default_cpus.push_back(num_of_cpus - 1 - m > 0 ? num_of_cpus - 1 - m : -1);
+    }
+    std::vector<int64_t> master_indices = this->declare_parameter("master_indices", default_indices);
+    std::vector<int64_t> cpus = this->declare_parameter("cyclic_thread_cpus", default_cpus);
+    if(master_indices.size() != NUM_OF_MASTERS || cpus.size() != NUM_OF_MASTERS){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "master_indices and cyclic_thread_cpus need %d entries, using defaults.", NUM_OF_MASTERS);
+        master_indices = default_indices;
+        cpus = default_cpus;
+    }
+    // Secondary masters run their cycle shifted against control thread, so setpoints computed in this
+    // cycle are sent in this cycle as long as control logic takes less than the shift.
+    this->declare_parameter("secondary_phase_shift_ns",std::int32_t(PERIOD_NS/2));
+    ecat_node_= std::make_unique<EthercatNode>(master_indices[0], 0, g_kNumberOfSlavesPerMaster[0]);
+    control_cpu_ = cpus[0];
+    int first_slave = g_kNumberOfSlavesPerMaster[0];
+    for(int m = 1 ; m < NUM_OF_MASTERS ; m++){
+        secondary_masters_.push_back(std::make_unique<SecondaryMaster>(master_indices[m], first_slave,
+                                                                       g_kNumberOfSlavesPerMaster[m], cpus[m]));
+        first_slave += g_kNumberOfSlavesPerMaster[m];
+    }
+
+    // Fixed-size messages, only number of valid drives has to be specified.
+    received_data_.num_of_drives = g_kNumberOfServoDrivers;
+    sent_data_.num_of_drives     = g_kNumberOfServoDrivers;
     measurement_time = this->declare_parameter("measure_time",std::int32_t(1));
+    // Set to false to force copy based publishing, e.g. to compare it against loaned messages.
+    this->declare_parameter("loan_messages",true);
+    // Feedback is also published in batches of consecutive cycles, per cycle topic can be disabled.
+    this->declare_parameter("feedback_batch_size",std::int32_t(10));
+    this->declare_parameter("per_cycle_feedback",true);
+    // Set to true in regression runs, control loop stops if it allocates memory after warm-up.
+    fail_on_rt_allocation_ = this->declare_parameter("fail_on_rt_allocation",false);
+    // If set, recorded flight recorder file is replayed through control logic instead of live bus.
+    this->declare_parameter("replay_file",std::string(""));
+    // Flight recorder writes PDO images and loop state into rotating files, disabled by default.
+    this->declare_parameter("flight_recorder",false);
+    this->declare_parameter("flight_recorder_dir",std::string("flight_recorder"));
+    this->declare_parameter("flight_recorder_num_of_files",std::int32_t(4));
+    this->declare_parameter("flight_recorder_file_duration",std::int32_t(60));   // in seconds
+    // If enabled, startup SDOs drives already hold are skipped, \see sdo_cache.hpp
+    this->declare_parameter("sdo_cache",false);
+    this->declare_parameter("sdo_cache_file",std::string("sdo_cache.txt"));
+    // Last phase_trace_seconds of phase trace is written to phase_trace_file on "dump_phase_trace" service call.
+    this->declare_parameter("phase_trace_file",std::string("phase_trace.json"));
+    this->declare_parameter("phase_trace_seconds",5.0);
+    dump_phase_trace_service_ = this->create_service<std_srvs::srv::Trigger>("dump_phase_trace",
+                                  std::bind(&EthercatLifeCycle::HandleDumpPhaseTrace, this, std::placeholders::_1, std::placeholders::_2));
+    // Homing of all drives is started with "home_drives" service, drives that don't finish within homing_timeout
+    // seconds are stopped and switched back to operating mode. \see UpdateHoming()
+    this->declare_parameter("homing_timeout",30.0);
+    home_drives_service_ = this->create_service<std_srvs::srv::Trigger>("home_drives",
+                             std::bind(&EthercatLifeCycle::HandleHomeDrives, this, std::placeholders::_1, std::placeholders::_2));
+    // Encoder increments per motor revolution, converts between drive positions and velocities.
+    this->declare_parameter("increments_per_rev",4096.0);
+    // Smoothing of velocity and acceleration estimated from actual position in [0, 1), one value for all
+    // drives or one per drive. Larger is smoother and lags more, \see state_estimator.hpp
+    this->declare_parameter("velocity_filter_theta",std::vector<double>{0.95});
+    // Joint controller gains in cyclic torque mode, one value for all drives or one per drive. They can be
+    // changed while node is active. Units are drive's, \see joint_controller.hpp
+    this->declare_parameter("cst_kp",std::vector<double>{0.5});
+    this->declare_parameter("cst_kd",std::vector<double>{2.0});
+    this->declare_parameter("cst_kv",std::vector<double>{0.0});
+    this->declare_parameter("cst_ka",std::vector<double>{0.0});
+    this->declare_parameter("cst_max_torque",std::vector<double>{300.0});
+    HandleParameterChange(this->get_parameters({"cst_kp", "cst_kd", "cst_kv", "cst_ka", "cst_max_torque"}));
+    parameter_callback_handle_ = this->add_on_set_parameters_callback(
+                                   std::bind(&EthercatLifeCycle::HandleParameterChange, this, std::placeholders::_1));
+    // Gravity and friction feedforward in cyclic torque mode, sent as torque offset. Model is read on configure.
+    // Per drive values take one value for all drives or one per drive, \see torque_feedforward.hpp for units.
+    this->declare_parameter("feedforward.enable",false);
+    this->declare_parameter("feedforward.dh_a",std::vector<double>{0.0});       // mm
+    this->declare_parameter("feedforward.dh_alpha",std::vector<double>{0.0});   // rad
+    this->declare_parameter("feedforward.dh_d",std::vector<double>{0.0});       // mm
+    this->declare_parameter("feedforward.dh_theta",std::vector<double>{0.0});   // rad
+    // Joint variable of prismatic joints is added to dh_d, otherwise to dh_theta.
+    this->declare_parameter("feedforward.prismatic",std::vector<bool>{false});
+    this->declare_parameter("feedforward.joint_min",std::vector<double>{-M_PI}); // rad, mm for prismatic joints
+    this->declare_parameter("feedforward.joint_max",std::vector<double>{M_PI});
+    this->declare_parameter("feedforward.link_mass",std::vector<double>{0.0});  // kg
+    this->declare_parameter("feedforward.link_com_x",std::vector<double>{0.0}); // mm, in link's DH frame
+    this->declare_parameter("feedforward.link_com_y",std::vector<double>{0.0});
+    this->declare_parameter("feedforward.link_com_z",std::vector<double>{0.0});
+    this->declare_parameter("feedforward.gravity",std::vector<double>{0.0, 0.0, -9.81});
+    this->declare_parameter("feedforward.joint_per_increment",std::vector<double>{2 * M_PI / 4096}); // rad or mm
+    this->declare_parameter("feedforward.joint_offset",std::vector<double>{0.0});
+    this->declare_parameter("feedforward.rated_torque",std::vector<double>{1.0});  // Nm at joint
+    this->declare_parameter("feedforward.coulomb",std::vector<double>{0.0});
+    this->declare_parameter("feedforward.viscous",std::vector<double>{0.0});
+    this->declare_parameter("feedforward.friction_band",std::vector<double>{5.0}); // rpm
+    this->declare_parameter("feedforward.max_offset",300.0);
+    // Loop statistics are grouped into one second windows, cycles longer than threshold are counted as spike.
+    loop_stats_.Configure(FREQUENCY, this->declare_parameter("exec_spike_threshold_ns",std::int32_t(PERIOD_NS/4)));
 }
 
 EthercatLifeCycle::~EthercatLifeCycle()
 {
+    secondary_masters_.clear();
     ecat_node_.reset();
 }
 
@@ -39,19 +181,52 @@ node_interfaces::LifecycleNodeInterface::CallbackReturn EthercatLifeCycle::on_co
   // From http://www.opendds.org/qosusages.html: "A RELIABLE setting can potentially block while
   // trying to send." Therefore set the policy to best effort to avoid blocking during execution.
   qos.best_effort();
-    if(InitEthercatCommunication())
+    replay_mode_ = !this->get_parameter("replay_file").as_string().empty();
+    if(replay_mode_ ? InitReplay(this->get_parameter("replay_file").as_string()) : InitEthercatCommunication())
     {
         RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Configuration phase failed");
         return node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
     }else{
-        received_data_publisher_ = this->create_publisher<ecat_msgs::msg::DataReceived>("Slave_Feedback", qos);
-        sent_data_publisher_     = this->create_publisher<ecat_msgs::msg::DataSent>("Master_Commands", qos);
+        // Publishers and subscriptions use TLSF allocator instead of global heap.
+        rclcpp::PublisherOptionsWithAllocator<TLSFAllocator<void>> publisher_options;
+        publisher_options.allocator = tlsf_allocator_;
+        rclcpp::SubscriptionOptionsWithAllocator<TLSFAllocator<void>> subscription_options;
+        subscription_options.allocator = tlsf_allocator_;
+
+        received_data_publisher_ = this->create_publisher<ecat_msgs::msg::DataReceivedFixed>("Slave_Feedback", qos, publisher_options);
+        sent_data_publisher_     = this->create_publisher<ecat_msgs::msg::DataSentFixed>("Master_Commands", qos, publisher_options);
+        feedback_batch_publisher_ = this->create_publisher<ecat_msgs::msg::DataReceivedBatch>("Slave_Feedback_Batch", qos, publisher_options);
+        input_latency_publisher_  = this->create_publisher<ecat_msgs::msg::InputLatency>("input_latency", rclcpp::QoS(10), publisher_options);
+        latency_timer_ = this->create_wall_timer(std::chrono::seconds(1), std::bind(&EthercatLifeCycle::PublishInputLatency, this));
+        // Started in on_activate().
+        latency_timer_->cancel();
         joystick_subscriber_     = this->create_subscription<sensor_msgs::msg::Joy>("Controller", qos, 
-                                     std::bind(&EthercatLifeCycle::HandleControlNodeCallbacks, this,std::placeholders::_1));
+                                     std::bind(&EthercatLifeCycle::HandleControlNodeCallbacks, this,std::placeholders::_1),
+                                     subscription_options, joystick_msg_pool_);
         gui_subscriber_          = this->create_subscription<std_msgs::msg::UInt8>("gui_buttons", qos, 
-                                    std::bind(&EthercatLifeCycle::HandleGuiNodeCallbacks, this, std::placeholders::_1));
+                                    std::bind(&EthercatLifeCycle::HandleGuiNodeCallbacks, this, std::placeholders::_1),
+                                    subscription_options, gui_msg_pool_);
         haptic_subscriber_       =  this->create_subscription<ecat_msgs::msg::HapticCmd>("HapticInput",qos , 
-                                     std::bind(&EthercatLifeCycle::HandleHapticCmdCallbacks, this,std::placeholders::_1));
+                                     std::bind(&EthercatLifeCycle::HandleHapticCmdCallbacks, this,std::placeholders::_1),
+                                     subscription_options, haptic_msg_pool_);
+        loan_messages_ = this->get_parameter("loan_messages").as_bool() &&
+                         received_data_publisher_->can_loan_messages() && 
+                         sent_data_publisher_->can_loan_messages() &&
+                         feedback_batch_publisher_->can_loan_messages();
+        RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Feedback publishing uses %s.\n",
+                    loan_messages_ ? "loaned messages" : "preallocated messages");
+
+        per_cycle_feedback_ = this->get_parameter("per_cycle_feedback").as_bool();
+        int64_t batch_size  = this->get_parameter("feedback_batch_size").as_int();
+        if(batch_size < 1 || batch_size > ecat_msgs::msg::DataReceivedBatch::MAX_SAMPLES){
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "feedback_batch_size has to be in [1, %u], rebuild ecat_msgs with larger ECAT_MAX_FEEDBACK_BATCH if needed.",
+                         ecat_msgs::msg::DataReceivedBatch::MAX_SAMPLES);
+            return node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+        }
+        feedback_batch_size_ = batch_size;
+        feedback_batch_.num_of_samples = 0;
+        RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Feedback batches of %u cycles, per cycle feedback %s.\n",
+                    feedback_batch_size_, per_cycle_feedback_ ? "enabled" : "disabled");
         return node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
     }
 }
@@ -65,6 +240,9 @@ node_interfaces::LifecycleNodeInterface::CallbackReturn EthercatLifeCycle::on_ac
     }else{
         received_data_publisher_->on_activate();
         sent_data_publisher_->on_activate();
+        feedback_batch_publisher_->on_activate();
+        input_latency_publisher_->on_activate();
+        latency_timer_->reset();
         RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Activation complete, real-time communication started.");
         return node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
     }
@@ -73,18 +251,43 @@ node_interfaces::LifecycleNodeInterface::CallbackReturn EthercatLifeCycle::on_ac
 node_interfaces::LifecycleNodeInterface::CallbackReturn EthercatLifeCycle::on_deactivate(const State &)
 {
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Deactivating.");
+    ReportExecutorAllocations();
     received_data_publisher_->on_deactivate();
     sent_data_publisher_->on_deactivate();
-    ecat_node_->DeactivateCommunication();
+    feedback_batch_publisher_->on_deactivate();
+    input_latency_publisher_->on_deactivate();
+    latency_timer_->cancel();
+    if(!replay_mode_ && exchange_running_){
+        // Control loop disables drives and cyclic thread enters standby, master isn't released.
+        struct timespec request_time, time;
+        clock_gettime(CLOCK_TO_USE, &request_time);
+        control_active_ = false;
+        time = request_time;
+        while(!in_standby_ && exchange_running_ && DIFF_NS(request_time, time) < g_kNsPerSec){
+            usleep(1000);
+            clock_gettime(CLOCK_TO_USE, &time);
+        }
+        if(!in_standby_){
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Cyclic thread didn't enter standby.");
+            return node_interfaces::LifecycleNodeInterface::CallbackReturn::FAILURE;
+        }
+        RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Drives disabled, %.1f ms after deactivation request.",
+                    DIFF_NS(request_time, time) / 1e6);
+    }
     return node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
 }
 
 node_interfaces::LifecycleNodeInterface::CallbackReturn EthercatLifeCycle::on_cleanup(const State &)
 {
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Cleaning up.");
+    // Standby thread holds the masters, they are released when it leaves.
+    StopCyclicThread();
     ecat_node_.reset();
     received_data_publisher_.reset();
     sent_data_publisher_.reset();
+    feedback_batch_publisher_.reset();
+    latency_timer_.reset();
+    input_latency_publisher_.reset();
     return node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
 }
 
@@ -92,14 +295,28 @@ node_interfaces::LifecycleNodeInterface::CallbackReturn EthercatLifeCycle::on_sh
 {
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "On_Shutdown... Waiting for control thread.");
     sig = 0;
-    usleep(1e3);
-    pthread_join(ethercat_thread_,NULL);
+    const bool masters_released = cyclic_thread_started_ && !replay_mode_;
+    StopCyclicThread();
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Control thread terminated.");
-    ecat_node_->ReleaseMaster();
-    ecat_node_->ShutDownEthercatMaster();
+    flight_recorder_.Close();
+    ReportExecutorAllocations();
+    if(!replay_mode_ && ecat_node_){
+        // Cyclic thread releases masters when it leaves.
+        if(!masters_released){
+            ecat_node_->ReleaseMaster();
+        }
+        ecat_node_->ShutDownEthercatMaster();
+    }
     return node_interfaces::LifecycleNodeInterface::CallbackReturn::SUCCESS;
 }
 
+void EthercatLifeCycle::ReportExecutorAllocations()
+{
+    AllocTracker::Enable(false);
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Executor allocations after activation : %llu",
+                (unsigned long long)AllocTracker::GetAllocationCount(AllocTracker::kExecutorThread));
+}
+
 node_interfaces::LifecycleNodeInterface::CallbackReturn EthercatLifeCycle::on_error(const State &)
 {
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "On Error.");
@@ -109,6 +326,8 @@ node_interfaces::LifecycleNodeInterface::CallbackReturn EthercatLifeCycle::on_er
 
 void EthercatLifeCycle::HandleHapticCmdCallbacks(const ecat_msgs::msg::HapticCmd::SharedPtr haptic_msg)
 {
+    PhaseTrace::Scope trace(PhaseTrace::kHapticCallback);
+    haptic_latency_.SetSource(rclcpp::Time(haptic_msg->stamp).nanoseconds(), haptic_msg->seq);
     haptic_inputs_.x_axis_ = haptic_msg->array[0];
     haptic_inputs_.y_axis_ = haptic_msg->array[1];
     haptic_inputs_.z_axis_ = haptic_msg->array[2];
@@ -120,7 +339,11 @@ void EthercatLifeCycle::HandleHapticCmdCallbacks(const ecat_msgs::msg::HapticCmd
 
 void EthercatLifeCycle::HandleControlNodeCallbacks(const sensor_msgs::msg::Joy::SharedPtr msg)
 {
+    PhaseTrace::Scope trace(PhaseTrace::kJoystickCallback);
     //RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Joy Msgs : %.2f, %.2f",msg->axes[0],msg->axes[2]);
+    // Joy has no sequence number, source stamp is used as correlation id.
+    const int64_t source_ns = rclcpp::Time(msg->header.stamp).nanoseconds();
+    joystick_latency_.SetSource(source_ns, source_ns);
 
     controller_.left_x_axis_  = msg->axes[0];
     controller_.left_y_axis_  = msg->axes[1];
@@ -162,6 +385,7 @@ void EthercatLifeCycle::HandleControlNodeCallbacks(const sensor_msgs::msg::Joy::
 
 void EthercatLifeCycle::HandleGuiNodeCallbacks(const std_msgs::msg::UInt8::SharedPtr gui_sub)
 {
+    PhaseTrace::Scope trace(PhaseTrace::kGuiCallback);
     gui_node_data_ = gui_sub->data;
 }
 
@@ -184,11 +408,17 @@ int EthercatLifeCycle::SetComThreadPriorities()
     // for this feature to be active fist you have to modify GRUB_CMDLINE_LINUX_DEFAULT in /etc/default/grub 
     // add isolcpus=3 so after editing it will be ; GRUB_CMDLINE_LINUX_DEFAULT = "quiet splash isolcpus=3" 
     // save and exit, and type sudo update-grub and reboot.
-    //  cpu_set_t mask;
-    // CPU_ZERO(&mask);
-    // CPU_SET(3,&mask);
-
-    // int result = sched_setaffinity(0,sizeof(mask),&mask);
+    // Each master's thread is pinned to its own CPU, \see cyclic_thread_cpus parameter.
+    if(control_cpu_ >= 0){
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(control_cpu_,&mask);
+        err_ = pthread_attr_setaffinity_np(&ethercat_thread_attr_, sizeof(mask), &mask);
+        if (err_) {
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Error setting thread affinity to CPU %d ! ", control_cpu_);
+            return -1;
+        }
+    }
     /**********************************************************************************************/
     
     /* Set a specific stack size  */
@@ -215,6 +445,7 @@ int EthercatLifeCycle::SetComThreadPriorities()
         RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Pthread setinheritsched failed ! ");
         return -1 ;
     }
+    return 0 ;
 }
 
 int EthercatLifeCycle::InitEthercatCommunication()
@@ -225,19 +456,58 @@ int EthercatLifeCycle::InitEthercatCommunication()
         return -1 ;
     }
 
-    RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"Configuring EtherCAT master...\n");
-    if (ecat_node_->ConfigureMaster())
+    if (InitMaster(*ecat_node_)){
+        return -1 ;
+    }
+    for(auto & secondary : secondary_masters_){
+        if (InitMaster(secondary->GetNode())){
+            return -1 ;
+        }
+        secondary->AttachTo(*ecat_node_);
+    }
+    BindPdoViews();
+    const uint32_t homing_timeout_cycles = this->get_parameter("homing_timeout").as_double() * FREQUENCY;
+    for(auto & homing : homing_){
+        homing.Configure(kOperatingMode, homing_timeout_cycles);
+    }
+    if(InitControllers()){
+        return -1;
+    }
+    // Mode of operation is process data now, it has to be in the image before slaves go to OP.
+    ResetHoming();
+
+    // All masters exchange frames in the same loop, so none of them idles in OP while others start up.
+    std::vector<EthercatNode*> masters = {ecat_node_.get()};
+    for(auto & secondary : secondary_masters_){
+        masters.push_back(&secondary->GetNode());
+    }
+    if (EthercatNode::WaitForOperationalMode(masters)){
+        return -1 ;
+    }
+
+    if (SetComThreadPriorities()){
+        return -1 ;
+    }
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"Initialization succesfull...\n");
+    
+    return 0 ; 
+}
+
+int EthercatLifeCycle::InitMaster(EthercatNode & node)
+{
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"Configuring EtherCAT master %u...\n", node.GetMasterIndex());
+    if (node.ConfigureMaster())
     {
         return -1 ;
     }
 
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"Getting connected slave informations...\n");
-    if(ecat_node_->GetNumberOfConnectedSlaves()){
+    if(node.GetNumberOfConnectedSlaves()){
         return -1 ;
     }
 
-    ecat_node_->GetAllSlaveInformation();
-    for(int i = 0 ; i < NUM_OF_SLAVES ; i++){
+    node.GetAllSlaveInformation();
+    for(int i = node.GetFirstSlave() ; i < node.GetEndSlave() ; i++){
         RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"--------------------Slave Info -------------------------\n"
                "Slave alias         = %d\n "
                "Slave position      = %d\n "
@@ -245,17 +515,31 @@ int EthercatLifeCycle::InitEthercatCommunication()
                "Slave product_code  = 0x%08x\n "
                "Slave name          = %s\n "
                "--------------------EOF %d'th Slave Info ----------------\n ",
-                ecat_node_->slaves_[i].slave_info_.alias,
-                ecat_node_->slaves_[i].slave_info_.position,
-                ecat_node_->slaves_[i].slave_info_.vendor_id,
-                ecat_node_->slaves_[i].slave_info_.product_code,
-                ecat_node_->slaves_[i].slave_info_.name,i);
+                node.slaves_[i].slave_info_.alias,
+                node.slaves_[i].slave_info_.position,
+                node.slaves_[i].slave_info_.vendor_id,
+                node.slaves_[i].slave_info_.product_code,
+                node.slaves_[i].slave_info_.name,i);
     }
 
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"Configuring  slaves...\n");
-    if(ecat_node_->ConfigureSlaves()){
+    if(node.ConfigureSlaves()){
         return -1 ;
     }
+    if(this->get_parameter("sdo_cache").as_bool() &&
+       node.OpenSdoCache(this->get_parameter("sdo_cache_file").as_string())){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "SDO cache couldn't be opened, writing all parameters.");
+    }
+    // Homing at actual position (method 37) doesn't move, for homing on a mechanical limit use
+    // method -3/-4 with current threshold. Parameters are queued with operation mode parameters below.
+    HomingParam H = {};
+    H.homing_method = 37;
+    H.speed_for_switch_search = 100;
+    H.speed_for_zero_search = 10;
+    H.homing_acc = 1000;
+    H.curr_threshold_homing = 500;
+    H.home_offset = 0;
+    node.SetHomingParametersAll(H);
 #if VELOCITY_MODE
     ProfileVelocityParam P ;
     
@@ -264,7 +548,7 @@ int EthercatLifeCycle::InitEthercatCommunication()
     P.max_profile_vel = 1000 ;
     P.quick_stop_dec = 3e4 ;
     P.motion_profile_type = 0 ;
-    ecat_node_->SetProfileVelocityParametersAll(P);
+    node.SetProfileVelocityParametersAll(P);
 #endif
 
 #if POSITION_MODE
@@ -276,7 +560,7 @@ int EthercatLifeCycle::InitEthercatCommunication()
     P.max_profile_vel = 500; //100 ;
     P.quick_stop_dec = 3e4;//3e4 ;
     P.motion_profile_type = 0 ;
-    ecat_node_->SetProfilePositionParametersAll(P);
+    node.SetProfilePositionParametersAll(P);
 #endif
 
 #if CYCLIC_POSITION_MODE
@@ -288,7 +572,7 @@ int EthercatLifeCycle::InitEthercatCommunication()
     P.max_profile_vel = 100 ;
     P.quick_stop_dec = 3e4 ;
     P.interpolation_time_period = 0;//1 ;
-    ecat_node_->SetCyclicSyncPositionModeParametersAll(P);
+    node.SetCyclicSyncPositionModeParametersAll(P);
 #endif
 
 #if CYCLIC_VELOCITY_MODE
@@ -299,7 +583,7 @@ int EthercatLifeCycle::InitEthercatCommunication()
     P.profile_dec=3e4 ;
     P.quick_stop_dec = 3e4 ;
     P.interpolation_time_period = 0;//1 ;
-    ecat_node_->SetCyclicSyncVelocityModeParametersAll(P);
+    node.SetCyclicSyncVelocityModeParametersAll(P);
 #endif
 
 #if CYCLIC_TORQUE_MODE
@@ -307,45 +591,85 @@ int EthercatLifeCycle::InitEthercatCommunication()
     CSTorqueModeParam P ;
     P.profile_dec=3e4 ;
     P.quick_stop_dec = 3e4 ;
-    ecat_node_->SetCyclicSyncTorqueModeParametersAll(P);
+    // Motor data, gear and current controller gains are left at 0, drives keep values set with EPOS Studio.
+    node.SetCyclicSyncTorqueModeParametersAll(P);
 #endif
 
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"Mapping default PDOs...\n");
-    if(ecat_node_->MapDefaultPdos()){
+    if(node.MapDefaultPdos()){
         return  -1 ;
     }
 
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"Configuring DC synchronization...\n");
-    ecat_node_->ConfigDcSyncDefault();
+    node.ConfigDcSyncDefault();
 
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"Activating master...\n");
-    if(ecat_node_->ActivateMaster()){
+    if(node.ActivateMaster()){
         return  -1 ;
     }
 
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"Registering master domain...\n");
-    if (ecat_node_->RegisterDomain()){
+    if (node.RegisterDomain()){
         return  -1 ;
     }
 
-    if (ecat_node_->WaitForOperationalMode()){
-        return -1 ;
-    }
-
-    if (SetComThreadPriorities()){
-        return -1 ;
-    }
-    RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"Initialization succesfull...\n");
-    
-    return 0 ; 
+    return 0 ;
 }
 
 int  EthercatLifeCycle::StartEthercatCommunication()
 {
+    clock_gettime(CLOCK_TO_USE, &activation_request_time_);
+    if(cyclic_thread_started_){
+        if(replay_mode_ || !exchange_running_){
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Cyclic thread has stopped, cleanup and configure node again.");
+            return -1;
+        }
+        // Warm restart, master and slave configuration are kept by standby loop. \see Standby()
+        RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Resuming control loop from standby.\n");
+        control_active_ = true;
+        return 0;
+    }
+    cyclic_thread_started_ = true;
+    if(replay_mode_){
+        // Replay runs as fast as possible, no real-time attributes needed.
+        err_ = pthread_create(&ethercat_thread_, NULL, &EthercatLifeCycle::PassReplay, this);
+        if(err_){
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Error : Couldn't start replay thread.!");
+            cyclic_thread_started_ = false;
+            return -1;
+        }
+        return 0;
+    }
+    if(this->get_parameter("flight_recorder").as_bool()){
+        // Recording is only for diagnosis, communication starts even if recorder can't be opened.
+        if(flight_recorder_.Open(this->get_parameter("flight_recorder_dir").as_string(),
+                                 this->get_parameter("flight_recorder_num_of_files").as_int(),
+                                 this->get_parameter("flight_recorder_file_duration").as_int() * FREQUENCY,
+                                 ecrt_domain_size(ecat_node_->master_domain_), ecat_node_->slaves_,
+                                 estimator_.GetParameters(), feedforward_ ? &feedforward_->GetModel() : nullptr)){
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Flight recorder couldn't be opened, continuing without recording.");
+        }
+    }
+    // Secondary masters start their cycles relative to the same time as control thread.
+    clock_gettime(CLOCK_TO_USE, &cycle_start_time_);
+    const int32_t phase_shift_ns = this->get_parameter("secondary_phase_shift_ns").as_int();
+    if(phase_shift_ns < 0 || phase_shift_ns >= int32_t(PERIOD_NS)){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "secondary_phase_shift_ns has to be in [0, %d).", int(PERIOD_NS));
+        return -1;
+    }
+    for(auto & secondary : secondary_masters_){
+        if(secondary->Start(cycle_start_time_, phase_shift_ns, ethercat_sched_param_.sched_priority)){
+            return -1;
+        }
+    }
+    control_active_   = true;
+    exchange_running_ = true;
     err_= pthread_create(&ethercat_thread_,&ethercat_thread_attr_, &EthercatLifeCycle::PassCycylicExchange,this);
     if(err_)
     {
         RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Error : Couldn't start communication thread.!");
+        exchange_running_ = false;
+        cyclic_thread_started_ = false;
         return -1 ; 
     }
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Communication thread called.\n");
@@ -360,11 +684,41 @@ void *EthercatLifeCycle::PassCycylicExchange(void *arg)
 void EthercatLifeCycle::StartPdoExchange(void *instance)
 {
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Starting PDO exchange....\n");
+    AllocTracker::SetThreadTag(AllocTracker::kCyclicThread);
+    PhaseTrace::RegisterThread("control loop");
+    struct timespec wake_up_time = cycle_start_time_;
+    uint64_t cycle_count = 0;
+
+    // Deactivation only stops control loop, thread stays in standby until node is activated again.
+    while(!RunControlSession(wake_up_time, cycle_count) && !Standby(wake_up_time, cycle_count)){
+    }
+
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Leaving control thread.");
+    ecat_node_->DeactivateCommunication();
+    for(auto & secondary : secondary_masters_){
+        // Disable command has been sent by secondary threads before control loop stopped.
+        secondary->Stop();
+        RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Master %u : %llu cycles without new input image, %llu output stalls.",
+                    secondary->GetNode().GetMasterIndex(), (unsigned long long)secondary->GetMissedImages(),
+                    (unsigned long long)secondary->GetOutputStalls());
+        secondary->GetNode().DeactivateCommunication();
+    }
+    exchange_running_ = false;
+    if(rt_allocation_detected_){
+        // Stops executor in main, process exits with error code.
+        rclcpp::shutdown();
+    }
+}// StartPdoExchange end
+
+int EthercatLifeCycle::RunControlSession(struct timespec & wake_up_time, uint64_t & cycle_count)
+{
     // Measurement time in minutes, e.g.
     uint32_t print_max_min = measurement_time * 60000 ; 
     uint32_t print_val = 1e4;
     int error_check=0;
-    struct timespec wake_up_time, time, publish_time_start={}, publish_time_end={};
+    // Set when measurement_time is over, control thread ends instead of going to standby.
+    bool measurement_finished = false;
+    struct timespec time, publish_time_start={}, publish_time_end={};
     #if MEASURE_TIMING
         struct timespec start_time, end_time, last_start_time = {};
         uint32_t period_ns = 0, exec_ns = 0, latency_ns = 0,
@@ -377,8 +731,6 @@ void EthercatLifeCycle::StartPdoExchange(void *instance)
         int32_t jitter = 0 , jitter_min = 0xfffffff, jitter_max = 0, old_latency=0;
 
     #endif
-    // get current time
-    clock_gettime(CLOCK_TO_USE, &wake_up_time);
     int begin=1e4;
     int status_check_counter = 1000;
     
@@ -386,16 +738,17 @@ void EthercatLifeCycle::StartPdoExchange(void *instance)
     // CKim - Initialization loop before entring control loop. 
     // Switch On and Enable Driver
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Enabling motors...");
-    while(sig)
+    while(sig && keep_exchanging_ && control_active_)
     {
         // CKim - Sleep for 1 ms
         wake_up_time = timespec_add(wake_up_time, g_cycle_time);
         clock_nanosleep(CLOCK_TO_USE, TIMER_ABSTIME, &wake_up_time, NULL);
-        ecrt_master_application_time(g_master, TIMESPEC2NS(wake_up_time));
+        ecrt_master_application_time(ecat_node_->master_, TIMESPEC2NS(wake_up_time));
 
         // CKim - Receive process data
-        ecrt_master_receive(g_master);
-        ecrt_domain_process(g_master_domain);
+        ecrt_master_receive(ecat_node_->master_);
+        ecrt_domain_process(ecat_node_->master_domain_);
+        ReceiveSecondaryImages();
         ReadFromSlaves();
 
         // CKim - Initialize target pos and vel
@@ -410,7 +763,9 @@ void EthercatLifeCycle::StartPdoExchange(void *instance)
         if(EnableDrivers()==g_kNumberOfServoDrivers)
         
         {
-            RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "All drives enabled");
+            clock_gettime(CLOCK_TO_USE, &time);
+            RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "All drives enabled, %.1f ms after activation request",
+                        DIFF_NS(activation_request_time_, time) / 1e6);
             break;
         }
 
@@ -424,20 +779,20 @@ void EthercatLifeCycle::StartPdoExchange(void *instance)
             if(ecat_node_->CheckMasterState() < 0 )
             {
                 RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Connection error, check your physical connection.");
-                al_state_ = g_master_state.al_states ; 
+                al_state_ = GetAlStates() ; 
                 received_data_.emergency_switch_val=0;
                 emergency_status_=0;
-                PublishAllData();
+                // Published with this cycle's data below, publishing here too would append the cycle twice.
                 error_check++;                    
                 if(error_check==5)
-                    return;
+                    return -1;
             }
             else
             {
                 //ecat_node_->CheckMasterDomainState();
                 //ecat_node_->CheckSlaveConfigurationState();
                 error_check=0;
-                al_state_ = g_master_state.al_states ; 
+                al_state_ = GetAlStates() ; 
                 status_check_counter = 1000;
 
                 for(int i=0; i<g_kNumberOfServoDrivers; i++)
@@ -453,23 +808,33 @@ void EthercatLifeCycle::StartPdoExchange(void *instance)
         
         //WriteToSlavesInPositionMode();
         WriteToSlavesVelocityMode();
-        ecrt_domain_queue(g_master_domain);
+        SendSecondaryImages();
+        ecrt_domain_queue(ecat_node_->master_domain_);
         // CKim - Sync Timer
         clock_gettime(CLOCK_TO_USE, &time);
-        ecrt_master_sync_reference_clock_to(g_master, TIMESPEC2NS(time));
-        ecrt_master_sync_slave_clocks(g_master);
+        ecrt_master_sync_reference_clock_to(ecat_node_->master_, TIMESPEC2NS(time));
+        ecrt_master_sync_slave_clocks(ecat_node_->master_);
 
         // CKim - Send process data
-        ecrt_master_send(g_master);
+        ecrt_master_send(ecat_node_->master_);
+        // Enabling cycles aren't recorded, counting them makes replay see a gap before first control cycle.
+        cycle_count++;
     }// while(sig)
     RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "All motors enabled, entering control loop");
+    // References of last session or of a never run controller would pull drives away, control starts
+    // from where drives stand. Feedback is the one read in last enabling cycle.
+    for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
+        joint_controller_.Hold(i, received_data_.actual_pos[i]);
+    }
 
     // ------------------------------------------------------- //
     // CKim - All motors enabled. Start control loop
-    while(sig){
+    while(sig && keep_exchanging_ && control_active_){
+        PhaseTrace::Mark(PhaseTrace::kSleep);
         wake_up_time = timespec_add(wake_up_time, g_cycle_time);
         clock_nanosleep(CLOCK_TO_USE, TIMER_ABSTIME, &wake_up_time, NULL);
-        ecrt_master_application_time(g_master, TIMESPEC2NS(wake_up_time));
+        PhaseTrace::Mark(PhaseTrace::kReceive);
+        ecrt_master_application_time(ecat_node_->master_, TIMESPEC2NS(wake_up_time));
         
         #if MEASURE_TIMING
             clock_gettime(CLOCK_TO_USE, &start_time);
@@ -490,6 +855,7 @@ void EthercatLifeCycle::StartPdoExchange(void *instance)
                 if(exec_ns < exec_min)              exec_min    = exec_ns;
                 if(latency_ns < latency_min)        latency_min = latency_ns;
                 if(jitter < jitter_min)             jitter_min  = jitter;
+                loop_stats_.AddCycle(exec_ns, latency_ns);
             }
 
             if (latency_ns > latency_max_ns)  {
@@ -513,9 +879,22 @@ void EthercatLifeCycle::StartPdoExchange(void *instance)
         #endif
 
         // receive process data
-        ecrt_master_receive(g_master);
-        ecrt_domain_process(g_master_domain);
+        ecrt_master_receive(ecat_node_->master_);
+        PhaseTrace::Mark(PhaseTrace::kDomainProcess);
+        ecrt_domain_process(ecat_node_->master_domain_);
+        ReceiveSecondaryImages();
+        // Flight recorder slot for this cycle, input image is saved right after it's processed.
+        FlightRecorder::CycleRecord * record = flight_recorder_.BeginRecord();
+        if(record){
+            record->cycle      = cycle_count;
+            record->wake_up_ns = TIMESPEC2NS(wake_up_time);
+            clock_gettime(CLOCK_TO_USE, &time);
+            record->start_ns   = TIMESPEC2NS(time);
+            flight_recorder_.SaveInputImage(ecat_node_->slaves_[0].slave_pdo_domain_);
+        }
+        cycle_count++;
 
+        PhaseTrace::Mark(PhaseTrace::kStatusCheck);
         if (status_check_counter){
             status_check_counter--;
         }
@@ -523,18 +902,18 @@ void EthercatLifeCycle::StartPdoExchange(void *instance)
             // Checking master/domain/slaves state every 1sec.
                if(ecat_node_->CheckMasterState() < 0 ){
                     RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Connection error, check your physical connection.");
-                    al_state_ = g_master_state.al_states ; 
+                    al_state_ = GetAlStates() ; 
                     received_data_.emergency_switch_val=0;
                     emergency_status_=0;
-                    PublishAllData();
+                    // Published with this cycle's data below, publishing here too would append the cycle twice.
                     error_check++;                    
                     if(error_check==5)
-                        return;
+                        return -1;
                     }else{
                         // ecat_node_->CheckMasterDomainState();
                         // ecat_node_->CheckSlaveConfigurationState();
                         error_check=0;
-                        al_state_ = g_master_state.al_states ; 
+                        al_state_ = GetAlStates() ; 
                         status_check_counter = 1000;
                     }
             }
@@ -545,6 +924,7 @@ void EthercatLifeCycle::StartPdoExchange(void *instance)
         #endif
         
         // timer_info_.GetTime();
+        PhaseTrace::Mark(PhaseTrace::kPublish);
         PublishAllData();
         // timer_info_.MeasureTimeDifference();
         // if(timer_info_.counter_==NUMBER_OF_SAMPLES){
@@ -601,6 +981,8 @@ void EthercatLifeCycle::StartPdoExchange(void *instance)
             if(!print_max_min){
                 //RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"Publish time min: %10d ns  | max : %10d ns\n",
                 //publish_time_min, publish_time_max);
+                RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Measurement time is over, stopping control thread.");
+                measurement_finished = true;
                 break;
             }
                 print_max_min--;        
@@ -614,114 +996,649 @@ void EthercatLifeCycle::StartPdoExchange(void *instance)
                 latency_min_ns = 0xffffffff;
         #endif
 
+        PhaseTrace::Mark(PhaseTrace::kRead);
         ReadFromSlaves();
-#if POSITION_MODE
-        UpdateMotorStatePositionMode();
-        UpdatePositionModeParameters();
-        WriteToSlavesInPositionMode();
-#endif
-#if CYCLIC_POSITION_MODE
-    UpdateMotorStatePositionMode();
-    UpdateCyclicPositionModeParameters();
-    WriteToSlavesInPositionMode();
-#endif 
-#if VELOCITY_MODE
-        UpdateMotorStateVelocityMode();
-        UpdateVelocityModeParameters();
-        WriteToSlavesVelocityMode();
-#endif
-#if CYCLIC_VELOCITY_MODE
-        UpdateMotorStateVelocityMode();
-        UpdateCyclicVelocityModeParameters();
-        WriteToSlavesVelocityMode();
-#endif
-#if CYCLIC_TORQUE_MODE
-        UpdateMotorStateVelocityMode();
-        UpdateCyclicTorqueModeParameters();
-        WriteToSlavesInCyclicTorqueMode();
-#endif
-        ecrt_domain_queue(g_master_domain);
+        const bool homing_start = homing_requested_.exchange(false);
+        if(record){
+            record->controller       = controller_;
+            record->haptic_inputs    = haptic_inputs_;
+            record->command          = command_;
+            record->gui_node_data    = gui_node_data_;
+            record->emergency_status = emergency_status_;
+            record->al_state         = al_state_;
+            record->estimator        = estimator_.GetState();
+            record->joint_controller = joint_controller_.GetState();
+            record->homing_start     = homing_start;
+            memcpy(record->motor_state, motor_state_, sizeof(motor_state_));
+            std::copy(homing_, homing_ + g_kNumberOfServoDrivers, record->homing);
+        }
+        // Inputs are latched here, latency is completed once the frame is sent.
+        clock_gettime(CLOCK_REALTIME, &time);
+        joystick_latency_.Latch(TIMESPEC2NS(time));
+        haptic_latency_.Latch(TIMESPEC2NS(time));
+        StepControl(homing_start);
+        SendSecondaryImages();
+        PhaseTrace::Mark(PhaseTrace::kRecord);
+        if(record){
+            record->received_data = received_data_;
+            record->sent_data     = sent_data_;
+            // Gains changed by parameters are acquired in StepControl(), these are the ones this cycle used.
+            record->joint_gains   = joint_controller_.GetActiveGains();
+            flight_recorder_.SaveOutputImage(ecat_node_->slaves_[0].slave_pdo_domain_);
+            clock_gettime(CLOCK_TO_USE, &time);
+            record->end_ns = TIMESPEC2NS(time);
+            flight_recorder_.CommitRecord();
+        }
+        PhaseTrace::Mark(PhaseTrace::kQueue);
+        ecrt_domain_queue(ecat_node_->master_domain_);
+        PhaseTrace::Mark(PhaseTrace::kSync);
         clock_gettime(CLOCK_TO_USE, &time);
-        ecrt_master_sync_reference_clock_to(g_master, TIMESPEC2NS(time));
-        ecrt_master_sync_slave_clocks(g_master);
+        ecrt_master_sync_reference_clock_to(ecat_node_->master_, TIMESPEC2NS(time));
+        ecrt_master_sync_slave_clocks(ecat_node_->master_);
         // send process data
-        ecrt_master_send(g_master);
+        PhaseTrace::Mark(PhaseTrace::kSend);
+        ecrt_master_send(ecat_node_->master_);
+        clock_gettime(CLOCK_REALTIME, &time);
+        joystick_latency_.Sent(TIMESPEC2NS(time));
+        haptic_latency_.Sent(TIMESPEC2NS(time));
         
-        if(begin) begin--;
+        if(begin){
+            begin--;
+            if(!begin){
+                // Warm-up finished, executor and control loop should be allocation free from now on.
+                AllocTracker::Reset();
+                AllocTracker::Enable(true);
+                #if MEASURE_TIMING
+                    loop_stats_.Start();
+                #endif
+            }
+        }else if(fail_on_rt_allocation_ && AllocTracker::GetAllocationCount(AllocTracker::kCyclicThread)){
+            rt_allocation_detected_ = true;
+            break;
+        }
         #if MEASURE_TIMING
                 clock_gettime(CLOCK_TO_USE, &end_time);
         #endif
     }//while(1/sig) //Ctrl+C signal
+    PhaseTrace::Mark(PhaseTrace::kIdle);
+    AllocTracker::Enable(false);
+    const uint64_t rt_allocations = AllocTracker::GetAllocationCount(AllocTracker::kCyclicThread);
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Control loop allocations after warm-up : %llu",
+                (unsigned long long)rt_allocations);
+    #if TRACK_RT_ALLOCATIONS
+        // Backtraces are only recorded by malloc interposer.
+        if(rt_allocations){
+            AllocTracker::PrintBacktraces(STDERR_FILENO);
+        }
+    #endif
+    if(rt_allocation_detected_){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Control loop allocated memory after warm-up, stopping.");
+    }
+    #if MEASURE_TIMING
+        RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"Publish time (%s) min: %10d ns  | max : %10d ns\n",
+                    loan_messages_ ? "loaned" : "copy", publish_time_min, publish_time_max);
+        loop_stats_.Print();
+    #endif
     
     // ------------------------------------------------------- //
     // CKim - Disable drivers before exiting
     wake_up_time = timespec_add(wake_up_time, g_cycle_time);
     clock_nanosleep(CLOCK_TO_USE, TIMER_ABSTIME, &wake_up_time, NULL);
-    ecrt_master_application_time(g_master, TIMESPEC2NS(wake_up_time));
+    ecrt_master_application_time(ecat_node_->master_, TIMESPEC2NS(wake_up_time));
 
-    ecrt_master_receive(g_master);
-    ecrt_domain_process(g_master_domain);
+    ecrt_master_receive(ecat_node_->master_);
+    ecrt_domain_process(ecat_node_->master_domain_);
+    ReceiveSecondaryImages();
 
     ReadFromSlaves();
     for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++)
     {
         sent_data_.control_word[i] = SM_GO_SWITCH_ON_DISABLE;
     }
+    ResetHoming();
     WriteToSlavesVelocityMode();
+    SendSecondaryImages();
 
-    ecrt_domain_queue(g_master_domain);
-    ecrt_master_send(g_master);
-    usleep(10000);
+    ecrt_domain_queue(ecat_node_->master_domain_);
+    ecrt_master_send(ecat_node_->master_);
+    cycle_count++;
     // ------------------------------------------------------- //
+    if(!sig || !keep_exchanging_ || rt_allocation_detected_ || measurement_finished){
+        // Disable command has to reach slaves and secondary threads before masters are released.
+        usleep(10000);
+        return -1;
+    }
+    return 0;
+}// RunControlSession end
 
-    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Leaving control thread.");
-    ecat_node_->DeactivateCommunication();
-    return;
-}// StartPdoExchange end
-
-void EthercatLifeCycle::ReadFromSlaves()
+int EthercatLifeCycle::Standby(struct timespec & wake_up_time, uint64_t & cycle_count)
 {
+    struct timespec time;
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Control loop stopped, drives disabled. Keeping master in standby.");
     for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
-        received_data_.actual_pos[i]  = EC_READ_S32(ecat_node_->slaves_[i].slave_pdo_domain_ +ecat_node_->slaves_[i].offset_.actual_pos);
-        received_data_.actual_vel[i]  = EC_READ_S32(ecat_node_->slaves_[i].slave_pdo_domain_ +ecat_node_->slaves_[i].offset_.actual_vel);
-        received_data_.status_word[i] = EC_READ_U16(ecat_node_->slaves_[i].slave_pdo_domain_ +ecat_node_->slaves_[i].offset_.status_word);
-        received_data_.actual_tor[i]  = EC_READ_S16(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.actual_tor);
+        sent_data_.control_word[i] = SM_GO_SWITCH_ON_DISABLE;
+        sent_data_.target_vel[i] = 0;
     }
-    received_data_.com_status = al_state_ ; 
-    #if CUSTOM_SLAVE
-        received_data_.right_limit_switch_val = EC_READ_U8(ecat_node_->slaves_[FINAL_SLAVE].slave_pdo_domain_ +ecat_node_->slaves_[FINAL_SLAVE].offset_.r_limit_switch);
-        received_data_.left_limit_switch_val  = EC_READ_U8(ecat_node_->slaves_[FINAL_SLAVE].slave_pdo_domain_ +ecat_node_->slaves_[FINAL_SLAVE].offset_.l_limit_switch);
-        received_data_.emergency_switch_val = EC_READ_U8(ecat_node_->slaves_[FINAL_SLAVE].slave_pdo_domain_ +ecat_node_->slaves_[FINAL_SLAVE].offset_.emergency_switch);
-        emergency_status_  = received_data_.emergency_switch_val;
-    #else
-    emergency_status_ = 1;    
+    int status_check_counter = 1000;
+    int error_check = 0;
+    in_standby_ = true;
+    while(sig && keep_exchanging_ && !control_active_){
+        // Same exchange as control loop without control logic and publishing, keeps watchdogs and DC sync alive.
+        wake_up_time = timespec_add(wake_up_time, g_cycle_time);
+        clock_nanosleep(CLOCK_TO_USE, TIMER_ABSTIME, &wake_up_time, NULL);
+        ecrt_master_application_time(ecat_node_->master_, TIMESPEC2NS(wake_up_time));
+
+        ecrt_master_receive(ecat_node_->master_);
+        ecrt_domain_process(ecat_node_->master_domain_);
+        ReceiveSecondaryImages();
+        ReadFromSlaves();
+
+        // Checking master state every 1sec like control loop, so com_status is current on activation.
+        if (status_check_counter){
+            status_check_counter--;
+        }
+        else {
+            if(ecat_node_->CheckMasterState() < 0 ){
+                RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Connection error, check your physical connection.");
+                al_state_ = GetAlStates() ;
+                received_data_.emergency_switch_val=0;
+                emergency_status_=0;
+                error_check++;
+                if(error_check==5){
+                    in_standby_ = false;
+                    return -1;
+                }
+            }else{
+                error_check=0;
+                al_state_ = GetAlStates() ;
+                status_check_counter = 1000;
+            }
+        }
+
+        WriteToSlavesVelocityMode();
+        SendSecondaryImages();
+        ecrt_domain_queue(ecat_node_->master_domain_);
+        clock_gettime(CLOCK_TO_USE, &time);
+        ecrt_master_sync_reference_clock_to(ecat_node_->master_, TIMESPEC2NS(time));
+        ecrt_master_sync_slave_clocks(ecat_node_->master_);
+        ecrt_master_send(ecat_node_->master_);
+        cycle_count++;
+    }
+    in_standby_ = false;
+    return (sig && keep_exchanging_) ? 0 : -1;
+}
+
+void EthercatLifeCycle::StopCyclicThread()
+{
+    if(!cyclic_thread_started_){
+        return;
+    }
+    keep_exchanging_ = false;
+    pthread_join(ethercat_thread_, NULL);
+    cyclic_thread_started_ = false;
+    keep_exchanging_ = true;
+    for(auto & secondary : secondary_masters_){
+        secondary->Stop();
+    }
+}
+
+void EthercatLifeCycle::UpdateControlLogic()
+{
+#if POSITION_MODE
+    PhaseTrace::Mark(PhaseTrace::kStateMachine);
+    UpdateMotorStatePositionMode();
+    PhaseTrace::Mark(PhaseTrace::kUpdate);
+    UpdatePositionModeParameters();
+    PhaseTrace::Mark(PhaseTrace::kWrite);
+    WriteToSlavesInPositionMode();
+#endif
+#if CYCLIC_POSITION_MODE
+    PhaseTrace::Mark(PhaseTrace::kStateMachine);
+    UpdateMotorStatePositionMode();
+    PhaseTrace::Mark(PhaseTrace::kUpdate);
+    UpdateCyclicPositionModeParameters();
+    PhaseTrace::Mark(PhaseTrace::kWrite);
+    WriteToSlavesInPositionMode();
+#endif 
+#if VELOCITY_MODE
+    PhaseTrace::Mark(PhaseTrace::kStateMachine);
+    UpdateMotorStateVelocityMode();
+    PhaseTrace::Mark(PhaseTrace::kUpdate);
+    UpdateVelocityModeParameters();
+    PhaseTrace::Mark(PhaseTrace::kWrite);
+    WriteToSlavesVelocityMode();
+#endif
+#if CYCLIC_VELOCITY_MODE
+    PhaseTrace::Mark(PhaseTrace::kStateMachine);
+    UpdateMotorStateVelocityMode();
+    PhaseTrace::Mark(PhaseTrace::kUpdate);
+    UpdateCyclicVelocityModeParameters();
+    PhaseTrace::Mark(PhaseTrace::kWrite);
+    WriteToSlavesVelocityMode();
+#endif
+#if CYCLIC_TORQUE_MODE
+    PhaseTrace::Mark(PhaseTrace::kStateMachine);
+    UpdateMotorStateVelocityMode();
+    PhaseTrace::Mark(PhaseTrace::kUpdate);
+    UpdateCyclicTorqueModeParameters();
+    PhaseTrace::Mark(PhaseTrace::kWrite);
+    WriteToSlavesInCyclicTorqueMode();
+#endif
+}
+
+int EthercatLifeCycle::InitReplay(const std::string & replay_file)
+{
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Replay mode, opening %s...\n", replay_file.c_str());
+    if(replay_file_.Open(replay_file)){
+        return -1;
+    }
+    if(replay_file_.GetNumOfRecords() < 2){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Replay file needs at least two records.");
+        return -1;
+    }
+    if(NUM_OF_MASTERS > 1){
+        // Recorder only has the image of first master.
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Replay supports single master only.");
+        return -1;
+    }
+    // Slaves read/write replay image instead of master's domain, offsets are the recorded ones.
+    const FlightRecorder::FileHeader & header = replay_file_.GetHeader();
+    replay_domain_.assign(header.domain_size, 0);
+    for(int i = 0 ; i < NUM_OF_SLAVES ; i++){
+        ecat_node_->slaves_[i].slave_pdo_domain_ = replay_domain_.data();
+        ecat_node_->slaves_[i].offset_ = header.offsets[i];
+    }
+    BindPdoViews();
+    if(InitControllers()){
+        return -1;
+    }
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Replay file has %llu records, domain size %u bytes.\n",
+                (unsigned long long)replay_file_.GetNumOfRecords(), header.domain_size);
+    return 0;
+}
+
+void EthercatLifeCycle::ReceiveSecondaryImages()
+{
+    for(auto & secondary : secondary_masters_){
+        secondary->ReceiveImage();
+    }
+}
+
+void EthercatLifeCycle::SendSecondaryImages()
+{
+    for(auto & secondary : secondary_masters_){
+        secondary->SendImage();
+    }
+}
+
+uint8_t EthercatLifeCycle::GetAlStates() const
+{
+    // Each bit stands for a state at least one slave is in, so states of all masters are or'ed.
+    uint8_t al_states = ecat_node_->master_state_.al_states;
+    for(auto & secondary : secondary_masters_){
+        al_states |= secondary->GetAlStates();
+    }
+    return al_states;
+}
+
+void EthercatLifeCycle::BindPdoViews()
+{
+    EthercatNode & node = *ecat_node_;
+    node.drivers_.ForEach([&node](auto & driver, int i){
+        driver.Bind(node.slaves_[i]);
+    });
+}
+
+void *EthercatLifeCycle::PassReplay(void *arg)
+{
+    static_cast<EthercatLifeCycle*>(arg)->Replay();
+    return NULL;
+}
+
+void EthercatLifeCycle::Replay()
+{
+    const uint32_t domain_size = replay_file_.GetHeader().domain_size;
+    const uint64_t num_of_records = replay_file_.GetNumOfRecords();
+    uint64_t compared = 0, mismatches = 0, skipped = 0;
+    int64_t exec_ns, exec_max_ns = 0, exec_total_ns = 0;
+    struct timespec start_time, end_time;
+
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Replaying %llu cycles...\n", (unsigned long long)num_of_records - 1);
+    for(uint64_t i = 1 ; i < num_of_records && sig ; i++){
+        const FlightRecorder::CycleRecord * previous = replay_file_.GetRecord(i - 1);
+        const FlightRecorder::CycleRecord * record   = replay_file_.GetRecord(i);
+        // State is carried from previous record, cycles dropped by recorder can't be replayed.
+        if(record->cycle != previous->cycle + 1){
+            skipped++;
+            continue;
+        }
+        clock_gettime(CLOCK_TO_USE, &start_time);
+        memcpy(replay_domain_.data(), replay_file_.GetInputImage(i), domain_size);
+        sent_data_ = previous->sent_data;
+        estimator_.SetState(previous->estimator);
+        // Gain changes were acquired by recorded cycle, AcquireGains() doesn't find anything new in replay.
+        joint_controller_.SetState(record->joint_controller);
+        joint_controller_.SetActiveGains(record->joint_gains);
+        // Status check runs before feedback is read in control loop, com_status is decoded from its result.
+        al_state_ = record->al_state;
+        ReadFromSlaves();
+        controller_        = record->controller;
+        haptic_inputs_     = record->haptic_inputs;
+        command_           = record->command;
+        gui_node_data_     = record->gui_node_data;
+        emergency_status_  = record->emergency_status;
+        memcpy(motor_state_, record->motor_state, sizeof(motor_state_));
+        std::copy(record->homing, record->homing + g_kNumberOfServoDrivers, homing_);
+        StepControl(record->homing_start);
+        clock_gettime(CLOCK_TO_USE, &end_time);
+
+        exec_ns = DIFF_NS(start_time, end_time);
+        exec_total_ns += exec_ns;
+        if(exec_ns > exec_max_ns) exec_max_ns = exec_ns;
+        compared++;
+
+        const uint8_t * recorded_output = replay_file_.GetOutputImage(i);
+        if(memcmp(replay_domain_.data(), recorded_output, domain_size)){
+            mismatches++;
+            if(mismatches <= 10){
+                uint32_t offset = 0;
+                while(replay_domain_[offset] == recorded_output[offset]) offset++;
+                RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Cycle %llu : output image differs at byte %u, replayed 0x%02x recorded 0x%02x",
+                             (unsigned long long)record->cycle, offset, replay_domain_[offset], recorded_output[offset]);
+            }
+        }
+    }
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Replay finished. Compared : %llu | mismatches : %llu | skipped : %llu",
+                (unsigned long long)compared, (unsigned long long)mismatches, (unsigned long long)skipped);
+    if(compared){
+        RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Control path exec mean : %lld ns | max : %lld ns | %.0f cycles/s",
+                    (long long)(exec_total_ns / compared), (long long)exec_max_ns, compared * 1e9 / exec_total_ns);
+    }
+    replay_failed_ = !compared || mismatches;
+    // Replay is a batch run, stops executor in main so process exits with result.
+    rclcpp::shutdown();
+}
+
+void EthercatLifeCycle::ReadFromSlaves()
+{
+    // Without a custom slave there is no emergency switch, keep it released.
     received_data_.emergency_switch_val = 1 ;
-    #endif  
+    ecat_node_->drivers_.ForEach([this](auto & driver, int i){
+        driver.Decode(received_data_, i);
+    });
+    received_data_.com_status = al_state_ ; 
+    emergency_status_  = received_data_.emergency_switch_val;
+    estimator_.Update(received_data_.actual_pos.data(), received_data_.filtered_vel.data(), received_data_.filtered_acc.data());
 }// ReadFromSlaves end
 
 void EthercatLifeCycle::WriteToSlavesVelocityMode()
 {
   //  RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Writing to slaves....\n");
   if(!emergency_status_ || !gui_node_data_){
-    for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
-        EC_WRITE_U16(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.control_word,sent_data_.control_word[i]);
-        EC_WRITE_S32(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.target_vel,0);
-    }
+    ecat_node_->drivers_.ForEachDrive([this](auto & drive, int i){
+        drive.EncodeVelocity(sent_data_.control_word[i], 0);
+    });
   }else{
-    for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
-        EC_WRITE_U16(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.control_word,sent_data_.control_word[i]);
-        EC_WRITE_S32(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.target_vel,sent_data_.target_vel[i]);
-    }
+    ecat_node_->drivers_.ForEachDrive([this](auto & drive, int i){
+        drive.EncodeVelocity(sent_data_.control_word[i], sent_data_.target_vel[i]);
+    });
   }
 }
 
 int EthercatLifeCycle::PublishAllData()
 {   
    // RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Publishing all data....\n");
-    received_data_.header.stamp = this->now();
-    received_data_publisher_->publish(received_data_);
-    sent_data_.header.stamp  = this->now();
-    sent_data_publisher_->publish(sent_data_);
+    const builtin_interfaces::msg::Time stamp = this->now();
+    received_data_.stamp = stamp;
+    sent_data_.stamp     = stamp;
+    // Feedback sample of this cycle goes into the batch, batch is published when it's full.
+    feedback_batch_.samples[feedback_batch_.num_of_samples++] = received_data_;
+    const bool publish_batch = feedback_batch_.num_of_samples >= feedback_batch_size_;
+    if(loan_messages_){
+        // Messages are fixed-size, assignment is a plain copy into middleware owned memory.
+        if(per_cycle_feedback_){
+            auto received_loan = received_data_publisher_->borrow_loaned_message();
+            received_loan.get() = received_data_;
+            received_data_publisher_->publish(std::move(received_loan));
+        }
+        auto sent_loan = sent_data_publisher_->borrow_loaned_message();
+        sent_loan.get() = sent_data_;
+        sent_data_publisher_->publish(std::move(sent_loan));
+
+        if(publish_batch){
+            // Only valid samples are copied, the rest of the loan is never read by subscribers.
+            auto batch_loan = feedback_batch_publisher_->borrow_loaned_message();
+            ecat_msgs::msg::DataReceivedBatch & batch = batch_loan.get();
+            batch.num_of_samples = feedback_batch_.num_of_samples;
+            std::copy_n(feedback_batch_.samples.begin(), feedback_batch_.num_of_samples, batch.samples.begin());
+            feedback_batch_publisher_->publish(std::move(batch_loan));
+        }
+    }else{
+        // Without intra-process communication, member messages are published in place.
+        if(per_cycle_feedback_){
+            received_data_publisher_->publish(received_data_);
+        }
+        sent_data_publisher_->publish(sent_data_);
+        if(publish_batch){
+            feedback_batch_publisher_->publish(feedback_batch_);
+        }
+    }
+    if(publish_batch){
+        feedback_batch_.num_of_samples = 0;
+    }
+    return 0;
+}
+
+void EthercatLifeCycle::PublishInputLatency()
+{
+    PhaseTrace::Scope trace(PhaseTrace::kLatencyTimer);
+    if(!input_latency_publisher_->is_activated()){
+        return;
+    }
+    // Executor thread uses TLSF allocator, preallocated fixed-size message keeps it off the heap.
+    input_latency_.stamp = this->now();
+
+    input_latency_.input_path = ecat_msgs::msg::InputLatency::JOYSTICK;
+    joystick_latency_.Fill(input_latency_);
+    input_latency_publisher_->publish(input_latency_);
+
+    input_latency_.input_path = ecat_msgs::msg::InputLatency::HAPTIC;
+    haptic_latency_.Fill(input_latency_);
+    input_latency_publisher_->publish(input_latency_);
+}
+
+void EthercatLifeCycle::HandleDumpPhaseTrace(const std::shared_ptr<std_srvs::srv::Trigger::Request>,
+                                             std::shared_ptr<std_srvs::srv::Trigger::Response> response)
+{
+    PhaseTrace::Scope trace(PhaseTrace::kTraceDump);
+    const std::string path = this->get_parameter("phase_trace_file").as_string();
+    if(PhaseTrace::DumpChromeTrace(path, this->get_parameter("phase_trace_seconds").as_double())){
+        response->success = false;
+        response->message = "Couldn't write " + path;
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "%s", response->message.c_str());
+        return;
+    }
+    response->success = true;
+    response->message = path;
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Phase trace written to %s", path.c_str());
+}
+
+int EthercatLifeCycle::InitControllers()
+{
+    EstimatorParameters<g_kNumberOfServoDrivers> estimator;
+    if(replay_mode_){
+        // Replay runs with the configuration of the recording, current parameters may differ.
+        estimator = replay_file_.GetHeader().estimator;
+    }else{
+        estimator.increments_per_rev = this->get_parameter("increments_per_rev").as_double();
+        if(CopyDriveValues(this->get_parameter("velocity_filter_theta"), estimator.theta)){
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "velocity_filter_theta needs one value or one per drive");
+            return -1;
+        }
+    }
+    if(estimator.increments_per_rev <= 0){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "increments_per_rev has to be positive");
+        return -1;
+    }
+    for(uint32_t i = 0 ; i < g_kNumberOfServoDrivers ; i++){
+        if(estimator.theta[i] < 0 || estimator.theta[i] >= 1){
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "velocity_filter_theta has to be in [0, 1)");
+            return -1;
+        }
+    }
+    estimator_.Configure(estimator, FREQUENCY);
+    joint_controller_.Configure(estimator.increments_per_rev, FREQUENCY);
+    return InitFeedforward();
+}
+
+int EthercatLifeCycle::InitFeedforward()
+{
+    feedforward_.reset();
+    if(replay_mode_){
+        // Replay uses the model of the recording, current parameters may differ.
+        const FlightRecorder::FileHeader & header = replay_file_.GetHeader();
+        if(header.feedforward_enabled){
+            feedforward_ = std::make_unique<TorqueFeedforward<g_kNumberOfServoDrivers>>(header.feedforward);
+        }
+        return 0;
+    }
+    if(!this->get_parameter("feedforward.enable").as_bool()){
+        return 0;
+    }
+    const uint32_t n = g_kNumberOfServoDrivers;
+    FeedforwardModel<g_kNumberOfServoDrivers> model;
+    double a[n], alpha[n], d[n], theta[n], mass[n], com_x[n], com_y[n], com_z[n], joint_min[n], joint_max[n];
+    bool prismatic[n];
+    auto copy = [this](const char * name, auto * values){
+        if(CopyDriveValues(this->get_parameter(name), values)){
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "%s needs one value or one per drive", name);
+            return -1;
+        }
+        return 0;
+    };
+    if(copy("feedforward.dh_a", a) || copy("feedforward.dh_alpha", alpha) || copy("feedforward.dh_d", d) ||
+       copy("feedforward.dh_theta", theta) || copy("feedforward.link_mass", mass) ||
+       copy("feedforward.link_com_x", com_x) || copy("feedforward.link_com_y", com_y) ||
+       copy("feedforward.link_com_z", com_z) || copy("feedforward.joint_per_increment", model.joint_per_increment) ||
+       copy("feedforward.joint_offset", model.joint_offset) || copy("feedforward.rated_torque", model.rated_torque) ||
+       copy("feedforward.coulomb", model.coulomb) || copy("feedforward.viscous", model.viscous) ||
+       copy("feedforward.friction_band", model.friction_band) ||
+       copy("feedforward.joint_min", joint_min) || copy("feedforward.joint_max", joint_max)){
+        return -1;
+    }
+    if(CopyDriveFlags(this->get_parameter("feedforward.prismatic"), prismatic)){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "feedforward.prismatic needs one value or one per drive");
+        return -1;
+    }
+    const std::vector<double> gravity = this->get_parameter("feedforward.gravity").as_double_array();
+    if(gravity.size() != 3){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "feedforward.gravity needs x, y and z");
+        return -1;
+    }
+    std::copy(gravity.begin(), gravity.end(), model.gravity);
+    for(uint32_t i = 0 ; i < n ; i++){
+        if(model.rated_torque[i] <= 0 || model.friction_band[i] <= 0){
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "feedforward.rated_torque and feedforward.friction_band have to be positive");
+            return -1;
+        }
+        if(joint_min[i] >= joint_max[i]){
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "feedforward.joint_min has to be less than feedforward.joint_max");
+            return -1;
+        }
+        model.links[i] = {a[i], alpha[i], d[i], theta[i], prismatic[i], joint_min[i], joint_max[i]};
+        model.masses[i] = {mass[i], {com_x[i], com_y[i], com_z[i]}};
+    }
+    model.max_offset = std::min(std::max(this->get_parameter("feedforward.max_offset").as_double(), 0.0), double(INT16_MAX));
+    feedforward_ = std::make_unique<TorqueFeedforward<g_kNumberOfServoDrivers>>(model);
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Gravity and friction feedforward enabled, limited to %.0f per thousand.\n", model.max_offset);
+    return 0;
+}
+
+rcl_interfaces::msg::SetParametersResult EthercatLifeCycle::HandleParameterChange(const std::vector<rclcpp::Parameter> & parameters)
+{
+    rcl_interfaces::msg::SetParametersResult result;
+    result.successful = true;
+    JointGains<g_kNumberOfServoDrivers> gains = joint_controller_.GetGains();
+    bool changed = false;
+    for(const auto & parameter : parameters){
+        float * gain = JointGainOf(gains, parameter.get_name());
+        if(!gain){
+            continue;
+        }
+        if(CopyDriveValues(parameter, gain)){
+            result.successful = false;
+            result.reason = parameter.get_name() + " needs one value or one per drive";
+            return result;
+        }
+        changed = true;
+    }
+    for(uint32_t i = 0 ; i < g_kNumberOfServoDrivers ; i++){
+        if(gains.max_torque[i] < 0 || gains.max_torque[i] > INT16_MAX){
+            result.successful = false;
+            result.reason = "cst_max_torque has to be between 0 and 32767";
+            return result;
+        }
+    }
+    if(changed){
+        joint_controller_.SetGains(gains);
+    }
+    return result;
+}
+
+void EthercatLifeCycle::HandleHomeDrives(const std::shared_ptr<std_srvs::srv::Trigger::Request>,
+                                         std::shared_ptr<std_srvs::srv::Trigger::Response> response)
+{
+    if(!control_active_){
+        response->success = false;
+        response->message = "Node isn't active, drives can't be homed.";
+        return;
+    }
+    homing_requested_ = true;
+    response->success = true;
+    response->message = "Homing started, result of each drive is logged.";
+}
+
+void EthercatLifeCycle::StepControl(bool homing_start)
+{
+    UpdateControlLogic();
+    UpdateHoming(homing_start);
+}
+
+void EthercatLifeCycle::UpdateHoming(bool start)
+{
+    const bool halt  = !emergency_status_ || !gui_node_data_;
+    ecat_node_->drivers_.ForEachDrive([this, start, halt](auto & drive, int i){
+        HomingSequence & homing = homing_[i];
+        if(start && std::decay<decltype(drive)>::type::kCanHome && !halt){
+            homing.Start();
+        }
+        if(!homing.IsActive()){
+            return;
+        }
+        if(halt){
+            homing.Abort();
+        }
+        homing.Update(received_data_.status_word[i], int8_t(received_data_.op_mode_display[i]));
+        if(!homing.IsActive()){
+            // Motor state machine keeps control word from now on.
+            drive.EncodeOperationMode(homing.GetOperationMode());
+            RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Homing of drive %d %s after %u cycles.", i,
+                        HomingSequence::ResultName(homing.GetResult()), homing.GetCycles());
+            return;
+        }
+        sent_data_.control_word[i] = homing.GetControlWord();
+        sent_data_.target_pos[i]   = received_data_.actual_pos[i];
+        sent_data_.target_vel[i]   = 0;
+        drive.EncodeHoming(homing.GetControlWord(), homing.GetOperationMode(), received_data_.actual_pos[i]);
+    });
+}
+
+void EthercatLifeCycle::ResetHoming()
+{
+    ecat_node_->drivers_.ForEachDrive([this](auto & drive, int i){
+        homing_[i].Reset();
+        drive.EncodeOperationMode(homing_[i].GetOperationMode());
+    });
 }
 
 int EthercatLifeCycle::GetComState()
@@ -922,25 +1839,22 @@ int EthercatLifeCycle::EnableDrivers()
 void EthercatLifeCycle::WriteToSlavesInPositionMode()
 {
     if(!received_data_.left_limit_switch_val || !received_data_.right_limit_switch_val){
-        for(int i = 0 ; i < g_kNumberOfServoDrivers; i++){
+        ecat_node_->drivers_.ForEachDrive([this](auto & drive, int i){
             if(sent_data_.target_pos[i] > 0){
-                EC_WRITE_U16(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.control_word,sent_data_.control_word[i]);
-                EC_WRITE_S32(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.target_pos,sent_data_.target_pos[i]);
+                drive.EncodePosition(sent_data_.control_word[i], sent_data_.target_pos[i]);
             }else{
-                EC_WRITE_U16(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.control_word,SM_QUICKSTOP);
+                drive.EncodeControlWord(SM_QUICKSTOP);
             }
-        }
+        });
     }else {
         if(!emergency_status_ || !gui_node_data_){
-            for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
-                EC_WRITE_U16(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.control_word,SM_QUICKSTOP);
-        //      EC_WRITE_S32(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.target_pos,0);
-            }
+            ecat_node_->drivers_.ForEachDrive([](auto & drive, int){
+                drive.EncodeControlWord(SM_QUICKSTOP);
+            });
         }else{
-            for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
-                EC_WRITE_U16(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.control_word,sent_data_.control_word[i]);
-                EC_WRITE_S32(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.target_pos,sent_data_.target_pos[i]);
-            }
+            ecat_node_->drivers_.ForEachDrive([this](auto & drive, int i){
+                drive.EncodePosition(sent_data_.control_word[i], sent_data_.target_pos[i]);
+            });
         }
     }
 }
@@ -1266,46 +2180,50 @@ void EthercatLifeCycle::WriteToSlavesInCyclicTorqueMode()
 {
   if(!emergency_status_ || !gui_node_data_)
   {
-    for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
-        EC_WRITE_U16(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.control_word,sent_data_.control_word[i]);
-        EC_WRITE_S16(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.target_tor,0);
-        EC_WRITE_S16(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.torque_offset,0);
-        
-    }
+    ecat_node_->drivers_.ForEachDrive([this](auto & drive, int i){
+        drive.EncodeTorque(sent_data_.control_word[i], 0, 0);
+    });
   }
   else
   {
-    for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
-        EC_WRITE_U16(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.control_word,sent_data_.control_word[i]);
-        EC_WRITE_S16(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.target_tor,sent_data_.target_tor[i]);
-        EC_WRITE_S16(ecat_node_->slaves_[i].slave_pdo_domain_ + ecat_node_->slaves_[i].offset_.torque_offset,0);
-    }
+    ecat_node_->drivers_.ForEachDrive([this](auto & drive, int i){
+        drive.EncodeTorque(sent_data_.control_word[i], sent_data_.target_tor[i], torque_offset_[i]);
+    });
   }
 }
 
 void EthercatLifeCycle::UpdateCyclicTorqueModeParameters()
 {
-    // Torque mode: sending target_torque value in per thousand of Motor Rated Torque value.
+    // Joystick axes jog position reference of first three drives, joint controller tracks it.
+    const float deadzone = 0.1;
+    const float max_speed = 250.0;    // rpm
+    const float axes[3] = {controller_.right_x_axis_, controller_.left_x_axis_, controller_.left_y_axis_};
+    bool enabled[g_kNumberOfServoDrivers];
+    joint_controller_.AcquireGains();
     for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
         sent_data_.control_word[i] = SM_GO_ENABLE;
-        if(motor_state_[i]==kOperationEnabled || motor_state_[i]==kTargetReached || motor_state_[i]==kSwitchedOn){
-            if(controller_.right_x_axis_ < -0.1 || controller_.right_x_axis_ > 0.1 ){
-                sent_data_.target_tor[0] = controller_.right_x_axis_ * 300 ;
-            }else{
-                sent_data_.target_tor[0] = 0;
-            }
-            if(controller_.left_x_axis_ < -0.1 || controller_.left_x_axis_ > 0.1){
-                sent_data_.target_tor[1] = controller_.left_x_axis_ * 300;
-            }else{
-                sent_data_.target_tor[1] = 0 ;
-            }
-            if(controller_.left_y_axis_ < -0.1 || controller_.left_y_axis_ > 0.1){
-                sent_data_.target_tor[2] = controller_.left_y_axis_ * 300 ;
-            }else{
-                sent_data_.target_tor[2] = 0 ;
+        enabled[i] = (motor_state_[i]==kOperationEnabled || motor_state_[i]==kTargetReached) && !homing_[i].IsActive();
+        if(enabled[i]){
+            // Axis that was just enabled starts from where it stands, it's only jogged from a held position.
+            if(!joint_controller_.IsHeld(i)){
+                joint_controller_.Hold(i, received_data_.actual_pos[i]);
             }
+            const float val = i < 3 ? axes[i] : 0;
+            joint_controller_.Jog(i, (val < -deadzone || val > deadzone) ? int32_t(val * max_speed) : 0);
         }else{
-            sent_data_.target_tor[i]=0;
+            joint_controller_.Release(i);
+        }
+    }
+    // Torque mode: sending target_torque value in per thousand of Motor Rated Torque value.
+    joint_controller_.Compute(received_data_.actual_pos.data(), received_data_.filtered_vel.data(),
+                              sent_data_.target_tor.data());
+    if(feedforward_){
+        feedforward_->Compute(received_data_.actual_pos.data(), received_data_.filtered_vel.data(), torque_offset_);
+    }
+    for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
+        if(!enabled[i]){
+            sent_data_.target_tor[i] = 0;
+            torque_offset_[i] = 0;
         }
     }
 }
\ No newline at end of file
@@ -2,17 +2,8 @@
 
 using namespace EthercatCommunication ; 
 
-/*****************************************************************************************/
-/// Extern global variable declaration.
-ec_master_t        * g_master = NULL ;           // EtherCAT master instance
-ec_master_state_t    g_master_state = {};        // EtherCAT master state
-ec_domain_t        * g_master_domain = NULL;     // Ethercat data passing master domain
-ec_domain_state_t    g_master_domain_state = {}; // EtherCAT master domain state
-struct timespec      g_sync_timer ;
-uint32_t             g_sync_ref_counter = 0;
-/*****************************************************************************************/
-
-EthercatNode::EthercatNode()
+EthercatNode::EthercatNode(uint32_t master_index, int first_slave, int num_of_slaves)
+    : master_index_(master_index), first_slave_(first_slave), end_slave_(first_slave + num_of_slaves)
 {
 
 }
@@ -24,15 +15,15 @@ EthercatNode::~EthercatNode()
 
 int  EthercatNode::ConfigureMaster()
 {
-    g_master = ecrt_request_master(0);    
-    if (!g_master) {
+    master_ = ecrt_request_master(master_index_);    
+    if (!master_) {
         
         RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Requesting master instance failed ! ");
         return -1 ;
     }
 
-    g_master_domain = ecrt_master_create_domain(g_master);
-    if(!g_master_domain) {
+    master_domain_ = ecrt_master_create_domain(master_);
+    if(!master_domain_) {
         RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Failed to create master domain ! ");
         return -1 ;
     }
@@ -41,15 +32,15 @@ int  EthercatNode::ConfigureMaster()
 
 void EthercatNode::GetAllSlaveInformation()
 {
-    for(int i=0;i < NUM_OF_SLAVES ; i++){
-        ecrt_master_get_slave(g_master, i , &slaves_[i].slave_info_);
+    for(int i = first_slave_ ; i < end_slave_ ; i++){
+        ecrt_master_get_slave(master_, i - first_slave_ , &slaves_[i].slave_info_);
     }
 }
 
 int  EthercatNode::ConfigureSlaves()
 {
-    for(int i = 0 ; i < NUM_OF_SLAVES ; i++ ){
-        slaves_[i].slave_config_ = ecrt_master_slave_config(g_master,slaves_[i].slave_info_.alias,
+    for(int i = first_slave_ ; i < end_slave_ ; i++ ){
+        slaves_[i].slave_config_ = ecrt_master_slave_config(master_,slaves_[i].slave_info_.alias,
                                                                      slaves_[i].slave_info_.position,
                                                                      slaves_[i].slave_info_.vendor_id,
                                                                      slaves_[i].slave_info_.product_code); 
@@ -65,187 +56,46 @@ int  EthercatNode::ConfigureSlaves()
 int EthercatNode::MapDefaultPdos()
 {
    /**
-    *  This part is specific for our Custom EASYCAT slave configuration
-    *  To create your custom slave and variables you can add variables to \see OffsetPDO struct.
+    *  PDO tables and entry offsets of each slave type are generated from its layout in \see pdo_layout.hpp
+    *  and slave types are assigned to positions by SlaveDriver::Drivers in \see slave_driver.hpp
+    *  To create your custom slave and variables add them to PdoLayout::EasyCat or define a new layout and driver,
+    *  and add variables you want to record to \see OffsetPDO struct.
     *  Also you have add your variables to received data structure, you may have to create your custom msg files as well.
     **/
-    ec_pdo_entry_info_t elmo_pdo_entries[8] = {
-        {OD_TARGET_POSITION, 32},
-        {OD_DIGITAL_OUTPUTS, 32},
-        {OD_CONTROL_WORD, 16},
-        {OD_TARGET_VELOCITY,32},
-        {OD_POSITION_ACTUAL_VAL, 32},
-        {OD_DIGITAL_INPUTS, 32},
-        {OD_STATUS_WORD, 16},
-        {OD_VELOCITY_ACTUAL_VALUE,32}
-
-    };
-
-    ec_pdo_info_t elmo_pdos[4] = {
-        {0x1600, 3, elmo_pdo_entries + 0},
-        {0x1607, 1, elmo_pdo_entries + 3},
-        
-        {0x1a00, 3, elmo_pdo_entries + 4},
-        {0x1a07, 1, elmo_pdo_entries + 7}
-    };
-
-    ec_sync_info_t elmo_syncs[5] = {
-        {0, EC_DIR_OUTPUT, 0, NULL, EC_WD_DISABLE},
-        {1, EC_DIR_INPUT, 0, NULL, EC_WD_DISABLE},
-        {2, EC_DIR_OUTPUT, 2, elmo_pdos + 0, EC_WD_ENABLE},
-        {3, EC_DIR_INPUT, 2, elmo_pdos + 2, EC_WD_DISABLE},
-        {0xff}
-    };
-
-    /* Master 0, Slave 0, "EPOS4"
-     * Vendor ID:       0x000000fb
-     * Product code:    0x61500000
-     * Revision number: 0x01600000
-     */
-
-    ec_pdo_entry_info_t maxon_epos_pdo_entries[9] = {
-        {OD_CONTROL_WORD, 16},      // CKim - First three entries will be read by slave (master sends command). RxPDO
-        {OD_TARGET_VELOCITY,32},
-        {OD_TARGET_POSITION, 32},
-        {OD_TARGET_TORQUE,16},
-        {OD_TORQUE_OFFSET,16},
-
-        {OD_STATUS_WORD, 16},       // CKim - Last three entries will be transmitted by slave (master receives the data). TxPDO
-        {OD_POSITION_ACTUAL_VAL, 32},
-        {OD_VELOCITY_ACTUAL_VALUE,32},
-        {OD_TORQUE_ACTUAL_VALUE,16}
-    };
-
-    ec_pdo_info_t maxon_pdos[2] = {
-        {0x1600, 5, maxon_epos_pdo_entries + 0},    // CKim - RxPDO index of the EPOS4
-        {0x1a00, 4, maxon_epos_pdo_entries + 5}     // CKim - TxPDO index of the EPOS4
-    };
-
-    // CKim - Sync manager configuration of the EPOS4. 0,1 is reserved for SDO communications
-    // EC_WD_ENABLE means that the sync manager of the slave will throw error 
-    // if it does not synchronize within certain interval
-    ec_sync_info_t maxon_syncs[5] = {
-        {0, EC_DIR_OUTPUT, 0, NULL, EC_WD_DISABLE},
-        {1, EC_DIR_INPUT, 0, NULL, EC_WD_DISABLE},
-        {2, EC_DIR_OUTPUT, 1, maxon_pdos + 0, EC_WD_ENABLE},
-        {3, EC_DIR_INPUT, 1, maxon_pdos + 1, EC_WD_DISABLE},
-        {0xff}
-    };
-
-    /*********************************************************/
-    ec_pdo_entry_info_t easycat_pdo_entries[16] = {
-        {0x0005, 0x01, 16}, /* output_analog_01 */
-        {0x0005, 0x02, 16}, /* output_analog_02 */
-        {0x0005, 0x03, 16}, /* output_analog_03 */
-        {0x0005, 0x04, 8}, /* output_digital_04 */
-        {0x0005, 0x05, 8}, /* output_digital_05 */
-        {0x0005, 0x06, 8}, /* output_digital_01 */
-        {0x0005, 0x07, 8}, /* output_digital_02 */
-        {0x0005, 0x08, 8}, /* output_digital_03 */
-        {0x0006, 0x01, 16}, /* input_analog_01 */
-        {0x0006, 0x02, 16}, /* input_analog_02 */
-        {0x0006, 0x03, 16}, /* input_analog_03 */
-        {0x0006, 0x04, 8}, /* input_digital_04 */
-        {0x0006, 0x05, 8}, /* input_digital_05 */
-        {0x0006, 0x06, 8}, /* left_limit_switch */
-        {0x0006, 0x07, 8}, /* right_limit_switch */
-        {0x0006, 0x08, 8}, /* input_digital_03 */
-    };
-
-    ec_pdo_info_t easycat_pdos[2] = {
-        {0x1600, 8, easycat_pdo_entries + 0}, /* Outputs */
-        {0x1a00, 8, easycat_pdo_entries + 8}, /* Inputs */
-    };
-
-    ec_sync_info_t easycat_syncs[3] = {
-        {0, EC_DIR_OUTPUT, 1, easycat_pdos + 0, EC_WD_ENABLE},
-        {1, EC_DIR_INPUT, 1, easycat_pdos + 1, EC_WD_DISABLE},
-        {0xff}
-    };
-
-
-    // CKim - Connect sync_manager to corresponding slaves.
-    for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
-        if(ecrt_slave_config_pdos(slaves_[i].slave_config_,EC_END,maxon_syncs)){
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Slave PDO configuration failed... ");
-            return -1;
-        }
-    }
-    #if CUSTOM_SLAVE    
-        if(ecrt_slave_config_pdos(slaves_[FINAL_SLAVE].slave_config_,EC_END,easycat_syncs)){
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "EasyCAT slave PDO configuration failed... ");
-            return -1;
-        }
-    #endif
-    // CKim - Registers a PDO entry for process data exchange in a domain. Obtain offsets
-    for(int i = 0; i < g_kNumberOfServoDrivers ; i++){
-        this->slaves_[i].offset_.actual_pos        = ecrt_slave_config_reg_pdo_entry(this->slaves_[i].slave_config_,
-                                                                                  OD_POSITION_ACTUAL_VAL,g_master_domain,NULL);
-        this->slaves_[i].offset_.status_word       = ecrt_slave_config_reg_pdo_entry(this->slaves_[i].slave_config_,
-                                                                                  OD_STATUS_WORD,g_master_domain,NULL);
-        this->slaves_[i].offset_.actual_vel        = ecrt_slave_config_reg_pdo_entry(this->slaves_[i].slave_config_,
-                                                                                  OD_VELOCITY_ACTUAL_VALUE,g_master_domain,NULL);
-        this->slaves_[i].offset_.actual_tor        = ecrt_slave_config_reg_pdo_entry(this->slaves_[i].slave_config_,
-                                                                                  OD_TORQUE_ACTUAL_VALUE,g_master_domain,NULL);
-
-        this->slaves_[i].offset_.torque_offset     = ecrt_slave_config_reg_pdo_entry(this->slaves_[i].slave_config_,
-                                                                                  OD_TORQUE_OFFSET,g_master_domain,NULL);
-
-        this->slaves_[i].offset_.target_pos       = ecrt_slave_config_reg_pdo_entry(this->slaves_[i].slave_config_,
-                                                                                  OD_TARGET_POSITION,g_master_domain,NULL);                                                                                                                                                                  
-        this->slaves_[i].offset_.target_vel       = ecrt_slave_config_reg_pdo_entry(this->slaves_[i].slave_config_,
-                                                                                  OD_TARGET_VELOCITY,g_master_domain,NULL);
-        this->slaves_[i].offset_.target_tor       = ecrt_slave_config_reg_pdo_entry(this->slaves_[i].slave_config_,
-                                                                                  OD_TARGET_TORQUE,g_master_domain,NULL);                                                                                  
-        this->slaves_[i].offset_.control_word     = ecrt_slave_config_reg_pdo_entry(this->slaves_[i].slave_config_,
-                                                                                  OD_CONTROL_WORD,g_master_domain,NULL);
-                                                                                  
-        if(
-            (slaves_[i].offset_.actual_pos < 0) || (slaves_[i].offset_.status_word < 0) || (slaves_[i].offset_.actual_vel    < 0)
-        ||  (slaves_[i].offset_.target_vel < 0) || (slaves_[i].offset_.target_pos  < 0) || (slaves_[i].offset_.control_word  < 0) 
-        ||  (slaves_[i].offset_.target_tor < 0) || (slaves_[i].offset_.actual_tor  < 0) || (slaves_[i].offset_.torque_offset < 0)
-        )
-        {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Failed to configure  PDOs for motors.!");
-            return -1;
-        }
-    }
-    #if CUSTOM_SLAVE
-        slaves_[FINAL_SLAVE].offset_.r_limit_switch = ecrt_slave_config_reg_pdo_entry(slaves_[FINAL_SLAVE].slave_config_,
-                                                                                    0x006,0x006,g_master_domain,NULL);
-        if (slaves_[FINAL_SLAVE].offset_.r_limit_switch < 0){
-            RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"EasyCAT right limit switch PDO configuration failed...\n");
-            return -1;
-        }
-        slaves_[FINAL_SLAVE].offset_.l_limit_switch = ecrt_slave_config_reg_pdo_entry(slaves_[FINAL_SLAVE].slave_config_,
-                                                                                    0x006, 0x07, g_master_domain, NULL);
-        if (slaves_[FINAL_SLAVE].offset_.l_limit_switch < 0){
-            RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"EasyCAT left limit switch PDO configuration failed...\n");
-            return -1;
-        }
-        slaves_[FINAL_SLAVE].offset_.emergency_switch = ecrt_slave_config_reg_pdo_entry(slaves_[FINAL_SLAVE].slave_config_,
-                                                                                    0x006, 0x05, g_master_domain, NULL);
-        if (slaves_[FINAL_SLAVE].offset_.emergency_switch < 0){
-            RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"EasyCAT left limit switch PDO configuration failed...\n");
-            return -1;
+    int err = 0;
+    drivers_.ForEach([this, &err](auto & driver, int i){
+        if(!err && HasSlave(i)){
+            err = driver.MapPdos(slaves_[i], master_domain_);
         }
-    #endif    
-    return 0;
+    });
+    return err;
 }
 
 void EthercatNode::ConfigDcSyncDefault()
 {
-    for(int i=0; i < g_kNumberOfServoDrivers ; i++){
-        ecrt_slave_config_dc(slaves_[i].slave_config_, 0X0300, PERIOD_NS, slaves_[i].kSync0_shift_, 0, 0);
+    drivers_.ForEach([this](auto & driver, int i){
+        if(HasSlave(i)){
+            driver.ConfigDc(slaves_[i]);
+        }
+    });
+}
+
+int EthercatNode::OpenSdoCache(const std::string & file)
+{
+    return sdo_cache_.Open(file);
+}
+
+int EthercatNode::QueueSdos(int position, const SdoParameterSet & sdos, bool cacheable)
+{
+    if(cacheable && sdo_cache_.IsOpen()){
+        return sdo_cache_.Queue(master_, slaves_[position], sdos);
     }
-    #if CUSTOM_SLAVE
-        ecrt_slave_config_dc(slaves_[FINAL_SLAVE].slave_config_, 0X0300, PERIOD_NS, 2000200000, 0, 0);
-    #endif
+    return SdoParameterSet::QueueAll(slaves_[position].slave_config_, sdos.GetWrites());
 }
 
 int EthercatNode::ActivateMaster()
 {   
-    if ( ecrt_master_activate(g_master) ) {
+    if ( ecrt_master_activate(master_) ) {
         RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Master activation error ! ");
         return -1 ;
     }
@@ -254,8 +104,8 @@ int EthercatNode::ActivateMaster()
 
 int EthercatNode::RegisterDomain()
 {
-    for(int i = 0 ; i < NUM_OF_SLAVES ; i++){
-        slaves_[i].slave_pdo_domain_ = ecrt_domain_data(g_master_domain);
+    for(int i = first_slave_ ; i < end_slave_ ; i++){
+        slaves_[i].slave_pdo_domain_ = ecrt_domain_data(master_domain_);
         if(!(slaves_[i].slave_pdo_domain_) )
         {
             RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Domain PDO registration error");
@@ -309,44 +159,7 @@ int EthercatNode::SetProfilePositionParameters(ProfilePosParam& P, int position)
 
 int EthercatNode::SetProfilePositionParametersAll(ProfilePosParam& P)
 {
-    for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++)
-    {
-        // Set operation mode to ProfilePositionMode for all motors.
-        if( ecrt_slave_config_sdo8(slaves_[i].slave_config_,OD_OPERATION_MODE, kProfilePosition) ){
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set operation mode config error ! ");
-            return  -1 ;
-        }
-        //profile velocity
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_PROFILE_VELOCITY, P.profile_vel) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile velocity failed ! ");
-            return -1;
-        }
-        //max profile velocity
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_MAX_PROFILE_VELOCITY,P.max_profile_vel) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set max profile velocity failed ! ");
-            return -1;
-        }
-        //profile acceleration
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_PROFILE_ACCELERATION, P.profile_acc) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile acceleration failed ! ");
-            return -1;
-        }
-        //profile deceleration
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_PROFILE_DECELERATION,P.profile_dec) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile deceleration failed ! ");
-            return -1;
-        }
-        // quick stop deceleration 
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_QUICK_STOP_DECELERATION,P.quick_stop_dec) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
-            return -1;
-        }
-        if(ecrt_slave_config_sdo16(slaves_[i].slave_config_,OD_MOTION_PROFILE_TYPE,P.motion_profile_type) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
-            return -1;
-        }
-    }
-    return 0; 
+    return ConfigureDriveSdos(P);
 }
 
 int EthercatNode::SetProfileVelocityParameters(ProfileVelocityParam& P, int position)
@@ -386,39 +199,7 @@ int EthercatNode::SetProfileVelocityParameters(ProfileVelocityParam& P, int posi
 
 int EthercatNode::SetProfileVelocityParametersAll(ProfileVelocityParam& P)
 {
-    for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
-        // Set operation mode to ProfileVelocityMode for all motors.
-        if( ecrt_slave_config_sdo8(slaves_[i].slave_config_,OD_OPERATION_MODE, kProfileVelocity) ){
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set operation mode config error ! ");
-            return  -1 ;
-        }
-        // motionProfileType
-        if(ecrt_slave_config_sdo16(slaves_[i].slave_config_,OD_MOTION_PROFILE_TYPE, P.motion_profile_type) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile velocity config error ! ");
-            return -1;
-        }
-        //max profile velocity
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_MAX_PROFILE_VELOCITY,P.max_profile_vel) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set max profile  velocity config error ! ");
-            return -1;
-        }
-        //profile acceleration
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_PROFILE_DECELERATION, P.profile_dec) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile deceleration failed !");
-            return -1;
-        }
-        //profile deceleration
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_PROFILE_ACCELERATION,P.profile_acc) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile acceleration failed ! ");
-            return -1;
-        }
-        // quick stop deceleration 
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_QUICK_STOP_DECELERATION,P.quick_stop_dec) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed ! ");
-            return -1;
-        }        
-    }
-    return 0;
+    return ConfigureDriveSdos(P);
 }
 
 int EthercatNode::SetCyclicSyncPositionModeParameters(CSPositionModeParam &P, int position)
@@ -461,46 +242,9 @@ int EthercatNode::SetCyclicSyncPositionModeParameters(CSPositionModeParam &P, in
     return 0; 
 }
 
-int EthercatNode::SetCyclicSyncPositionModeParametersAll(CSPositionModeParam &P)
+int EthercatNode::SetCyclicSyncPositionModeParametersAll(CSPositionModeParam& P)
 {
-    for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
-        // Set operation mode to Cyclic Synchronous Position mode for all motors.
-        if( ecrt_slave_config_sdo8(slaves_[i].slave_config_,OD_OPERATION_MODE, kCSPosition) ){
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set operation mode config error ! ");
-            return  -1 ;
-        }
-        // //profile velocity
-        // if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_PROFILE_VELOCITY, P.profile_vel) < 0) {
-        //     RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile velocity failed ! ");
-        //     return -1;
-        // }
-        // //max profile velocity
-        // if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_MAX_PROFILE_VELOCITY,P.max_profile_vel) < 0) {
-        //     RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set max profile velocity failed ! ");
-        //     return -1;
-        // }
-        // //profile acceleration
-        // if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_PROFILE_ACCELERATION, P.profile_acc) < 0) {
-        //     RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile acceleration failed ! ");
-        //     return -1;
-        // }
-        // //profile deceleration
-        // if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_PROFILE_DECELERATION,P.profile_dec) < 0) {
-        //     RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile deceleration failed ! ");
-        //     return -1;
-        // }
-        // quick stop deceleration 
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_QUICK_STOP_DECELERATION,P.quick_stop_dec) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
-            return -1;
-        }
-        // Interpolation time period is 1ms by default.Default unit is milliseconds (ms)
-        if(ecrt_slave_config_sdo8(slaves_[i].slave_config_,OD_INTERPOLATION_TIME_PERIOD,P.interpolation_time_period) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
-            return -1;
-        }
-    }
-    return 0; 
+    return ConfigureDriveSdos(P);
 }
 
 int EthercatNode::SetCyclicSyncVelocityModeParameters(CSVelocityModeParam &P, int position)
@@ -559,97 +303,83 @@ int EthercatNode::SetCyclicSyncTorqueModeParameters(CSTorqueModeParam &P, int po
 }
 
 
-int EthercatNode::SetCyclicSyncVelocityModeParametersAll(CSVelocityModeParam &P)
+int EthercatNode::SetCyclicSyncVelocityModeParametersAll(CSVelocityModeParam& P)
 {
-    for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
-        // Set operation mode to Cyclic Synchronous Velocity mode for motor in specified physical position w.r.t master.
-        if( ecrt_slave_config_sdo8(slaves_[i].slave_config_,OD_OPERATION_MODE, kCSVelocity) ){
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set operation mode config error ! ");
-            return  -1 ;
-        }
-        // Velocity control parameter set, P, I gain only
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_VELOCITY_CONTROLLER_PGAIN,P.velocity_controller_gain.Pgain) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set velocity Pgain failed ! ");
-            return -1;
-        }
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_VELOCITY_CONTROLLER_IGAIN,P.velocity_controller_gain.Igain) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set velocity Igain failed ! ");
-            return -1;
-        }
-        //profile deceleration
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_PROFILE_DECELERATION,P.profile_dec) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile deceleration failed ! ");
-            return -1;
-        }
-        // quick stop deceleration 
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_QUICK_STOP_DECELERATION,P.quick_stop_dec) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
-            return -1;
-        }
-        // Interpolation time period is 1ms by default.Default unit is milliseconds (ms)
-        if(ecrt_slave_config_sdo8(slaves_[i].slave_config_,OD_INTERPOLATION_TIME_PERIOD,P.interpolation_time_period) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
-            return -1;
-        }
-    }
-    return 0; 
+    return ConfigureDriveSdos(P);
 }
 
-int EthercatNode::SetCyclicSyncTorqueModeParametersAll(CSTorqueModeParam &P)
+int EthercatNode::SetCyclicSyncTorqueModeParametersAll(CSTorqueModeParam& P)
 {
-    for(int i = 0 ; i < g_kNumberOfServoDrivers ; i++){
-        // Set operation mode to Cyclic Synchronous Velocity mode for motor in specified physical position w.r.t master.
-        if( ecrt_slave_config_sdo8(slaves_[i].slave_config_,OD_OPERATION_MODE, kCSTorque) ){
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set operation mode config error ! ");
-            return  -1 ;
-        }
-        //profile deceleration
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_PROFILE_DECELERATION,P.profile_dec) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile deceleration failed ! ");
-            return -1;
-        }
-        // quick stop deceleration 
-        if(ecrt_slave_config_sdo32(slaves_[i].slave_config_,OD_QUICK_STOP_DECELERATION,P.quick_stop_dec) < 0) {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
-            return -1;
+    return ConfigureDriveSdos(P);
+}
+
+void EthercatNode::SetHomingParametersAll(const HomingParam& P)
+{
+    drivers_.ForEachDrive([this, &P](auto &, int i){
+        if(HasSlave(i)){
+            slaves_[i].homing_param_ = P;
         }
-    }
-    return 0; 
+    });
+    homing_configured_ = true;
 }
 
 
 int EthercatNode::WaitForOperationalMode()
+{
+    return WaitForOperationalMode({this});
+}
+
+int EthercatNode::WaitForOperationalMode(const std::vector<EthercatNode*> & nodes)
 {
     int try_counter=0;
     int check_state_count=0;
     int time_out = 20e3;
-    while (g_master_state.al_states != EC_AL_STATE_OP ){
+    struct timespec sync_timer;
+    auto all_operational = [&nodes](){
+        for(const EthercatNode * node : nodes){
+            if(node->master_state_.al_states != EC_AL_STATE_OP) return false;
+        }
+        return true;
+    };
+    while (!all_operational()){
         if(try_counter < time_out){
-            clock_gettime(CLOCK_MONOTONIC, &g_sync_timer);
-            ecrt_master_application_time(g_master, TIMESPEC2NS(g_sync_timer));
-
-            ecrt_master_receive(g_master);
-            ecrt_domain_process(g_master_domain);
+            clock_gettime(CLOCK_MONOTONIC, &sync_timer);
+            for(EthercatNode * node : nodes){
+                ecrt_master_application_time(node->master_, TIMESPEC2NS(sync_timer));
+                ecrt_master_receive(node->master_);
+                ecrt_domain_process(node->master_domain_);
+            }
             usleep(PERIOD_US);
             if(!check_state_count){
-                CheckMasterState();
-                CheckMasterDomainState();
-                CheckSlaveConfigurationState();
+                for(EthercatNode * node : nodes){
+                    node->CheckMasterState();
+                    node->CheckMasterDomainState();
+                    node->CheckSlaveConfigurationState();
+                }
                 check_state_count = PERIOD_US ;
             }
 
-            ecrt_domain_queue(g_master_domain);                
-            ecrt_master_sync_slave_clocks(g_master);
-            ecrt_master_sync_reference_clock_to(g_master, TIMESPEC2NS(g_sync_timer));
-            ecrt_master_send(g_master);
+            for(EthercatNode * node : nodes){
+                ecrt_domain_queue(node->master_domain_);
+                ecrt_master_sync_slave_clocks(node->master_);
+                ecrt_master_sync_reference_clock_to(node->master_, TIMESPEC2NS(sync_timer));
+                ecrt_master_send(node->master_);
+            }
 
             try_counter++;
             check_state_count--;
         }else {
-            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Error : Time out occurred while waiting for OP mode.!  ");
-            //ecrt_master_deactivate_slaves(g_master);
-            ecrt_master_deactivate(g_master);
-            ecrt_release_master(g_master);
+            for(EthercatNode * node : nodes){
+                if(node->master_state_.al_states != EC_AL_STATE_OP){
+                    RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Error : Time out occurred while waiting for OP mode of master %u.!  ",
+                                 node->GetMasterIndex());
+                }
+            }
+            for(EthercatNode * node : nodes){
+                //ecrt_master_deactivate_slaves(master_);
+                ecrt_master_deactivate(node->master_);
+                ecrt_release_master(node->master_);
+            }
             return -1;
         }
     }
@@ -671,7 +401,7 @@ int EthercatNode::MapCustomPdos(EthercatSlave c_slave, int position)
             RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Failed to configure  PDOs!  ");
             return -1;
         } 
-        err = ecrt_domain_reg_pdo_entry_list(g_master_domain, slaves_[position].slave_pdo_entry_reg_);
+        err = ecrt_domain_reg_pdo_entry_list(master_domain_, slaves_[position].slave_pdo_entry_reg_);
         if ( err ){
             RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Failed to register PDO entries ");
             return -1;
@@ -688,7 +418,7 @@ void EthercatNode::ConfigDcSync(uint16_t assign_activate, int position)
 
 void EthercatNode::CheckSlaveConfigurationState()
 {
-    for(int i = 0 ; i < NUM_OF_SLAVES ;i++)
+    for(int i = first_slave_ ; i < end_slave_ ;i++)
     {
         slaves_[i].CheckSlaveConfigState();
 
@@ -698,51 +428,51 @@ void EthercatNode::CheckSlaveConfigurationState()
 int EthercatNode::CheckMasterState()
 {
     ec_master_state_t ms;
-    ecrt_master_state(g_master, &ms);
-    if (ms.slaves_responding != g_master_state.slaves_responding){
+    ecrt_master_state(master_, &ms);
+    if (ms.slaves_responding != master_state_.slaves_responding){
         RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"%u slave(s).\n", ms.slaves_responding);
         if (ms.slaves_responding < 1) {
             RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Connection error,no response from slaves.");
             return -1;
         }
     }
-    if (ms.al_states != g_master_state.al_states){
+    if (ms.al_states != master_state_.al_states){
         RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"AL states: 0x%02X.\n", ms.al_states);
     }
-    if (ms.link_up != g_master_state.link_up){
+    if (ms.link_up != master_state_.link_up){
         RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"Link is %s.\n", ms.link_up ? "up" : "down");
         if(!ms.link_up){ 
             RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Master state link down");
             return -1;
         }
     }
-    g_master_state = ms;
+    master_state_ = ms;
     return 0;
 }
 
 void EthercatNode::CheckMasterDomainState()
 {
     ec_domain_state_t ds;                     //Domain instance
-    ecrt_domain_state(g_master_domain, &ds);
-    if (ds.working_counter != g_master_domain_state.working_counter)
+    ecrt_domain_state(master_domain_, &ds);
+    if (ds.working_counter != master_domain_state_.working_counter)
         RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"masterDomain: WC %u.\n", ds.working_counter);
-    if (ds.wc_state != g_master_domain_state.wc_state)
+    if (ds.wc_state != master_domain_state_.wc_state)
         RCLCPP_INFO(rclcpp::get_logger("rclcpp"),"masterDomain: State %u.\n", ds.wc_state);
-    if(g_master_domain_state.wc_state == EC_WC_COMPLETE){
-        g_master_domain_state = ds;
+    if(master_domain_state_.wc_state == EC_WC_COMPLETE){
+        master_domain_state_ = ds;
     }
-    g_master_domain_state = ds;
+    master_domain_state_ = ds;
 }
 
 int EthercatNode::GetNumberOfConnectedSlaves()
 {
     unsigned int number_of_slaves;
     usleep(1e6);
-    ecrt_master_state(g_master,&g_master_state);
-    number_of_slaves = g_master_state.slaves_responding ;
-    if(NUM_OF_SLAVES != number_of_slaves){
-        std::cout << "Please enter correct number of slaves... " << std::endl;
-        std::cout << "Entered number of slave : " << NUM_OF_SLAVES << std::endl 
+    ecrt_master_state(master_,&master_state_);
+    number_of_slaves = master_state_.slaves_responding ;
+    if(unsigned(end_slave_ - first_slave_) != number_of_slaves){
+        std::cout << "Please enter correct number of slaves for master " << master_index_ << "... " << std::endl;
+        std::cout << "Entered number of slave : " << end_slave_ - first_slave_ << std::endl 
                   << "Connected slaves        : " << number_of_slaves << std::endl;
         return -1; 
     }
@@ -753,15 +483,15 @@ int EthercatNode::GetNumberOfConnectedSlaves()
 
 void EthercatNode::DeactivateCommunication()
 {
-    //ecrt_master_deactivate_slaves(g_master);
-    ecrt_master_deactivate(g_master);
-    ecrt_release_master(g_master);
+    //ecrt_master_deactivate_slaves(master_);
+    ecrt_master_deactivate(master_);
+    ecrt_release_master(master_);
 }
 
 void EthercatNode::ReleaseMaster()
 {
-    ecrt_master_deactivate(g_master);
-    ecrt_release_master(g_master);
+    ecrt_master_deactivate(master_);
+    ecrt_release_master(master_);
 }
 
 int EthercatNode::OpenEthercatMaster()
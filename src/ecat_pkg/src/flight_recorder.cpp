@@ -0,0 +1,316 @@
+#include "flight_recorder.hpp"
+#include "phase_trace.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+FlightRecorder::~FlightRecorder()
+{
+    Close();
+}
+
+int FlightRecorder::Open(const std::string & directory, uint32_t num_of_files, uint32_t records_per_file,
+                         uint32_t domain_size, const EthercatSlave * slaves,
+                         const EstimatorParameters<g_kNumberOfServoDrivers> & estimator,
+                         const FeedforwardModel<g_kNumberOfServoDrivers> * feedforward)
+{
+    if(running_){
+        Close();
+    }
+    if(!num_of_files || !records_per_file){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Flight recorder needs at least one file and one record per file.");
+        return -1;
+    }
+    directory_        = directory;
+    num_of_files_     = num_of_files;
+    records_per_file_ = records_per_file;
+    record_size_      = GetRecordSize(domain_size);
+
+    header_ = {};
+    header_.magic               = kFileMagic;
+    header_.version             = kFileVersion;
+    header_.header_size         = kFileHeaderSize;
+    header_.record_size         = record_size_;
+    header_.domain_size         = domain_size;
+    header_.frequency           = FREQUENCY;
+    header_.num_of_slaves       = NUM_OF_SLAVES;
+    header_.num_of_servo_drives = g_kNumberOfServoDrivers;
+    for(int i = 0 ; i < NUM_OF_SLAVES ; i++){
+        header_.offsets[i] = slaves[i].offset_;
+    }
+    header_.estimator = estimator;
+    if(feedforward){
+        header_.feedforward_enabled = 1;
+        header_.feedforward         = *feedforward;
+    }
+
+    if(mkdir(directory_.c_str(), 0755) && errno != EEXIST){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Couldn't create flight recorder directory %s : %s",
+                     directory_.c_str(), strerror(errno));
+        return -1;
+    }
+
+    // Ring is touched once so that it's resident before control loop starts.
+    ring_ = static_cast<uint8_t*>(aligned_alloc(64, size_t(kNumOfSlots) * record_size_));
+    if(!ring_){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Couldn't allocate flight recorder ring.");
+        return -1;
+    }
+    memset(ring_, 0, size_t(kNumOfSlots) * record_size_);
+    head_ = 0;
+    tail_ = 0;
+    dropped_records_ = 0;
+    current_slot_ = nullptr;
+    file_sequence_ = 0;
+
+    if(PreallocateFiles() || OpenNextFile()){
+        CloseFiles();
+        free(ring_);
+        ring_ = nullptr;
+        return -1;
+    }
+    running_ = true;
+    writer_thread_ = std::thread(&FlightRecorder::WriterLoop, this);
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Flight recorder : %u files of %u records (%u bytes) in %s",
+                num_of_files_, records_per_file_, record_size_, directory_.c_str());
+    return 0;
+}
+
+void FlightRecorder::Close()
+{
+    if(!running_){
+        return;
+    }
+    running_ = false;
+    writer_sleeping_ = 0;
+    syscall(SYS_futex, reinterpret_cast<int*>(&writer_sleeping_), FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    if(writer_thread_.joinable()){
+        writer_thread_.join();
+    }
+    CloseFiles();
+    free(ring_);
+    ring_ = nullptr;
+    if(dropped_records_){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Flight recorder dropped %llu records, writer couldn't keep up.",
+                     (unsigned long long)dropped_records_.load());
+    }
+}
+
+FlightRecorder::CycleRecord * FlightRecorder::BeginRecord()
+{
+    current_slot_ = nullptr;
+    if(!running_){
+        return nullptr;
+    }
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if(head - tail_.load(std::memory_order_acquire) >= kNumOfSlots){
+        dropped_records_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    current_slot_ = ring_ + (head % kNumOfSlots) * record_size_;
+    return reinterpret_cast<CycleRecord*>(current_slot_);
+}
+
+void FlightRecorder::SaveInputImage(const uint8_t * domain_data)
+{
+    if(current_slot_){
+        memcpy(current_slot_ + sizeof(CycleRecord), domain_data, header_.domain_size);
+    }
+}
+
+void FlightRecorder::SaveOutputImage(const uint8_t * domain_data)
+{
+    if(current_slot_){
+        memcpy(current_slot_ + sizeof(CycleRecord) + header_.domain_size, domain_data, header_.domain_size);
+    }
+}
+
+void FlightRecorder::CommitRecord()
+{
+    if(current_slot_){
+        const uint64_t head = head_.load(std::memory_order_relaxed) + 1;
+        head_.store(head, std::memory_order_seq_cst);
+        current_slot_ = nullptr;
+        WakeUpWriter(head);
+    }
+}
+
+void FlightRecorder::WakeUpWriter(uint64_t head)
+{
+    // Syscall is only made if writer sleeps, so at most once per kWakeUpBatch records.
+    if(writer_sleeping_.load(std::memory_order_seq_cst) &&
+       head - tail_.load(std::memory_order_relaxed) >= kWakeUpBatch){
+        writer_sleeping_.store(0, std::memory_order_relaxed);
+        syscall(SYS_futex, reinterpret_cast<int*>(&writer_sleeping_), FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+}
+
+void FlightRecorder::WaitForRecords()
+{
+    writer_sleeping_.store(1, std::memory_order_seq_cst);
+    // A record committed before the store above doesn't wake writer up, so pending records are checked again.
+    if(running_ && head_.load(std::memory_order_seq_cst) - tail_.load(std::memory_order_relaxed) < kWakeUpBatch){
+        const struct timespec timeout = {0, long(kIdleTimeoutMs) * 1000000};
+        syscall(SYS_futex, reinterpret_cast<int*>(&writer_sleeping_), FUTEX_WAIT_PRIVATE, 1, &timeout, NULL, 0);
+    }
+    writer_sleeping_.store(0, std::memory_order_relaxed);
+}
+
+void FlightRecorder::WriterLoop()
+{
+    PhaseTrace::RegisterThread("flight recorder");
+    bool stop = false;
+    while(!stop){
+        // Remaining records are written before leaving.
+        stop = !running_;
+        uint64_t head = head_.load(std::memory_order_acquire);
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if(head == tail){
+            if(!stop){
+                WaitForRecords();
+            }
+            continue;
+        }
+        PhaseTrace::Mark(PhaseTrace::kRecorderWrite);
+        for( ; tail != head ; tail++){
+            if(records_in_file_ == records_per_file_){
+                if(OpenNextFile()){
+                    // Keep consuming, otherwise control thread only drops records.
+                    tail = head;
+                    break;
+                }
+            }
+            if(file_map_){
+                memcpy(file_map_ + kFileHeaderSize + records_in_file_ * record_size_,
+                       ring_ + (tail % kNumOfSlots) * record_size_, record_size_);
+                records_in_file_++;
+            }
+        }
+        tail_.store(tail, std::memory_order_release);
+        if(file_map_){
+            reinterpret_cast<FileHeader*>(file_map_)->num_of_records = records_in_file_;
+        }
+        PhaseTrace::Mark(PhaseTrace::kIdle);
+    }
+}
+
+int FlightRecorder::PreallocateFiles()
+{
+    file_size_ = kFileHeaderSize + size_t(records_per_file_) * record_size_;
+    file_fds_.assign(num_of_files_, -1);
+    for(uint32_t i = 0 ; i < num_of_files_ ; i++){
+        char file_name[64];
+        snprintf(file_name, sizeof(file_name), "/flight_%02u.ecfr", i);
+        const std::string path = directory_ + file_name;
+        file_fds_[i] = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if(file_fds_[i] < 0){
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Couldn't open %s : %s", path.c_str(), strerror(errno));
+            return -1;
+        }
+        // Whole set is allocated here, so rotation on writer thread never extends or allocates a file.
+        if(ftruncate(file_fds_[i], file_size_) || posix_fallocate(file_fds_[i], 0, file_size_)){
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Couldn't preallocate %s.", path.c_str());
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int FlightRecorder::OpenNextFile()
+{
+    CloseFile();
+    const uint32_t index = uint32_t(file_sequence_ % num_of_files_);
+    void * map = mmap(NULL, file_size_, PROT_READ | PROT_WRITE, MAP_SHARED, file_fds_[index], 0);
+    if(map == MAP_FAILED){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Couldn't map flight recorder file %u : %s", index, strerror(errno));
+        return -1;
+    }
+    // mlockall(MCL_FUTURE) locks new mappings as well, file pages don't have to stay resident.
+    munlock(map, file_size_);
+    file_map_ = static_cast<uint8_t*>(map);
+    header_.sequence       = file_sequence_++;
+    header_.num_of_records = 0;
+    memcpy(file_map_, &header_, sizeof(header_));
+    records_in_file_ = 0;
+    return 0;
+}
+
+void FlightRecorder::CloseFile()
+{
+    if(file_map_){
+        reinterpret_cast<FileHeader*>(file_map_)->num_of_records = records_in_file_;
+        msync(file_map_, file_size_, MS_ASYNC);
+        munmap(file_map_, file_size_);
+        file_map_ = nullptr;
+    }
+}
+
+void FlightRecorder::CloseFiles()
+{
+    CloseFile();
+    for(int & fd : file_fds_){
+        if(fd >= 0){
+            close(fd);
+        }
+    }
+    file_fds_.clear();
+}
+
+FlightRecordFile::~FlightRecordFile()
+{
+    Close();
+}
+
+int FlightRecordFile::Open(const std::string & path)
+{
+    Close();
+    fd_ = open(path.c_str(), O_RDONLY);
+    if(fd_ < 0){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Couldn't open %s : %s", path.c_str(), strerror(errno));
+        return -1;
+    }
+    struct stat file_stat;
+    if(fstat(fd_, &file_stat) || size_t(file_stat.st_size) < FlightRecorder::kFileHeaderSize){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "%s is not a flight recorder file.", path.c_str());
+        Close();
+        return -1;
+    }
+    map_size_ = file_stat.st_size;
+    void * map = mmap(NULL, map_size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if(map == MAP_FAILED){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Couldn't map %s : %s", path.c_str(), strerror(errno));
+        map_size_ = 0;
+        Close();
+        return -1;
+    }
+    map_    = static_cast<uint8_t*>(map);
+    header_ = reinterpret_cast<const FlightRecorder::FileHeader*>(map_);
+
+    // Records are decoded with structures of this build, layout has to match.
+    if(header_->magic != FlightRecorder::kFileMagic || header_->version != FlightRecorder::kFileVersion ||
+       header_->num_of_slaves != NUM_OF_SLAVES || header_->num_of_servo_drives != g_kNumberOfServoDrivers ||
+       header_->record_size != FlightRecorder::GetRecordSize(header_->domain_size) ||
+       header_->header_size + header_->num_of_records * header_->record_size > map_size_){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "%s doesn't match this build's record layout.", path.c_str());
+        Close();
+        return -1;
+    }
+    return 0;
+}
+
+void FlightRecordFile::Close()
+{
+    if(map_){
+        munmap(map_, map_size_);
+        map_ = nullptr;
+        header_ = nullptr;
+    }
+    if(fd_ >= 0){
+        close(fd_);
+        fd_ = -1;
+    }
+}
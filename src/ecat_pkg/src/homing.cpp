@@ -0,0 +1,134 @@
+#include "homing.hpp"
+
+namespace
+{
+/// Drive needs a few cycles to take start command, status bits of previous homing are ignored meanwhile.
+const uint32_t kStartCycles = 10;
+/// Cycles drive has to take back operating mode after homing.
+const uint32_t kSwitchBackCycles = FREQUENCY / 10;
+
+inline bool IsOperationEnabled(uint16_t status_word)
+{
+    // xxxx xxxx x01x 0111 , same coding as EthercatLifeCycle::GetDriveState()
+    return (status_word & 0x006F) == 0x0027;
+}
+}
+
+void HomingSequence::Configure(int8_t operating_mode, uint32_t timeout_cycles)
+{
+    operating_mode_ = operating_mode;
+    timeout_cycles_ = timeout_cycles;
+    if(!IsActive()){
+        op_mode_ = operating_mode;
+    }
+}
+
+int HomingSequence::Start()
+{
+    if(IsActive()){
+        return -1;
+    }
+    state_        = kSwitchingToHoming;
+    result_       = kNone;
+    cycles_       = 0;
+    op_mode_      = kHoming;
+    control_word_ = SM_GO_ENABLE;
+    return 0;
+}
+
+void HomingSequence::Abort()
+{
+    if(IsActive() && state_ != kSwitchingBack){
+        Fail(kAborted);
+    }
+}
+
+void HomingSequence::Reset()
+{
+    if(IsActive()){
+        result_ = kAborted;
+        state_  = kFailed;
+    }
+    op_mode_      = operating_mode_;
+    control_word_ = SM_GO_ENABLE;
+}
+
+void HomingSequence::Fail(Result result)
+{
+    result_            = result;
+    state_             = kSwitchingBack;
+    switch_back_cycle_ = cycles_;
+    op_mode_           = operating_mode_;
+    control_word_      = SM_GO_ENABLE;
+}
+
+void HomingSequence::Update(uint16_t status_word, int8_t mode_display)
+{
+    if(!IsActive()){
+        return;
+    }
+    cycles_++;
+    if(state_ != kSwitchingBack){
+        if(!IsOperationEnabled(status_word)){
+            // Fault or disable, drive's state machine takes over and mode is commanded back right away.
+            result_  = kDriveDisabled;
+            state_   = kFailed;
+            op_mode_ = operating_mode_;
+            return;
+        }
+        if(cycles_ > timeout_cycles_){
+            Fail(kTimeout);
+            return;
+        }
+    }
+    switch(state_){
+        case kSwitchingToHoming:
+            if(mode_display == kHoming){
+                state_        = kStarting;
+                start_cycle_  = cycles_;
+                control_word_ = SM_START_HOMING;
+            }
+            break;
+        case kStarting:
+            if(TEST_BIT(status_word, kHomingErrorBit)){
+                Fail(kHomingError);
+            }else if(!TEST_BIT(status_word, kHomingAttainedBit) || cycles_ - start_cycle_ >= kStartCycles){
+                state_ = kRunning;
+            }
+            break;
+        case kRunning:
+            if(TEST_BIT(status_word, kHomingErrorBit)){
+                Fail(kHomingError);
+            }else if(TEST_BIT(status_word, kHomingAttainedBit) && TEST_BIT(status_word, kTargetReachedBit)){
+                result_            = kSuccess;
+                state_             = kSwitchingBack;
+                switch_back_cycle_ = cycles_;
+                op_mode_           = operating_mode_;
+                control_word_      = SM_GO_ENABLE;
+            }
+            break;
+        case kSwitchingBack:
+            if(mode_display == operating_mode_){
+                state_ = result_ == kSuccess ? kAttained : kFailed;
+            }else if(cycles_ - switch_back_cycle_ > kSwitchBackCycles){
+                // Mode stays commanded, but drive didn't take it.
+                result_ = kTimeout;
+                state_  = kFailed;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+const char * HomingSequence::ResultName(Result result)
+{
+    switch(result){
+        case kSuccess       : return "attained";
+        case kTimeout       : return "timed out";
+        case kHomingError   : return "homing error";
+        case kDriveDisabled : return "drive left operation enabled";
+        case kAborted       : return "aborted";
+        default             : return "none";
+    }
+}
@@ -0,0 +1,76 @@
+#include "latency_trace.hpp"
+
+void LatencyTrace::SetSource(int64_t source_ns, uint64_t id)
+{
+    source_id_.store(id, std::memory_order_relaxed);
+    source_ns_.store(source_ns, std::memory_order_release);
+}
+
+void LatencyTrace::Latch(int64_t now_ns)
+{
+    int64_t source_ns = source_ns_.load(std::memory_order_acquire);
+    if(!source_ns || source_ns == latched_source_ns_){
+        return;
+    }
+    latched_source_ns_ = source_ns;
+    latched_id_        = source_id_.load(std::memory_order_relaxed);
+    latch_ns_          = now_ns;
+    pending_           = true;
+}
+
+void LatencyTrace::Sent(int64_t now_ns)
+{
+    if(!pending_){
+        return;
+    }
+    pending_ = false;
+    // Source clock may be slightly off if input node runs on another host.
+    uint64_t latch_latency = latch_ns_ > latched_source_ns_ ? latch_ns_ - latched_source_ns_ : 0;
+    uint64_t send_latency  = now_ns > latched_source_ns_ ? now_ns - latched_source_ns_ : 0;
+
+    // Single writer, plain load/store is enough.
+    count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    last_id_.store(latched_id_, std::memory_order_relaxed);
+    latch_sum_ns_.store(latch_sum_ns_.load(std::memory_order_relaxed) + latch_latency, std::memory_order_relaxed);
+    send_sum_ns_.store(send_sum_ns_.load(std::memory_order_relaxed) + send_latency, std::memory_order_relaxed);
+    if(latch_latency > latch_max_ns_.load(std::memory_order_relaxed)) latch_max_ns_.store(latch_latency, std::memory_order_relaxed);
+    if(send_latency > send_max_ns_.load(std::memory_order_relaxed))   send_max_ns_.store(send_latency, std::memory_order_relaxed);
+
+    uint64_t bin = send_latency / kBinWidthNs;
+    if(bin >= kNumOfBins) bin = kNumOfBins - 1;
+    histogram_[bin].store(histogram_[bin].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void LatencyTrace::Fill(ecat_msgs::msg::InputLatency & msg) const
+{
+    uint64_t count    = count_.load(std::memory_order_relaxed);
+    msg.count         = count;
+    msg.last_id       = last_id_.load(std::memory_order_relaxed);
+    msg.latch_mean_us = count ? latch_sum_ns_.load(std::memory_order_relaxed) / 1e3 / count : 0.0;
+    msg.latch_max_us  = latch_max_ns_.load(std::memory_order_relaxed) / 1e3;
+    msg.send_mean_us  = count ? send_sum_ns_.load(std::memory_order_relaxed) / 1e3 / count : 0.0;
+    msg.send_max_us   = send_max_ns_.load(std::memory_order_relaxed) / 1e3;
+    msg.bin_width_us  = kBinWidthNs / 1000;
+
+    uint64_t total = 0;
+    for(uint32_t i = 0 ; i < kNumOfBins ; i++){
+        msg.send_histogram[i] = histogram_[i].load(std::memory_order_relaxed);
+        total += msg.send_histogram[i];
+    }
+    // Percentiles are upper edges of the bins they fall into.
+    msg.send_p50_us = 0.0;
+    msg.send_p99_us = 0.0;
+    uint64_t cumulative = 0;
+    bool p50_found = false;
+    for(uint32_t i = 0 ; i < kNumOfBins && total ; i++){
+        cumulative += msg.send_histogram[i];
+        if(!p50_found && cumulative * 2 >= total){
+            msg.send_p50_us = (i + 1) * msg.bin_width_us;
+            p50_found = true;
+        }
+        if(cumulative * 100 >= total * 99){
+            msg.send_p99_us = (i + 1) * msg.bin_width_us;
+            break;
+        }
+    }
+}
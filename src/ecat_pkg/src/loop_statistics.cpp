@@ -0,0 +1,94 @@
+#include "loop_statistics.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+void LoopStatistics::Configure(uint32_t window_cycles, uint32_t spike_threshold_ns)
+{
+    window_cycles_      = window_cycles ? window_cycles : 1;
+    spike_threshold_ns_ = spike_threshold_ns;
+}
+
+void LoopStatistics::Start()
+{
+    for(uint32_t i = 0 ; i < kNumOfBins ; i++){
+        histogram_[i] = 0;
+    }
+    num_of_windows_   = 0;
+    cycles_in_window_ = 0;
+    current_          = {};
+    getrusage(RUSAGE_THREAD, &last_usage_);
+}
+
+void LoopStatistics::AddCycle(uint32_t exec_ns, uint32_t latency_ns)
+{
+    uint32_t bin = exec_ns / kBinWidthNs;
+    if(bin >= kNumOfBins) bin = kNumOfBins - 1;
+    histogram_[bin]++;
+
+    if(exec_ns > current_.exec_max_ns)          current_.exec_max_ns    = exec_ns;
+    if(latency_ns > current_.latency_max_ns)    current_.latency_max_ns = latency_ns;
+    if(exec_ns > spike_threshold_ns_)           current_.num_of_spikes++;
+
+    cycles_in_window_++;
+    if(cycles_in_window_ == window_cycles_){
+        CloseWindow();
+    }
+}
+
+void LoopStatistics::CloseWindow()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    current_.index                = num_of_windows_;
+    current_.minor_faults         = usage.ru_minflt - last_usage_.ru_minflt;
+    current_.major_faults         = usage.ru_majflt - last_usage_.ru_majflt;
+    current_.voluntary_switches   = usage.ru_nvcsw  - last_usage_.ru_nvcsw;
+    current_.involuntary_switches = usage.ru_nivcsw - last_usage_.ru_nivcsw;
+    last_usage_ = usage;
+
+    windows_[num_of_windows_ % kMaxNumOfWindows] = current_;
+    num_of_windows_++;
+    current_          = {};
+    cycles_in_window_ = 0;
+}
+
+void LoopStatistics::Print() const
+{
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "-----------------------------------------------");
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Texec histogram (%u ns bins) :", kBinWidthNs);
+    for(uint32_t i = 0 ; i < kNumOfBins ; i++){
+        if(!histogram_[i]) continue;
+        if(i == kNumOfBins - 1){
+            RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "  >= %8u ns : %llu", i * kBinWidthNs,
+                        (unsigned long long)histogram_[i]);
+        }else{
+            RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "  %8u - %8u ns : %llu", i * kBinWidthNs, (i + 1) * kBinWidthNs,
+                        (unsigned long long)histogram_[i]);
+        }
+    }
+
+    uint32_t first = num_of_windows_ > kMaxNumOfWindows ? num_of_windows_ - kMaxNumOfWindows : 0;
+    uint32_t spike_windows = 0, spike_windows_with_faults = 0, spike_windows_with_preemption = 0;
+    uint32_t fault_windows = 0, preemption_windows = 0;
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Windows with Texec above %u ns (%u cycles per window) :", 
+                spike_threshold_ns_, window_cycles_);
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "  window | spikes | exec max ns | latency max ns | minflt | majflt | nvcsw | nivcsw");
+    for(uint32_t i = first ; i < num_of_windows_ ; i++){
+        const WindowStats & w = windows_[i % kMaxNumOfWindows];
+        bool faulted   = w.minor_faults || w.major_faults;
+        bool preempted = w.involuntary_switches != 0;
+        if(faulted)   fault_windows++;
+        if(preempted) preemption_windows++;
+        if(!w.num_of_spikes) continue;
+        spike_windows++;
+        if(faulted)   spike_windows_with_faults++;
+        if(preempted) spike_windows_with_preemption++;
+        RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "  %6u | %6u | %11u | %14u | %6ld | %6ld | %5ld | %6ld",
+                    w.index, w.num_of_spikes, w.exec_max_ns, w.latency_max_ns,
+                    (long)w.minor_faults, (long)w.major_faults, (long)w.voluntary_switches, (long)w.involuntary_switches);
+    }
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Windows : %u | with spikes : %u | with faults : %u | with involuntary switches : %u",
+                num_of_windows_ - first, spike_windows, fault_windows, preemption_windows);
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Spike windows with faults : %u | with involuntary switches : %u",
+                spike_windows_with_faults, spike_windows_with_preemption);
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "-----------------------------------------------");
+}
@@ -41,14 +41,31 @@ int main(int argc, char **argv)
 
     /* Turn off mmap usage. */
     mallopt(M_MMAP_MAX, 0);
+
+    /* Prepare allocation tracker before real-time threads start. */
+    AllocTracker::Init();
+    PhaseTrace::Init();
     // -----------------------------------------------------------------------------
 
     // CKim - Initialize and launch EthercatLifeCycleNode
     ecat_lifecycle_node = std::make_unique<EthercatLifeCycleNode::EthercatLifeCycle>();
-    rclcpp::spin(ecat_lifecycle_node->get_node_base_interface());
+
+    // Executor uses node's TLSF memory strategy instead of global heap.
+    rclcpp::ExecutorOptions executor_options;
+    executor_options.memory_strategy = ecat_lifecycle_node->GetMemoryStrategy();
+    rclcpp::executors::SingleThreadedExecutor executor(executor_options);
+    executor.add_node(ecat_lifecycle_node->get_node_base_interface());
+
+    // Allocations of this thread are counted after control loop warm-up.
+    AllocTracker::SetThreadTag(AllocTracker::kExecutorThread);
+    PhaseTrace::RegisterThread("executor");
+    executor.spin();
     
     // CKim - Terminate node
     rclcpp::shutdown();
+    if(ecat_lifecycle_node->RtAllocationDetected() || ecat_lifecycle_node->ReplayFailed()){
+        return -1;
+    }
     return 0;
 }
 
@@ -0,0 +1,134 @@
+#include "phase_trace.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include "rclcpp/rclcpp.hpp"
+
+namespace PhaseTrace
+{
+thread_local ThreadRing * t_ring = nullptr;
+
+namespace
+{
+const char * const kPhaseNames[kNumOfPhases] = {
+    "idle", "sleep", "receive", "domain process", "status check", "publish", "read",
+    "state machine", "update", "write", "record", "queue", "sync", "send",
+    "joystick callback", "haptic callback", "gui callback", "latency timer", "trace dump",
+    "recorder write"
+};
+
+/// Oldest events may be overwritten while dumping, they are skipped.
+const uint32_t kDumpGuard = 4096;
+
+std::mutex               g_register_mutex;
+std::atomic<uint32_t>    g_num_of_threads{0};
+ThreadRing *             g_rings[kMaxNumOfThreads] = {};
+uint64_t                 g_reference_timestamp = 0;
+int64_t                  g_reference_ns = 0;
+
+/// Releases ring of the thread when it exits.
+struct RingOwner
+{
+    ~RingOwner()
+    {
+        if(t_ring){
+            t_ring->in_use.store(false, std::memory_order_release);
+            t_ring = nullptr;
+        }
+    }
+};
+thread_local RingOwner t_owner;
+
+int64_t MonotonicNs()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return int64_t(t.tv_sec) * 1000000000LL + t.tv_nsec;
+}
+}  // namespace
+
+void Init()
+{
+    g_reference_timestamp = ReadTimestamp();
+    g_reference_ns        = MonotonicNs();
+}
+
+int RegisterThread(const char * name)
+{
+    std::lock_guard<std::mutex> lock(g_register_mutex);
+    if(t_ring){
+        return 0;
+    }
+    // Touching the owner makes sure its destructor runs at thread exit.
+    (void)&t_owner;
+    uint32_t index = g_num_of_threads.load();
+    for(uint32_t i = 0 ; i < index ; i++){
+        ThreadRing * ring = g_rings[i];
+        if(!ring->in_use.load(std::memory_order_acquire) && !strncmp(ring->name, name, sizeof(ring->name) - 1)){
+            ring->in_use.store(true, std::memory_order_relaxed);
+            t_ring = ring;
+            return 0;
+        }
+    }
+    if(index >= kMaxNumOfThreads){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Phase trace supports %u threads, \"%s\" isn't traced.",
+                     kMaxNumOfThreads, name);
+        return -1;
+    }
+    ThreadRing * ring = new ThreadRing();
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+    ring->in_use.store(true);
+    ring->head.store(0);
+    g_rings[index] = ring;
+    g_num_of_threads.store(index + 1, std::memory_order_release);
+    t_ring = ring;
+    return 0;
+}
+
+int DumpChromeTrace(const std::string & path, double seconds)
+{
+    FILE * file = fopen(path.c_str(), "w");
+    if(!file){
+        return -1;
+    }
+    // Ticks per ns from reference taken in Init() until now.
+    const uint64_t now_timestamp = ReadTimestamp();
+    const int64_t  now_ns        = MonotonicNs();
+    const double   ticks_per_ns  = now_ns > g_reference_ns ?
+                                   double(now_timestamp - g_reference_timestamp) / (now_ns - g_reference_ns) : 1.0;
+    const int64_t  start_ns      = now_ns - int64_t(seconds * 1e9);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    const uint32_t num_of_threads = g_num_of_threads.load(std::memory_order_acquire);
+    for(uint32_t tid = 0 ; tid < num_of_threads ; tid++){
+        const ThreadRing * ring = g_rings[tid];
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", tid, ring->name);
+        first = false;
+
+        const uint64_t head  = ring->head.load(std::memory_order_acquire);
+        const uint64_t count = head < kRingSize - kDumpGuard ? head : kRingSize - kDumpGuard;
+        // Each event lasts until next event of the same thread, last one is still open.
+        for(uint64_t i = head - count ; i + 1 < head ; i++){
+            const Event & event = ring->events[i % kRingSize];
+            const Event & next  = ring->events[(i + 1) % kRingSize];
+            if(event.phase == kIdle || event.phase >= kNumOfPhases){
+                continue;
+            }
+            const int64_t begin_ns = g_reference_ns + int64_t((int64_t(event.timestamp - g_reference_timestamp)) / ticks_per_ns);
+            const int64_t end_ns   = g_reference_ns + int64_t((int64_t(next.timestamp - g_reference_timestamp)) / ticks_per_ns);
+            if(begin_ns < start_ns || end_ns < begin_ns){
+                continue;
+            }
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    kPhaseNames[event.phase], tid, begin_ns / 1e3, (end_ns - begin_ns) / 1e3);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return 0;
+}
+}  // namespace PhaseTrace
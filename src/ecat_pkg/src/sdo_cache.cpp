@@ -0,0 +1,210 @@
+#include "sdo_cache.hpp"
+#include "rclcpp/rclcpp.hpp"
+
+#include <fstream>
+#include <sstream>
+
+int SdoParameterSet::Add(uint16_t index, uint8_t subindex, uint8_t size, uint32_t value, bool complete_access)
+{
+    for(auto & write : writes_){
+        if(write.index == index && write.subindex == subindex){
+            write.size  = size;
+            write.value = value;
+            write.complete_access = complete_access;
+            return 0;
+        }
+    }
+    writes_.push_back({index, subindex, size, value, complete_access});
+    return 0;
+}
+
+uint32_t SdoParameterSet::Hash(const std::vector<SdoWrite> & writes)
+{
+    uint32_t hash = 2166136261u;
+    auto add = [&hash](uint32_t v, int bytes){
+        for(int i = 0 ; i < bytes ; i++){
+            hash ^= (v >> (8 * i)) & 0xff;
+            hash *= 16777619u;
+        }
+    };
+    for(const auto & write : writes){
+        add(write.index, 2);
+        add(write.subindex, 1);
+        add(write.size, 1);
+        add(write.value, 4);
+    }
+    return hash;
+}
+
+int SdoParameterSet::Queue(ec_slave_config_t * sc, const SdoWrite & write)
+{
+    int err;
+    switch(write.size){
+        case 1 : err = ecrt_slave_config_sdo8(sc, write.index, write.subindex, write.value); break;
+        case 2 : err = ecrt_slave_config_sdo16(sc, write.index, write.subindex, write.value); break;
+        case 4 : err = ecrt_slave_config_sdo32(sc, write.index, write.subindex, write.value); break;
+        default : err = -1;
+    }
+    if(err){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Queueing SDO 0x%04x:%02x failed ! ", write.index, write.subindex);
+        return -1;
+    }
+    return 0;
+}
+
+int SdoParameterSet::QueueComplete(ec_slave_config_t * sc, const SdoWrite * writes, size_t count)
+{
+    // Subindex 0 is part of complete access data, padded to 16 bits.
+    std::vector<uint8_t> data(2);
+    data[0] = count;
+    for(size_t i = 0 ; i < count ; i++){
+        const size_t offset = data.size();
+        data.resize(offset + writes[i].size);
+        switch(writes[i].size){
+            case 1 : EC_WRITE_U8(&data[offset], writes[i].value);  break;
+            case 2 : EC_WRITE_U16(&data[offset], writes[i].value); break;
+            default: EC_WRITE_U32(&data[offset], writes[i].value); break;
+        }
+    }
+    if(ecrt_slave_config_complete_sdo(sc, writes[0].index, data.data(), data.size())){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Queueing complete SDO 0x%04x failed ! ", writes[0].index);
+        return -1;
+    }
+    return 0;
+}
+
+int SdoParameterSet::QueueAll(ec_slave_config_t * sc, const std::vector<SdoWrite> & writes)
+{
+    for(size_t i = 0 ; i < writes.size() ; ){
+        if(!writes[i].complete_access){
+            if(Queue(sc, writes[i])){
+                return -1;
+            }
+            i++;
+            continue;
+        }
+        size_t end = i + 1;
+        while(end < writes.size() && writes[end].complete_access && writes[end].index == writes[i].index){
+            end++;
+        }
+        if(QueueComplete(sc, &writes[i], end - i)){
+            return -1;
+        }
+        i = end;
+    }
+    return 0;
+}
+
+int SdoParameterCache::Open(const std::string & file)
+{
+    file_ = file;
+    entries_.clear();
+    std::ifstream in(file);
+    if(!in){
+        RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "SDO cache %s doesn't exist yet, all parameters will be written.", file.c_str());
+        open_ = true;
+        return 0;
+    }
+    std::string line;
+    while(std::getline(in, line)){
+        if(line.empty() || line[0] == '#'){
+            continue;
+        }
+        std::istringstream fields(line);
+        uint32_t vendor, product, serial, index, subindex, size, value;
+        fields >> std::hex >> vendor >> product >> serial >> index >> subindex >> std::dec >> size >> std::hex >> value;
+        if(!fields || (size != 1 && size != 2 && size != 4)){
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "SDO cache %s has invalid line : %s", file.c_str(), line.c_str());
+            entries_.clear();
+            return -1;
+        }
+        // Complete access only changes how parameters are downloaded, not what drive holds.
+        entries_[Key(vendor, product, serial)].push_back({uint16_t(index), uint8_t(subindex), uint8_t(size), value, false});
+    }
+    open_ = true;
+    return 0;
+}
+
+int SdoParameterCache::Queue(ec_master_t * master, EthercatSlave & slave, const SdoParameterSet & set)
+{
+    const ec_slave_info_t & info = slave.slave_info_;
+    const std::vector<SdoWrite> & writes = set.GetWrites();
+    // Without a serial number identical drives can't be told apart.
+    if(!info.serial_number){
+        return SdoParameterSet::QueueAll(slave.slave_config_, writes);
+    }
+    const Key key(info.vendor_id, info.product_code, info.serial_number);
+    const std::vector<SdoWrite> * cached = NULL;
+    auto entry = entries_.find(key);
+    if(entry != entries_.end()){
+        uint8_t data[4];
+        size_t  result_size = 0;
+        uint32_t abort_code = 0;
+        if(!ecrt_master_sdo_upload(master, info.position, OD_CUSTOM_PERSISTENT_MEMORY_1, data, sizeof(data),
+                                   &result_size, &abort_code) && result_size == sizeof(data) &&
+           EC_READ_U32(data) == SdoParameterSet::Hash(entry->second)){
+            cached = &entry->second;
+        }
+    }
+
+    std::vector<bool> held(writes.size(), false);
+    for(size_t i = 0 ; cached && i < writes.size() ; i++){
+        for(const auto & c : *cached){
+            if(c.index == writes[i].index && c.subindex == writes[i].subindex &&
+               c.size == writes[i].size && c.value == writes[i].value){
+                held[i] = true;
+                break;
+            }
+        }
+    }
+    // Complete access records are downloaded as a whole if any of their entries changed.
+    for(size_t i = 0 ; i < writes.size() ; i++){
+        if(!held[i] && writes[i].complete_access){
+            for(size_t j = 0 ; j < writes.size() ; j++){
+                if(writes[j].complete_access && writes[j].index == writes[i].index){
+                    held[j] = false;
+                }
+            }
+        }
+    }
+    std::vector<SdoWrite> pending;
+    for(size_t i = 0 ; i < writes.size() ; i++){
+        if(!held[i]){
+            pending.push_back(writes[i]);
+        }
+    }
+    if(SdoParameterSet::QueueAll(slave.slave_config_, pending)){
+        return -1;
+    }
+    const uint32_t skipped = writes.size() - pending.size();
+    if(!pending.empty()){
+        const SdoWrite hash = {OD_CUSTOM_PERSISTENT_MEMORY_1, 4, SdoParameterSet::Hash(writes), false};
+        if(SdoParameterSet::Queue(slave.slave_config_, hash)){
+            return -1;
+        }
+    }
+    entries_[key] = writes;
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Slave %d (serial 0x%08x) : %u of %u parameters already set, %u queued.\n",
+                info.position, info.serial_number, skipped, uint32_t(writes.size()), uint32_t(writes.size()) - skipped);
+    return 0;
+}
+
+int SdoParameterCache::Save() const
+{
+    std::ofstream out(file_, std::ios::trunc);
+    if(!out){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Couldn't write SDO cache %s", file_.c_str());
+        return -1;
+    }
+    out << "# vendor_id product_code serial_number index subindex size value\n";
+    char line[96];
+    for(const auto & entry : entries_){
+        for(const auto & write : entry.second){
+            snprintf(line, sizeof(line), "%08x %08x %08x %04x %02x %u %08x\n",
+                     std::get<0>(entry.first), std::get<1>(entry.first), std::get<2>(entry.first),
+                     write.index, write.subindex, write.size, write.value);
+            out << line;
+        }
+    }
+    return out ? 0 : -1;
+}
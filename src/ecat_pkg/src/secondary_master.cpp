@@ -0,0 +1,157 @@
+#include "secondary_master.hpp"
+#include "phase_trace.hpp"
+
+using namespace EthercatCommunication;
+
+SecondaryMaster::SecondaryMaster(uint32_t master_index, int first_slave, int num_of_slaves, int cpu)
+    : node_(std::make_unique<EthercatNode>(master_index, first_slave, num_of_slaves)), cpu_(cpu)
+{
+
+}
+
+SecondaryMaster::~SecondaryMaster()
+{
+    Stop();
+}
+
+void SecondaryMaster::AttachTo(EthercatNode & control_node)
+{
+    domain_data_ = ecrt_domain_data(node_->master_domain_);
+    image_size_  = ecrt_domain_size(node_->master_domain_);
+    inputs_.Resize(image_size_);
+    outputs_.Resize(image_size_);
+    shadow_.assign(image_size_, 0);
+    for(int i = node_->GetFirstSlave() ; i < node_->GetEndSlave() ; i++){
+        control_node.slaves_[i] = node_->slaves_[i];
+        control_node.slaves_[i].slave_pdo_domain_ = shadow_.data();
+    }
+}
+
+int SecondaryMaster::Start(const struct timespec & start_time, int32_t phase_shift_ns, int priority)
+{
+    pthread_attr_t attr;
+    struct sched_param param = {};
+    param.sched_priority = priority;
+    start_time_ = timespec_add(start_time, {0, phase_shift_ns});
+
+    if(pthread_attr_init(&attr)){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Error initializing thread attribute  ! ");
+        return -1;
+    }
+    int err = pthread_attr_setstacksize(&attr, 4096*64);
+    err |= pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    err |= pthread_attr_setschedparam(&attr, &param);
+    err |= pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    if(cpu_ >= 0){
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpu_, &mask);
+        err |= pthread_attr_setaffinity_np(&attr, sizeof(mask), &mask);
+    }
+    if(err){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Setting thread attributes of master %u failed ! ", node_->GetMasterIndex());
+        pthread_attr_destroy(&attr);
+        return -1;
+    }
+    running_ = true;
+    err = pthread_create(&thread_, &attr, &SecondaryMaster::PassCyclicExchange, this);
+    pthread_attr_destroy(&attr);
+    if(err){
+        running_ = false;
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Error : Couldn't start thread of master %u.!", node_->GetMasterIndex());
+        return -1;
+    }
+    started_ = true;
+    RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Master %u cyclic thread started on CPU %d.\n", node_->GetMasterIndex(), cpu_);
+    return 0;
+}
+
+void SecondaryMaster::Stop()
+{
+    running_ = false;
+    if(started_){
+        pthread_join(thread_, NULL);
+        started_ = false;
+    }
+}
+
+void SecondaryMaster::ReceiveImage()
+{
+    if(inputs_.Acquire()){
+        memcpy(shadow_.data(), inputs_.ReadBuffer(), image_size_);
+    }else{
+        missed_images_++;
+    }
+}
+
+void SecondaryMaster::SendImage()
+{
+    memcpy(outputs_.WriteBuffer(), shadow_.data(), image_size_);
+    outputs_.Publish();
+}
+
+void * SecondaryMaster::PassCyclicExchange(void * arg)
+{
+    static_cast<SecondaryMaster*>(arg)->CyclicExchange();
+    return NULL;
+}
+
+void SecondaryMaster::CyclicExchange()
+{
+    char name[32];
+    snprintf(name, sizeof(name), "master %u", node_->GetMasterIndex());
+    PhaseTrace::RegisterThread(name);
+    struct timespec wake_up_time = start_time_, time;
+    int status_check_counter = 0;
+    // Counted from first output image on, zeroed initial image is harmless until control thread starts.
+    bool has_outputs = false;
+    uint32_t stale_output_cycles = 0;
+    while(running_){
+        PhaseTrace::Mark(PhaseTrace::kSleep);
+        wake_up_time = timespec_add(wake_up_time, g_cycle_time);
+        clock_nanosleep(CLOCK_TO_USE, TIMER_ABSTIME, &wake_up_time, NULL);
+        PhaseTrace::Mark(PhaseTrace::kReceive);
+        ecrt_master_application_time(node_->master_, TIMESPEC2NS(wake_up_time));
+        ecrt_master_receive(node_->master_);
+        ecrt_domain_process(node_->master_domain_);
+
+        memcpy(inputs_.WriteBuffer(), domain_data_, image_size_);
+        inputs_.Publish();
+        // Image from control thread covers inputs as well, they are overwritten by next receive.
+        if(outputs_.Acquire()){
+            memcpy(domain_data_, outputs_.ReadBuffer(), image_size_);
+            if(stale_output_cycles > kMaxStaleOutputCycles){
+                RCLCPP_INFO(rclcpp::get_logger("rclcpp"), "Master %u : control thread sends output images again, exchange resumed.",
+                            node_->GetMasterIndex());
+            }
+            has_outputs = true;
+            stale_output_cycles = 0;
+        }else if(has_outputs && ++stale_output_cycles == kMaxStaleOutputCycles + 1){
+            output_stalls_.fetch_add(1, std::memory_order_relaxed);
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Master %u : no output image from control thread for %u cycles, "
+                         "domain isn't queued until it sends again so slave watchdogs trip.", node_->GetMasterIndex(), kMaxStaleOutputCycles);
+        }
+
+        PhaseTrace::Mark(PhaseTrace::kStatusCheck);
+        if(status_check_counter){
+            status_check_counter--;
+        }else{
+            node_->CheckMasterState();
+            al_states_.store(node_->master_state_.al_states, std::memory_order_relaxed);
+            status_check_counter = FREQUENCY;
+        }
+
+        PhaseTrace::Mark(PhaseTrace::kQueue);
+        // Last setpoints aren't resent for a stalled or dead control thread.
+        if(stale_output_cycles <= kMaxStaleOutputCycles){
+            ecrt_domain_queue(node_->master_domain_);
+        }
+        PhaseTrace::Mark(PhaseTrace::kSync);
+        clock_gettime(CLOCK_TO_USE, &time);
+        ecrt_master_sync_reference_clock_to(node_->master_, TIMESPEC2NS(time));
+        ecrt_master_sync_slave_clocks(node_->master_);
+        PhaseTrace::Mark(PhaseTrace::kSend);
+        ecrt_master_send(node_->master_);
+    }
+    PhaseTrace::Mark(PhaseTrace::kIdle);
+}
@@ -0,0 +1,246 @@
+#include "slave_driver.hpp"
+
+namespace SlaveDriver
+{
+int ConfigureCia402Sdos(SdoParameterSet & sdos, const ProfilePosParam & P)
+{
+    // Set operation mode to ProfilePositionMode.
+    if( sdos.Sdo8(OD_OPERATION_MODE, kProfilePosition) ){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set operation mode config error ! ");
+        return  -1 ;
+    }
+    //profile velocity
+    if(sdos.Sdo32(OD_PROFILE_VELOCITY, P.profile_vel) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile velocity failed ! ");
+        return -1;
+    }
+    //max profile velocity
+    if(sdos.Sdo32(OD_MAX_PROFILE_VELOCITY,P.max_profile_vel) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set max profile velocity failed ! ");
+        return -1;
+    }
+    //profile acceleration
+    if(sdos.Sdo32(OD_PROFILE_ACCELERATION, P.profile_acc) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile acceleration failed ! ");
+        return -1;
+    }
+    //profile deceleration
+    if(sdos.Sdo32(OD_PROFILE_DECELERATION,P.profile_dec) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile deceleration failed ! ");
+        return -1;
+    }
+    // quick stop deceleration 
+    if(sdos.Sdo32(OD_QUICK_STOP_DECELERATION,P.quick_stop_dec) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
+        return -1;
+    }
+    if(sdos.Sdo16(OD_MOTION_PROFILE_TYPE,P.motion_profile_type) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
+        return -1;
+    }
+    return 0;
+}
+
+int ConfigureCia402Sdos(SdoParameterSet & sdos, const ProfileVelocityParam & P)
+{
+    // Set operation mode to ProfileVelocityMode.
+    if( sdos.Sdo8(OD_OPERATION_MODE, kProfileVelocity) ){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set operation mode config error ! ");
+        return  -1 ;
+    }
+    // motionProfileType
+    if(sdos.Sdo16(OD_MOTION_PROFILE_TYPE, P.motion_profile_type) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile velocity config error ! ");
+        return -1;
+    }
+    //max profile velocity
+    if(sdos.Sdo32(OD_MAX_PROFILE_VELOCITY,P.max_profile_vel) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set max profile  velocity config error ! ");
+        return -1;
+    }
+    //profile acceleration
+    if(sdos.Sdo32(OD_PROFILE_DECELERATION, P.profile_dec) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile deceleration failed !");
+        return -1;
+    }
+    //profile deceleration
+    if(sdos.Sdo32(OD_PROFILE_ACCELERATION,P.profile_acc) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile acceleration failed ! ");
+        return -1;
+    }
+    // quick stop deceleration 
+    if(sdos.Sdo32(OD_QUICK_STOP_DECELERATION,P.quick_stop_dec) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed ! ");
+        return -1;
+    }
+    return 0;
+}
+
+int ConfigureCia402Sdos(SdoParameterSet & sdos, const CSPositionModeParam & P)
+{
+    // Set operation mode to Cyclic Synchronous Position mode.
+    if( sdos.Sdo8(OD_OPERATION_MODE, kCSPosition) ){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set operation mode config error ! ");
+        return  -1 ;
+    }
+    // //profile velocity
+    // if(sdos.Sdo32(OD_PROFILE_VELOCITY, P.profile_vel) < 0) {
+    //     RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile velocity failed ! ");
+    //     return -1;
+    // }
+    // //max profile velocity
+    // if(sdos.Sdo32(OD_MAX_PROFILE_VELOCITY,P.max_profile_vel) < 0) {
+    //     RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set max profile velocity failed ! ");
+    //     return -1;
+    // }
+    // //profile acceleration
+    // if(sdos.Sdo32(OD_PROFILE_ACCELERATION, P.profile_acc) < 0) {
+    //     RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile acceleration failed ! ");
+    //     return -1;
+    // }
+    // //profile deceleration
+    // if(sdos.Sdo32(OD_PROFILE_DECELERATION,P.profile_dec) < 0) {
+    //     RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile deceleration failed ! ");
+    //     return -1;
+    // }
+    // quick stop deceleration 
+    if(sdos.Sdo32(OD_QUICK_STOP_DECELERATION,P.quick_stop_dec) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
+        return -1;
+    }
+    // Interpolation time period is 1ms by default.Default unit is milliseconds (ms)
+    if(sdos.Sdo8(OD_INTERPOLATION_TIME_PERIOD,P.interpolation_time_period) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
+        return -1;
+    }
+    return 0;
+}
+
+int ConfigureCia402Sdos(SdoParameterSet & sdos, const CSVelocityModeParam & P)
+{
+    // Set operation mode to Cyclic Synchronous Velocity mode.
+    if( sdos.Sdo8(OD_OPERATION_MODE, kCSVelocity) ){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set operation mode config error ! ");
+        return  -1 ;
+    }
+    // Feedforward gains of 0 keep the drive's stored values (e.g. tuned in EPOS Studio), complete access
+    // would overwrite them. So all four gains are downloaded at once only if feedforward is set.
+    const VelControlParam & gain = P.velocity_controller_gain;
+    if(gain.FFVelgain || gain.FFAccgain){
+        if(sdos.SdoComplete(OD_VELOCITY_CONTROLLER_PARAMETER_SET, gain.Pgain, gain.Igain, gain.FFVelgain, gain.FFAccgain) < 0) {
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set velocity controller parameter set failed ! ");
+            return -1;
+        }
+    }else{
+        if(sdos.Sdo32(OD_VELOCITY_CONTROLLER_PGAIN, gain.Pgain) < 0) {
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set velocity controller P gain failed ! ");
+            return -1;
+        }
+        if(sdos.Sdo32(OD_VELOCITY_CONTROLLER_IGAIN, gain.Igain) < 0) {
+            RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set velocity controller I gain failed ! ");
+            return -1;
+        }
+    }
+    //profile deceleration
+    if(sdos.Sdo32(OD_PROFILE_DECELERATION,P.profile_dec) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile deceleration failed ! ");
+        return -1;
+    }
+    // quick stop deceleration 
+    if(sdos.Sdo32(OD_QUICK_STOP_DECELERATION,P.quick_stop_dec) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
+        return -1;
+    }
+    // Interpolation time period is 1ms by default.Default unit is milliseconds (ms)
+    if(sdos.Sdo8(OD_INTERPOLATION_TIME_PERIOD,P.interpolation_time_period) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
+        return -1;
+    }
+    return 0;
+}
+
+int ConfigureCia402Sdos(SdoParameterSet & sdos, const CSTorqueModeParam & P)
+{
+    // Set operation mode to Cyclic Synchronous Torque mode.
+    if( sdos.Sdo8(OD_OPERATION_MODE, kCSTorque) ){
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set operation mode config error ! ");
+        return  -1 ;
+    }
+    // Motor data 0x3001 isn't written with complete access, it would also overwrite number of pole pairs (0x3001:03)
+    // and thermal time constant (0x3001:04), which are motor specific and not part of the torque mode parameters.
+    if(P.nominal_current && sdos.Sdo32(OD_MOTOR_DATA_NOMINAL_CURRENT, P.nominal_current) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set nominal current failed ! ");
+        return -1;
+    }
+    if(P.torque_constant && sdos.Sdo32(OD_MOTOR_DATA_TORQUE_CONSTANT, P.torque_constant) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set torque constant failed ! ");
+        return -1;
+    }
+    if(P.max_motor_speed && sdos.Sdo32(OD_MAX_MOTOR_SPEED, P.max_motor_speed) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set max motor speed failed ! ");
+        return -1;
+    }
+    // Gear configuration, all four entries in one complete access download.
+    if(P.gear.max_input_speed &&
+       sdos.SdoComplete(OD_GEAR_CONFIGURATION, P.gear.numerator, P.gear.denominator,
+                        P.gear.max_input_speed, P.gear.misc_configuration) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set gear configuration failed ! ");
+        return -1;
+    }
+    // Current control parameter set, both gains in one complete access download.
+    if(P.current_controller_p_gain && P.current_controller_i_gain &&
+       sdos.SdoComplete(OD_CURRENT_CONTROLLER_PARAMETER_SET,
+                        P.current_controller_p_gain, P.current_controller_i_gain) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set current controller parameter set failed ! ");
+        return -1;
+    }
+    //profile deceleration
+    if(sdos.Sdo32(OD_PROFILE_DECELERATION,P.profile_dec) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set profile deceleration failed ! ");
+        return -1;
+    }
+    // quick stop deceleration 
+    if(sdos.Sdo32(OD_QUICK_STOP_DECELERATION,P.quick_stop_dec) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set quick stop deceleration failed !");
+        return -1;
+    }
+    return 0;
+}
+
+int ConfigureCia402Sdos(SdoParameterSet & sdos, const HomingParam & P)
+{
+    if(sdos.Sdo8(OD_HOMING_METHOD, P.homing_method) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set homing method failed ! ");
+        return -1;
+    }
+    if(sdos.Sdo32(OD_HOMING_SPEED_SWITCH_SEARCH, P.speed_for_switch_search) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set speed for switch search failed ! ");
+        return -1;
+    }
+    if(sdos.Sdo32(OD_HOMING_SPEED_ZERO_SEARCH, P.speed_for_zero_search) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set speed for zero search failed ! ");
+        return -1;
+    }
+    if(sdos.Sdo32(OD_HOMING_ACCELERATION, P.homing_acc) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set homing acceleration failed ! ");
+        return -1;
+    }
+    if(sdos.Sdo16(OD_HOMING_CURRENT_THRESHOLD, P.curr_threshold_homing) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set homing current threshold failed ! ");
+        return -1;
+    }
+    if(sdos.Sdo32(OD_HOME_OFFSET_MOVE_DISTANCE, P.home_offset) < 0) {
+        RCLCPP_ERROR(rclcpp::get_logger(__PRETTY_FUNCTION__), "Set home offset move distance failed ! ");
+        return -1;
+    }
+    return 0;
+}
+
+// Every member function of each declared driver is compiled here, so a driver whose layout
+// can't serve one of them fails to build even if no topology in Drivers uses it.
+template class Driver<MaxonEpos4Driver, PdoLayout::MaxonEpos4>;
+template class Cia402Drive<MaxonEpos4Driver, PdoLayout::MaxonEpos4>;
+template class Driver<ElmoGoldDriver, PdoLayout::ElmoGoldSoloTwitter>;
+template class Cia402Drive<ElmoGoldDriver, PdoLayout::ElmoGoldSoloTwitter>;
+template class Driver<EasyCatDriver, PdoLayout::EasyCat>;
+}
@@ -0,0 +1,92 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  frame_mailbox.hpp
+ * \brief Lock-free single slot mailbox that always hands out the newest frame.
+ *
+ * Three preallocated frames rotate between producer and consumer : one is being
+ * written, one is being shown and one holds the newest published frame. Publish()
+ * replaces an unread frame instead of queueing it, so consumer never shows a
+ * stale frame and neither side blocks or allocates.
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+template <typename T>
+class FrameMailbox
+{
+  public:
+    /// Frames are only accessed this way to preallocate them, before producer and consumer start.
+    T & operator[](size_t index) { return frames_[index]; }
+    static constexpr size_t Size() { return kNumOfFrames; }
+    /// Producer : frame to fill next, it's never read by consumer until Publish().
+    T & WriteFrame() { return frames_[write_]; }
+    /**
+     * @brief Producer : makes WriteFrame() the newest frame.
+     * @return true if consumer had taken previous frame and has to be notified.
+     */
+    bool Publish()
+    {
+        const uint8_t previous = state_.exchange(write_ | kFresh, std::memory_order_acq_rel);
+        write_ = previous & kIndexMask;
+        if(previous & kFresh){
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+    /**
+     * @brief Consumer : takes newest frame published since last call.
+     * @return nullptr if there is none. Frame is valid until next call.
+     */
+    const T * Take()
+    {
+        if(!(state_.load(std::memory_order_relaxed) & kFresh)){
+            return nullptr;
+        }
+        read_ = state_.exchange(read_, std::memory_order_acq_rel) & kIndexMask;
+        return &frames_[read_];
+    }
+    /// Frames replaced before consumer took them.
+    uint64_t GetDropped() const { return dropped_.load(std::memory_order_relaxed); }
+  private:
+    static constexpr size_t  kNumOfFrames = 3;
+    static constexpr uint8_t kIndexMask   = 0x03;
+    static constexpr uint8_t kFresh       = 0x04;
+    T frames_[kNumOfFrames];
+    alignas(64) std::atomic<uint8_t> state_{1};   /// Index of newest frame and whether it's unread.
+    alignas(64) uint8_t write_ = 0;               /// Owned by producer.
+    alignas(64) uint8_t read_  = 2;               /// Owned by consumer.
+    std::atomic<uint64_t> dropped_{0};
+};
@@ -0,0 +1,67 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  frame_view.hpp
+ * \brief Shows camera frames by painting their QImage directly.
+ *
+ * Frames are RGB32 at their final size already, so QPainter::drawImage() copies
+ * them to the backing store without a per frame QPixmap conversion. The view
+ * only keeps a pointer to the image, the frame stays valid and unchanged until
+ * the next FrameMailbox::Take(), which is always followed by SetImage().
+ *******************************************************************************/
+#pragma once
+
+#include <QImage>
+#include <QSize>
+#include <QWidget>
+
+namespace GUI {
+
+class FrameView : public QWidget
+{
+  public:
+    /// @param frame_size Size of the frames, the view asks for at least this size.
+    explicit FrameView(const QSize & frame_size, QWidget * parent = nullptr);
+
+    /// Shows image from next paint on, it has to stay valid until next call. Call update() to redraw.
+    void SetImage(const QImage * image) { image_ = image; }
+
+    QSize sizeHint() const override { return frame_size_; }
+
+  protected:
+    void paintEvent(QPaintEvent * event) override;
+
+  private:
+    QSize frame_size_;
+    const QImage * image_ = nullptr;
+};
+
+} // namespace GUI
@@ -42,8 +42,9 @@
 // Message file headers, -custom and built-in-
 #include "sensor_msgs/msg/joy.hpp"
 #include "std_msgs/msg/u_int8.hpp"
-#include "ecat_msgs/msg/data_received.hpp"
-#include "ecat_msgs/msg/data_sent.hpp"
+#include "ecat_msgs/msg/data_received_fixed.hpp"
+#include "ecat_msgs/msg/data_received_batch.hpp"
+#include "ecat_msgs/msg/data_sent_fixed.hpp"
 
 #include <rclcpp/rclcpp.hpp>    // Standard ROS2 header API
 #include <rclcpp/strategies/message_pool_memory_strategy.hpp>   // /// Completely static memory allocation strategy for messages.
@@ -76,9 +77,15 @@ using TLSFAllocator = tlsf_heap_allocator<T>;
 #include <fstream>
 #include <string>
 #include "timing.hpp"
+#include "sample_ring.hpp"
+#include "seqlock.hpp"
+#include <atomic>
+#include <algorithm>
 using namespace std::chrono_literals;
 
 #define NUM_OF_SERVO_DRIVES 1
+static_assert(NUM_OF_SERVO_DRIVES <= ecat_msgs::msg::DataReceivedFixed::MAX_SERVO_DRIVES,
+              "Rebuild ecat_msgs with ECAT_MAX_SERVO_DRIVES >= NUM_OF_SERVO_DRIVES");
 
 #define TEST_BIT(NUM,N)    ((NUM &  (1 << N))>>N)  // Check specific bit in the data. 0 or 1.
 #define SET_BIT(NUM,N)      (NUM |  (1 << N))  // Set(1) specific bit in the data.
@@ -114,6 +121,20 @@ struct ReceivedData
     uint8_t  com_status;
 };
 
+/// Data of all drives as GUI shows it in one frame.
+struct GuiSnapshot
+{
+    ReceivedData drives[NUM_OF_SERVO_DRIVES];
+};
+
+/// Feedback of one cycle for live plots.
+struct PlotSample
+{
+    float actual_pos[NUM_OF_SERVO_DRIVES];
+    float filtered_vel[NUM_OF_SERVO_DRIVES];
+    float actual_tor[NUM_OF_SERVO_DRIVES];
+};
+
  class GuiNode : public rclcpp::Node
   {
      //Q_OBJECT
@@ -121,15 +142,30 @@ struct ReceivedData
       GuiNode();
       virtual ~GuiNode();
   public:
-      // Received data structure to store all subscribed data.
-      ReceivedData received_data_[NUM_OF_SERVO_DRIVES] = {};
-      // GUI button value to publish emergency button state.
-      uint8_t emergency_button_val_ = 1;
+      /**
+       * @brief GUI thread : copies data of last subscription callback, never blocks.
+       * @return false if callback was publishing it, snapshot keeps its previous values then.
+       */
+      bool ReadSnapshot(GuiSnapshot & snapshot) const;
+      /// GUI thread : clears received values in spin thread's next timer callback.
+      void RequestReset() { reset_requested_ = true; }
+      // GUI button value to publish emergency button state, written by GUI thread only.
+      std::atomic<uint8_t> emergency_button_val_{1};
+      /// Every feedback sample, filled by subscription thread and drained by GUI thread.
+      SampleRing<PlotSample, 8192> plot_samples_;
       Timing time_info_;
   private:  
+      // Received data structure to store all subscribed data, only accessed by spin thread.
+      ReceivedData received_data_[NUM_OF_SERVO_DRIVES] = {};
+      /// received_data_ as of last callback, GUI reads it from here.
+      Seqlock<GuiSnapshot> snapshot_;
+      std::atomic<bool> reset_requested_{false};
+      /// Publishes received_data_ to GUI, called at the end of each callback that changes it.
+      void PublishSnapshot();
       // ROS2 subscriptions.
-      rclcpp::Subscription<ecat_msgs::msg::DataReceived>::SharedPtr slave_feedback_;
-      rclcpp::Subscription<ecat_msgs::msg::DataSent>::SharedPtr master_commands_;
+      /// GUI only needs the latest sample, batched feedback is used to reduce message rate.
+      rclcpp::Subscription<ecat_msgs::msg::DataReceivedBatch>::SharedPtr slave_feedback_;
+      rclcpp::Subscription<ecat_msgs::msg::DataSentFixed>::SharedPtr master_commands_;
       rclcpp::Subscription<sensor_msgs::msg::Joy>::SharedPtr  controller_commands_;
       rclcpp::TimerBase::SharedPtr timer_;
       rclcpp::Publisher<std_msgs::msg::UInt8>::SharedPtr gui_publisher_;
@@ -150,14 +186,14 @@ struct ReceivedData
          *
          * @param msg Master commands structure published by EthercatLifecycle node
          */
-        void HandleMasterCommandCallbacks(const ecat_msgs::msg::DataSent::SharedPtr msg);
+        void HandleMasterCommandCallbacks(const ecat_msgs::msg::DataSentFixed::SharedPtr msg);
         /**
          * @brief Function will be used for subscribtion callbacks from EthercatLifecycle node
          *        for Master_Commands topic.
          *
          * @param msg Slave feedback structure published by EthercatLifecycle node
          */
-        void HandleSlaveFeedbackCallbacks(const ecat_msgs::msg::DataReceived::SharedPtr msg);
+        void HandleSlaveFeedbackCallbacks(const ecat_msgs::msg::DataReceivedBatch::SharedPtr batch);
   };// class GuiNode
 
  } // namespace GUI
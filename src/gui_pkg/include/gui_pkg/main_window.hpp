@@ -47,6 +47,9 @@
 //GUI_Node Headers
 #include "gui_node.hpp"
 #include "video_capture.hpp"
+#include "render_model.hpp"
+#include "plot_widget.hpp"
+#include "frame_view.hpp"
 
 // QT
 #include "ui_main_window.h"
@@ -55,6 +58,7 @@
 #include <QStandardItemModel>
 #include <QTableView>
 #include <QHeaderView>
+#include <QHBoxLayout>
 #include <QString>
 #include <QTextStream>
 #include <QTimer>
@@ -112,11 +116,14 @@ class MainWindow;
      */
     void ShowEmergencyStatus();
     /**
-     * @brief Reads status word and turns it to readable string format.
+     * @brief Shows status word of a motor in readable format.
      * @param index slave index
-     * @return QString readable status word format.
      */
-    QString GetReadableStatusWord(int index);
+    void ShowStatusWord(int index);
+    /// Logs GUI thread CPU time per frame once every kFramesPerSummary frames.
+    void ReportFrameStats();
+    /// Moves feedback samples received since last frame into plots.
+    void UpdatePlots();
 
     Ui::MainWindow *ui;
     int argc_;
@@ -128,7 +135,28 @@ class MainWindow;
     QTimer my_timer;
     // To get data from gui_node_ .
     std::shared_ptr<GuiNode> gui_node_;
+    /// Data rendered in current frame, read from gui_node_ at the beginning of each frame.
+    GuiSnapshot snapshot_ = {};
     VideoCapture* opencv_video_cap;
     // Thread for ROS2 spinning.
     std::thread ros_spin_thread_;
+    /// Motors that have labels in main_window.ui.
+    static const int kNumOfMotorViews = 3;
+    /// 40 frames per second, frame statistics are logged every 10 seconds.
+    static const uint32_t kFramesPerSummary = 400;
+    /// Last rendered state of each label, widgets are only updated when it changes.
+    FrameStats frame_stats_;
+    LabelView emergency_switch_view_;
+    LabelView com_status_view_;
+    LabelView target_view_[kNumOfMotorViews];
+    LabelView control_word_view_[kNumOfMotorViews];
+    LabelView actual_view_[kNumOfMotorViews];
+    LabelView status_word_view_[kNumOfMotorViews];
+    /// Live traces of all drives, 10 s at 1 kHz feedback rate. Owned by Qt parent.
+    static const int kPlotWindowSamples = 10000;
+    PlotWidget * position_plot_;
+    PlotWidget * velocity_plot_;
+    PlotWidget * torque_plot_;
+    /// Camera frames, owned by Qt parent.
+    FrameView * frame_view_;
   };
@@ -0,0 +1,95 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  plot_widget.hpp
+ * \brief Live plot of high-rate traces with per-pixel min/max decimation.
+ *
+ * Samples are folded into columns as they're appended, each column keeps min
+ * and max of samples_per_column consecutive samples of each trace, one column
+ * per pixel of widget width. So appending is O(traces) per sample and drawing
+ * is O(width) per trace whatever the sample rate is, each trace is drawn as a
+ * single polyline that goes through min and max of every column. Spikes
+ * shorter than a pixel stay visible, unlike with plain subsampling.
+ *
+ * Y axis is scaled to the range of the visible columns.
+ *******************************************************************************/
+#pragma once
+
+#include <vector>
+
+#include <QColor>
+#include <QPointF>
+#include <QString>
+#include <QWidget>
+
+namespace GUI {
+
+class PlotWidget : public QWidget
+{
+  public:
+    /**
+     * @param title          Shown in top left corner.
+     * @param num_of_traces  Values passed to each Append() call.
+     * @param window_samples Samples visible at once, e.g. 10000 for 10 s at 1 kHz.
+     */
+    PlotWidget(const QString & title, int num_of_traces, int window_samples, QWidget * parent = nullptr);
+
+    /// Appends one sample, values[i] belongs to trace i. Call update() to redraw.
+    void Append(const float * values);
+
+  protected:
+    void paintEvent(QPaintEvent * event) override;
+    /// Columns follow widget width, plot restarts from empty after resizing.
+    void resizeEvent(QResizeEvent * event) override;
+
+  private:
+    void Reset(int num_of_columns);
+    float & Min(int trace, int column) { return min_[trace * num_of_columns_ + column]; }
+    float & Max(int trace, int column) { return max_[trace * num_of_columns_ + column]; }
+
+    QString title_;
+    int num_of_traces_;
+    int window_samples_;
+    int num_of_columns_ = 0;
+    int samples_per_column_ = 1;
+    /// Column being filled and samples already in it.
+    int head_ = 0;
+    int head_fill_ = 0;
+    /// Complete columns before head_.
+    int num_of_full_columns_ = 0;
+    /// Trace major, num_of_traces_ x num_of_columns_.
+    std::vector<float> min_;
+    std::vector<float> max_;
+    /// Reused for drawing, two points per column.
+    std::vector<QPointF> points_;
+};
+
+} // namespace GUI
@@ -0,0 +1,124 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  render_model.hpp
+ * \brief Cached view state of GUI labels, widgets are only touched when the
+ *        value they show changes.
+ *
+ * MainWindow refreshes every 25 ms, but most values stay the same between
+ * frames. setText() relayouts and setStyleSheet() re-polishes the widget even
+ * if nothing changed, so each LabelView keeps the number, text and style it
+ * last rendered and skips the widget call when they're equal. Numbers are
+ * compared before they're formatted, an unchanged frame doesn't build any
+ * QString.
+ *
+ * FrameStats counts GUI thread CPU time (CLOCK_THREAD_CPUTIME_ID) and widget
+ * updates per frame.
+ *******************************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+#include <QLabel>
+#include <QString>
+
+namespace GUI {
+
+/// Looks of status labels, each one is a fixed style sheet.
+enum class LabelStyle : int8_t
+{
+    kNone = -1,
+    kWhiteOnGreen,
+    kWhiteOnYellow,
+    kWhiteOnRed,
+    kBlackOnGreen,
+    kBlackOnYellow,
+    kBlackOnRed,
+};
+
+/// CPU time and widget updates of GUI frames.
+class FrameStats
+{
+  public:
+    /// Summary of frames since last TakeSummary().
+    struct Summary
+    {
+        uint32_t frames;
+        int64_t  mean_cpu_ns;
+        int64_t  max_cpu_ns;
+        double   updates_per_frame;
+        /// Frames that showed previous frame's data because it was being written.
+        uint32_t stale_snapshots;
+    };
+    void BeginFrame();
+    void EndFrame();
+    void CountUpdate() { updates_++; }
+    void CountStaleSnapshot() { stale_snapshots_++; }
+    /**
+     * @brief Takes summary and starts a new one once every frames_per_summary frames.
+     * @return true if summary is filled.
+     */
+    bool TakeSummary(uint32_t frames_per_summary, Summary & summary);
+  private:
+    static int64_t ThreadCpuNs();
+    int64_t  frame_start_ns_ = 0;
+    int64_t  total_ns_ = 0;
+    int64_t  max_ns_ = 0;
+    uint32_t frames_ = 0;
+    uint64_t updates_ = 0;
+    uint32_t stale_snapshots_ = 0;
+};
+
+/// Last rendered state of one label.
+class LabelView
+{
+  public:
+    /// @param stats Counts widget calls, can be NULL.
+    void Attach(QLabel * label, FrameStats * stats);
+    /// Shows integer value, label text is only formatted and set when it differs from last one.
+    void SetNumber(int64_t value);
+    /// Shows static text, pointer is kept so text has to outlive the view (string literals).
+    void SetText(const char * text);
+    void SetStyle(LabelStyle style);
+    /// Forgets cached state, next Set*() call updates the label.
+    void Invalidate();
+  private:
+    void Updated() { if(stats_) stats_->CountUpdate(); }
+    QLabel * label_ = nullptr;
+    FrameStats * stats_ = nullptr;
+    int64_t number_ = 0;
+    bool has_number_ = false;
+    const char * text_ = nullptr;
+    LabelStyle style_ = LabelStyle::kNone;
+};
+
+} // namespace GUI
@@ -0,0 +1,80 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  sample_ring.hpp
+ * \brief Lock-free single producer single consumer ring of fixed-size samples.
+ *
+ * Used to hand feedback samples from GuiNode's subscription thread to the Qt
+ * thread. Neither side blocks, if the consumer falls behind new samples are
+ * dropped and counted.
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+template <typename T, size_t Capacity>
+class SampleRing
+{
+    static_assert(Capacity && !(Capacity & (Capacity - 1)), "Capacity has to be a power of two.");
+  public:
+    /// Producer : @return false if ring is full and sample is dropped.
+    bool Push(const T & sample)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if(head - tail_.load(std::memory_order_acquire) == Capacity){
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        buffer_[head & (Capacity - 1)] = sample;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    /// Consumer : @return false if ring is empty.
+    bool Pop(T & sample)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if(tail == head_.load(std::memory_order_acquire)){
+            return false;
+        }
+        sample = buffer_[tail & (Capacity - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    /// Samples dropped because ring was full.
+    uint64_t GetDropped() const { return dropped_.load(std::memory_order_relaxed); }
+  private:
+    alignas(64) std::atomic<size_t> head_{0};   /// Written by producer.
+    alignas(64) std::atomic<size_t> tail_{0};   /// Written by consumer.
+    std::atomic<uint64_t> dropped_{0};
+    T buffer_[Capacity];
+};
@@ -0,0 +1,94 @@
+/******************************************************************************
+ *
+ *  $Id$
+ *
+ *  Copyright (C) 2021 Veysi ADIN, UST KIST
+ *
+ *  This file is part of the IgH EtherCAT master userspace program in the ROS2 environment.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU General
+ *  Public License as published by the Free Software Foundation; version 2
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace program in the ROS2 environment is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with the IgH EtherCAT master userspace program in the ROS environment. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ *  ---
+ *
+ *  The license mentioned above concerns the source code only. Using the
+ *  EtherCAT technology and brand is only permitted in compliance with the
+ *  industrial property and similar rights of Beckhoff Automation GmbH.
+ *
+ *  Contact information: veysi.adin@kist.re.kr
+ *****************************************************************************/
+/*****************************************************************************
+ * \file  seqlock.hpp
+ * \brief Sequence lock that publishes a plain data value from one writer
+ *        thread to reader threads without blocking either side.
+ *
+ * Writer makes the sequence number odd, writes the value and makes it even
+ * again. Reader copies the value and accepts the copy if sequence number was
+ * even and didn't change meanwhile. Reads are wait-free : TryLoad() makes a
+ * single attempt, caller keeps its previous copy if writer was in between.
+ * Value is stored as relaxed atomic words, so concurrent copies aren't data
+ * races.
+ *******************************************************************************/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+template <typename T>
+class Seqlock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock copies values byte by byte.");
+  public:
+    /// Writer : publishes value, only one thread may write.
+    void Store(const T & value)
+    {
+        uint64_t words[kNumOfWords] = {};
+        memcpy(words, &value, sizeof(T));
+        const uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for(size_t i = 0 ; i < kNumOfWords ; i++){
+            words_[i].store(words[i], std::memory_order_relaxed);
+        }
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+    /**
+     * @brief Reader : copies latest value if it isn't being written.
+     * @return false if writer was updating it, value is left unchanged then.
+     */
+    bool TryLoad(T & value) const
+    {
+        const uint32_t before = sequence_.load(std::memory_order_acquire);
+        if(before & 1){
+            return false;
+        }
+        uint64_t words[kNumOfWords];
+        for(size_t i = 0 ; i < kNumOfWords ; i++){
+            words[i] = words_[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(sequence_.load(std::memory_order_relaxed) != before){
+            return false;
+        }
+        memcpy(&value, words, sizeof(T));
+        return true;
+    }
+  private:
+    static const size_t kNumOfWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    std::atomic<uint32_t> sequence_{0};
+    std::atomic<uint64_t> words_[kNumOfWords] = {};
+};
@@ -36,7 +36,6 @@
 #define VIDEO_CAPTURE_HPP
 
 // QT headers for image and reading thread.
-#include <QPixmap>
 #include <QImage>
 #include <QThread>
 // OpenCV headers for camera capture.
@@ -45,6 +44,12 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/core/core.hpp>
 
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "frame_mailbox.hpp"
+
 /**
  * Camera ID will be your camera's device ID.
  * If you don't have any camera attached to usb default ID will be 0.
@@ -57,27 +62,99 @@
 
 #define ID_CAMERA 0
 
+/// Frame ready to be shown, RGB32 at VideoCapture::kOutputWidth x kOutputHeight.
+struct VideoFrame
+{
+    /// Shown by GUI thread, capture thread never touches this object, only its pixels.
+    QImage   image;
+    /// Header over image's pixels, capture thread converts and scales into it directly.
+    cv::Mat  pixels;
+    /// Steady clock time the frame was read from camera or file.
+    int64_t  capture_ns = 0;
+    uint64_t sequence = 0;
+};
+
+/// Camera pipeline statistics since last summary.
+struct VideoStats
+{
+    uint32_t shown;
+    uint64_t captured;
+    /// Frames replaced by a newer one before GUI showed them.
+    uint64_t dropped;
+    double   shown_fps;
+    double   capture_fps;
+    /// Time from reading frame until it's shown.
+    int64_t  mean_latency_ns;
+    int64_t  max_latency_ns;
+    /// Capture thread time for color conversion and scaling.
+    int64_t  mean_convert_ns;
+};
+
+/**
+ * Reads frames in its own thread, converts them from BGR to RGB32 and scales them
+ * to output size there, then publishes them into a FrameMailbox. GUI takes the
+ * newest frame when NewFrameCaptured() arrives, all frame buffers are allocated
+ * once in constructor.
+ */
 class VideoCapture : public QThread
 {
     Q_OBJECT
 public:
+    /// Opens camera ID_CAMERA.
     VideoCapture(QObject *parent = nullptr);
-    QPixmap pixmap() const { return pixmap_cap;}
+    /// Opens a video file, it's played at its own frame rate instead of a camera.
+    VideoCapture(const std::string & file, QObject *parent = nullptr);
+    ~VideoCapture() override;
+    /**
+     * @brief GUI thread : takes newest frame captured since last call.
+     * @return nullptr if there is no new frame. Frame is valid until next call.
+     */
+    const VideoFrame * TakeFrame() { return mailbox_.Take(); }
+    /// GUI thread : records latency of a frame after it's shown, logs a summary every kFramesPerSummary frames.
+    void FrameShown(const VideoFrame & frame);
+    /**
+     * @brief Plays a video file through the pipeline without GUI and logs its statistics.
+     * Needs a QCoreApplication, returns after the last frame of the file.
+     */
+    static int RunBenchmark(const std::string & file);
+
+    static const int kOutputWidth  = 1100;
+    static const int kOutputHeight = 720;
 signals:
-    //capture a frame
-    void NewPixmapCapture();
+    /// Emitted when a frame is published and the previous one was already taken.
+    void NewFrameCaptured();
 protected:
     void run() override;
 private:
-
-    QPixmap pixmap_cap;              //Qt image
     cv::Mat frame_cap;               //OpenCV image
     cv::VideoCapture video_cap;   //video capture
+    bool from_file_ = false;
 
     unsigned long frame_rate = 30;
-    // Convert opencv readings to QImage && QPixmap format
-    QImage cvMatToQImage(const cv::Mat &inMat);
-    QPixmap cvMatToQPixmap(const cv::Mat &inMat );
+    FrameMailbox<VideoFrame> mailbox_;
+    /// Intermediate images of conversion, allocated on first frame and reused.
+    cv::Mat converted_;
+    cv::Mat scaled_;
+
+    static const uint32_t kFramesPerSummary = 300;
+    // Written by capture thread.
+    std::atomic<uint64_t> captured_{0};
+    std::atomic<int64_t>  convert_ns_{0};
+    // Owned by GUI thread, shown, max_latency_ns are accumulated until next summary.
+    VideoStats stats_ = {};
+    int64_t  summary_start_ns_ = 0;
+    int64_t  latency_sum_ns_ = 0;
+    uint64_t last_captured_ = 0;
+    uint64_t last_dropped_ = 0;
+    int64_t  last_convert_ns_ = 0;
+
+    /// Allocates output frames.
+    void AllocateFrames();
+    /// Converts inMat to RGB32 at output size directly into frame's pixels, false if its type isn't handled.
+    bool ConvertFrame(const cv::Mat &inMat, VideoFrame & frame);
+    /// Logs statistics since last summary and starts a new one.
+    void LogSummary(int64_t now);
+    static int64_t NowNs();
 };
 
 #endif // MYVIDEOCAPTURE_H
@@ -0,0 +1,32 @@
+#include "../include/gui_pkg/frame_view.hpp"
+
+#include <QPainter>
+#include <QRegion>
+
+using namespace GUI;
+
+FrameView::FrameView(const QSize & frame_size, QWidget * parent)
+: QWidget(parent),
+  frame_size_(frame_size)
+{
+    setMinimumSize(frame_size_);
+    setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::MinimumExpanding);
+    // Whole widget is painted in paintEvent(), Qt doesn't have to clear it first.
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void FrameView::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    if(!image_){
+        painter.fillRect(rect(), Qt::black);
+        return;
+    }
+    // Frame is drawn unscaled in the center, only the border around it is cleared.
+    const QRect target(QPoint((width() - image_->width()) / 2, (height() - image_->height()) / 2), image_->size());
+    const QRegion border = QRegion(rect()).subtracted(target);
+    for(const QRect & r : border){
+        painter.fillRect(r, Qt::black);
+    }
+    painter.drawImage(target.topLeft(), *image_);
+}
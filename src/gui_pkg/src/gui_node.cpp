@@ -17,14 +17,15 @@
   qos.best_effort();
       controller_commands_= this->create_subscription<sensor_msgs::msg::Joy>("Controller", qos,
                                           std::bind(&GuiNode::HandleControllerCallbacks, this, std::placeholders::_1));
-      slave_feedback_ = this->create_subscription<ecat_msgs::msg::DataReceived>("Slave_Feedback", qos,
+      slave_feedback_ = this->create_subscription<ecat_msgs::msg::DataReceivedBatch>("Slave_Feedback_Batch", qos,
                                            std::bind(&GuiNode::HandleSlaveFeedbackCallbacks, this, std::placeholders::_1));
-      master_commands_ = this->create_subscription<ecat_msgs::msg::DataSent>("Master_Commands", qos,
+      master_commands_ = this->create_subscription<ecat_msgs::msg::DataSentFixed>("Master_Commands", qos,
                                            std::bind(&GuiNode::HandleMasterCommandCallbacks, this, std::placeholders::_1));
 
      gui_publisher_ = create_publisher<std_msgs::msg::UInt8>("gui_buttons", qos);
      timer_ = this->create_wall_timer(1ms,std::bind(&GuiNode::timer_callback,this));
      received_data_[0].p_emergency_switch_val=1;
+     PublishSnapshot();
 
   }
 
@@ -38,6 +39,33 @@
       auto button_info = std_msgs::msg::UInt8();
       button_info.data = emergency_button_val_;
       gui_publisher_->publish(button_info);
+      if(reset_requested_.exchange(false)){
+        for (int i = 0 ; i < NUM_OF_SERVO_DRIVES ; i++ ){
+          received_data_[i].status_word = 0 ;
+          received_data_[i].actual_pos = 0 ;
+          received_data_[i].actual_vel = 0 ;
+          received_data_[i].control_word = 0 ;
+          received_data_[i].target_pos  = 0 ;
+          received_data_[i].target_vel = 0 ;
+        }
+        received_data_[0].left_limit_switch_val = 0 ;
+        received_data_[0].right_limit_switch_val = 0;
+        received_data_[0].right_x_axis = 0 ;
+        received_data_[0].left_x_axis = 0 ;
+        PublishSnapshot();
+      }
+  }
+
+  void GuiNode::PublishSnapshot()
+  {
+      GuiSnapshot snapshot;
+      std::copy(received_data_, received_data_ + NUM_OF_SERVO_DRIVES, snapshot.drives);
+      snapshot_.Store(snapshot);
+  }
+
+  bool GuiNode::ReadSnapshot(GuiSnapshot & snapshot) const
+  {
+      return snapshot_.TryLoad(snapshot);
   }
   void GuiNode::HandleControllerCallbacks(const sensor_msgs::msg::Joy::SharedPtr msg)
   {
@@ -45,24 +73,41 @@
         received_data_[i].right_x_axis = msg->axes[3];
         received_data_[i].left_x_axis =  msg->axes[0];
      }
+     PublishSnapshot();
     // emit UpdateParameters(0);
   }
 
-  void GuiNode::HandleMasterCommandCallbacks(const ecat_msgs::msg::DataSent::SharedPtr msg)
+  void GuiNode::HandleMasterCommandCallbacks(const ecat_msgs::msg::DataSentFixed::SharedPtr msg)
   {
       
-      for(int i=0; i < NUM_OF_SERVO_DRIVES ; i++){
+      for(int i=0; i < NUM_OF_SERVO_DRIVES && i < msg->num_of_drives ; i++){
          received_data_[i].target_pos   =  msg->target_pos[i];
          received_data_[i].target_vel   =  msg->target_vel[i];
          received_data_[i].control_word =  msg->control_word[i];
       }
+      PublishSnapshot();
      // emit UpdateParameters(0);
   }
 
-  void GuiNode::HandleSlaveFeedbackCallbacks(const ecat_msgs::msg::DataReceived::SharedPtr msg)
+  void GuiNode::HandleSlaveFeedbackCallbacks(const ecat_msgs::msg::DataReceivedBatch::SharedPtr batch)
   {
 //      time_info_.GetTime();
-      for(int i=0; i < NUM_OF_SERVO_DRIVES ; i++){
+      if(!batch->num_of_samples || batch->num_of_samples > batch->samples.size())
+        return;
+      // Plots get every sample of the batch.
+      for(uint16_t s = 0 ; s < batch->num_of_samples ; s++){
+        const ecat_msgs::msg::DataReceivedFixed & sample = batch->samples[s];
+        PlotSample plot_sample = {};
+        for(int i=0; i < NUM_OF_SERVO_DRIVES && i < sample.num_of_drives ; i++){
+          plot_sample.actual_pos[i]   = sample.actual_pos[i];
+          plot_sample.filtered_vel[i] = sample.filtered_vel[i];
+          plot_sample.actual_tor[i]   = sample.actual_tor[i];
+        }
+        plot_samples_.Push(plot_sample);
+      }
+      // Only the most recent sample of the batch is shown.
+      const ecat_msgs::msg::DataReceivedFixed * msg = &batch->samples[batch->num_of_samples - 1];
+      for(int i=0; i < NUM_OF_SERVO_DRIVES && i < msg->num_of_drives ; i++){
         received_data_[i].actual_pos             =  msg->actual_pos[i];
         received_data_[i].actual_vel             =  msg->actual_vel[i];
         received_data_[i].status_word            =  msg->status_word[i];
@@ -71,6 +116,7 @@
         received_data_[i].p_emergency_switch_val =  msg->emergency_switch_val;
         received_data_[i].com_status             =  msg->com_status;
     }
+    PublishSnapshot();
 //    time_info_.MeasureTimeDifference();
 //    if (time_info_.counter_ == NUMBER_OF_SAMPLES)
 //      time_info_.OutInfoToFile();
@@ -1,10 +1,17 @@
 #include <QApplication>
+#include <QCoreApplication>
+#include <string>
 #include "../include/gui_pkg/main_window.hpp"
 #include "rclcpp/rclcpp.hpp"
 
 
 int main(int argc, char **argv) {
 
+    // Camera pipeline benchmark without GUI : gui_node --video-benchmark <video file>
+    if(argc == 3 && std::string(argv[1]) == "--video-benchmark"){
+        QCoreApplication app(argc, argv);
+        return VideoCapture::RunBenchmark(argv[2]);
+    }
     QApplication app(argc, argv);
     MainWindow w(argc,argv);
     w.setWindowTitle("Spine Robot GUI");
@@ -8,300 +8,185 @@ MainWindow::MainWindow(int argc, char** argv, QWidget *parent)
   argv_(argv)
 {
     ui->setupUi(this);
+    // Node exists before GUI timer starts, spin thread only spins it.
+    rclcpp::init(argc_, argv_);
+    gui_node_ = std::make_shared<GuiNode>();
+    emergency_switch_view_.Attach(ui->line_emergency_switch, &frame_stats_);
+    com_status_view_.Attach(ui->line_com_status, &frame_stats_);
+    QLabel * const target_labels[kNumOfMotorViews]       = {ui->line_target_velocity_m1, ui->line_target_velocity_m2, ui->line_target_velocity_m3};
+    QLabel * const control_word_labels[kNumOfMotorViews] = {ui->line_control_word_m1, ui->line_control_word_m2, ui->line_control_word_m3};
+    QLabel * const actual_labels[kNumOfMotorViews]       = {ui->line_actual_velocity_m1, ui->line_actual_velocity_m2, ui->line_actual_velocity_m3};
+    QLabel * const status_word_labels[kNumOfMotorViews]  = {ui->line_status_word_m1, ui->line_status_word_m2, ui->line_status_word_m3};
+    for(int i = 0 ; i < kNumOfMotorViews ; i++){
+        target_view_[i].Attach(target_labels[i], &frame_stats_);
+        control_word_view_[i].Attach(control_word_labels[i], &frame_stats_);
+        actual_view_[i].Attach(actual_labels[i], &frame_stats_);
+        status_word_view_[i].Attach(status_word_labels[i], &frame_stats_);
+    }
+    position_plot_ = new PlotWidget("Position [inc]", NUM_OF_SERVO_DRIVES, kPlotWindowSamples, this);
+    velocity_plot_ = new PlotWidget("Velocity [rpm]", NUM_OF_SERVO_DRIVES, kPlotWindowSamples, this);
+    torque_plot_   = new PlotWidget("Torque [per mille]", NUM_OF_SERVO_DRIVES, kPlotWindowSamples, this);
+    QHBoxLayout * plot_layout = new QHBoxLayout();
+    plot_layout->addWidget(position_plot_);
+    plot_layout->addWidget(velocity_plot_);
+    plot_layout->addWidget(torque_plot_);
+    ui->gridLayout->addLayout(plot_layout, 1, 0, 1, 2);
     // Activating ROS2 spinning functionality for subscribtion callbacks.
     ros_spin_thread_ = std::thread{std::bind(&MainWindow::rosSpinThread, this)};
     this->my_timer.setInterval(25);  // Update rate 25 ms for GUI.
     this->my_timer.start();
     connect(&my_timer, SIGNAL(timeout()), this, SLOT(UpdateGUI()));
 
+    frame_view_ = new FrameView(QSize(VideoCapture::kOutputWidth, VideoCapture::kOutputHeight), this);
+    ui->horizontalLayout_4->addWidget(frame_view_);
     opencv_video_cap =  new VideoCapture(this);
-    connect(opencv_video_cap, &VideoCapture::NewPixmapCapture, this, [&]()
+    connect(opencv_video_cap, &VideoCapture::NewFrameCaptured, this, [this]()
     {
-       ui->image_frame->setPixmap(opencv_video_cap->pixmap().scaled(1100,720));
+       // Frame is already RGB32 and scaled in capture thread, only the newest one is shown.
+       // View paints it until the next frame is taken, capture thread doesn't write it meanwhile.
+       if(const VideoFrame * frame = opencv_video_cap->TakeFrame()){
+          frame_view_->SetImage(&frame->image);
+          frame_view_->update();
+          opencv_video_cap->FrameShown(*frame);
+       }
     });
     opencv_video_cap->start(QThread::HighestPriority);
 }
 
 MainWindow::~MainWindow()
 {
+  // Capture thread stops after its current read, it's deleted with its parent.
+  opencv_video_cap->requestInterruption();
+  opencv_video_cap->wait();
   rclcpp::shutdown();
   delete ui;
-  opencv_video_cap->terminate();
 }
 
 // Start ROS2 NODE
 void MainWindow::rosSpinThread()
 {
-    rclcpp::init(argc_, argv_);
-    gui_node_ = std::make_shared<GuiNode>();
     rclcpp::spin(gui_node_);
     rclcpp::shutdown();
 }
 
 void MainWindow::UpdateGUI()
 {
+    frame_stats_.BeginFrame();
+    // One consistent view per frame, previous frame's view is kept if a callback was writing it.
+    if(!gui_node_->ReadSnapshot(snapshot_)){
+        frame_stats_.CountStaleSnapshot();
+    }
     // Updating Additional GUI Part Veysi ADN
     ShowEmergencyStatus();
     ShowComStatus();
     ShowAllMotorStatus();
+    UpdatePlots();
+    frame_stats_.EndFrame();
+    ReportFrameStats();
+}
+
+void MainWindow::ReportFrameStats()
+{
+    FrameStats::Summary summary;
+    if(frame_stats_.TakeSummary(kFramesPerSummary, summary)){
+        RCLCPP_INFO(rclcpp::get_logger("gui_node"), "GUI frame CPU time mean : %.1f us | max : %.1f us | widget updates per frame : %.2f",
+                    summary.mean_cpu_ns / 1e3, summary.max_cpu_ns / 1e3, summary.updates_per_frame);
+        RCLCPP_INFO(rclcpp::get_logger("gui_node"), "Stale snapshots : %u | plot samples dropped : %llu",
+                    summary.stale_snapshots, (unsigned long long)gui_node_->plot_samples_.GetDropped());
+    }
+}
 
+void MainWindow::UpdatePlots()
+{
+    PlotSample sample;
+    bool received = false;
+    while(gui_node_->plot_samples_.Pop(sample)){
+        position_plot_->Append(sample.actual_pos);
+        velocity_plot_->Append(sample.filtered_vel);
+        torque_plot_->Append(sample.actual_tor);
+        received = true;
+    }
+    // Repaint is scheduled once per frame, not per sample.
+    if(received){
+        position_plot_->update();
+        velocity_plot_->update();
+        torque_plot_->update();
+    }
 }
 
 void MainWindow::ShowEmergencyStatus()
 {
-    QString qstr;
-    if(!gui_node_->received_data_[0].p_emergency_switch_val){
-          setDisabledStyleSheet();
+    if(!snapshot_.drives[0].p_emergency_switch_val){
+          // Button style is only changed once, not on every frame the switch stays pressed.
+          if(ui->button_emergency->isEnabled()){
+              setDisabledStyleSheet();
+          }
           gui_node_->emergency_button_val_ = 0;
     }
 
-    if(gui_node_->received_data_[0].p_emergency_switch_val && gui_node_->emergency_button_val_ ){
-          QTextStream(&qstr) << "IDLE";
-          ui->line_emergency_switch->setText(qstr);
-          ui->line_emergency_switch->setStyleSheet("QLabel{background:green;"
-                                                   "color:white;"
-                                                   "font:bold 75 12pt \"Noto Sans\";}");
-          qstr.clear();
+    if(snapshot_.drives[0].p_emergency_switch_val && gui_node_->emergency_button_val_ ){
+          emergency_switch_view_.SetText("IDLE");
+          emergency_switch_view_.SetStyle(LabelStyle::kWhiteOnGreen);
     }else{
-          QTextStream(&qstr) << "EMERGENCY MODE";
-          ui->line_emergency_switch->setText(qstr);
-          ui->line_emergency_switch->setStyleSheet("QLabel{background:red;"
-                                                   "color:white;"
-                                                   "font:bold 75 12pt \"Noto Sans\";}");
-          qstr.clear();
+          emergency_switch_view_.SetText("EMERGENCY MODE");
+          emergency_switch_view_.SetStyle(LabelStyle::kWhiteOnRed);
     }
 }
 
 void MainWindow::ShowComStatus()
 {
-    QString qstr;
-    int state = gui_node_->received_data_[0].com_status;
+    int state = snapshot_.drives[0].com_status;
     if(state == 0x08){
-
-         QTextStream(&qstr) << "OPERATIONAL";
-         ui->line_com_status->setText(qstr);
-         ui->line_com_status->setStyleSheet("QLabel{background:green;"
-                                            "color:white;"
-                                            "font:bold 75 12pt \"Noto Sans\";}");
-         qstr.clear();
+        com_status_view_.SetText("OPERATIONAL");
+        com_status_view_.SetStyle(LabelStyle::kWhiteOnGreen);
     }
     else if (state == 0x04){
-        QTextStream(&qstr) << "SAFE OPERATIONAL";
-        ui->line_com_status->setText(qstr);
-        ui->line_com_status->setStyleSheet("QLabel{background:yellow;"
-                                           "color:white;"
-                                           "font:bold 75 12pt \"Noto Sans\";}");
-        qstr.clear();
-
+        com_status_view_.SetText("SAFE OPERATIONAL");
+        com_status_view_.SetStyle(LabelStyle::kWhiteOnYellow);
     }
     else if (state == 0x02){
-            QTextStream(&qstr) << "PRE OPERATIONAL";
-            ui->line_com_status->setText(qstr);
-            ui->line_com_status->setStyleSheet("QLabel{background:yello;"
-                                               "color:white;"
-                                               "font:bold 75 12pt \"Noto Sans\";}");
-            qstr.clear();
-
-        }
+        com_status_view_.SetText("PRE OPERATIONAL");
+        com_status_view_.SetStyle(LabelStyle::kWhiteOnYellow);
+    }
     else if (state == 0x01){
-            QTextStream(&qstr) << "INIT";
-            ui->line_com_status->setText(qstr);
-            ui->line_com_status->setStyleSheet("QLabel{background:red;"
-                                               "color:white;"
-                                               "font:bold 75 12pt \"Noto Sans\";}");
-            qstr.clear();
-
+        com_status_view_.SetText("INIT");
+        com_status_view_.SetStyle(LabelStyle::kWhiteOnRed);
     }
     else {
-        QTextStream(&qstr) << "NO CONNECTION";
-        ui->line_com_status->setText(qstr);
-        ui->line_com_status->setStyleSheet("QLabel{background:red;"
-                                           "color:white;"
-                                           "font:bold 75 12pt \"Noto Sans\";}");
-        qstr.clear();
-
+        com_status_view_.SetText("NO CONNECTION");
+        com_status_view_.SetStyle(LabelStyle::kWhiteOnRed);
     }
-
 }
 
 void MainWindow::ShowAllMotorStatus()
 {
-    QString  qstr;
-    for(int i = 0; i < NUM_OF_SERVO_DRIVES ;i++){
-        switch (i) {
-        case 0:
-            QTextStream(&qstr) << gui_node_->received_data_[i].target_pos;
-            ui->line_target_velocity_m1->setText(qstr);
-          /*  ui->line_target_velocity_m1->setStyleSheet("QLabel{background:white;"
-                                                       "color:black;"
-                                                       "font:bold 75 12pt \"Noto Sans\";}");*/
-            qstr.clear();
-
-            QTextStream(&qstr) << gui_node_->received_data_[i].control_word;
-            ui->line_control_word_m1->setText(qstr);
-            qstr.clear();
-
-            QTextStream(&qstr) << gui_node_->received_data_[i].actual_pos;
-            ui->line_actual_velocity_m1->setText(qstr);
-            qstr.clear();
-
-            qstr = GetReadableStatusWord(i);
-
-            qstr.clear();
-            break;
-        case 1:
-            QTextStream(&qstr) << gui_node_->received_data_[i].target_pos;
-            ui->line_target_velocity_m2->setText(qstr);
-          /*  ui->line_target_velocity_m1->setStyleSheet("QLabel{background:white;"
-                                                       "color:black;"
-                                                       "font:bold 75 12pt \"Noto Sans\";}");*/
-            qstr.clear();
-
-            QTextStream(&qstr) << gui_node_->received_data_[i].control_word;
-            ui->line_control_word_m2->setText(qstr);
-            qstr.clear();
-
-            QTextStream(&qstr) << gui_node_->received_data_[i].actual_pos;
-            ui->line_actual_velocity_m2->setText(qstr);
-            qstr.clear();
-            qstr = GetReadableStatusWord(i);
-            qstr.clear();
-            break;
-        case 2:
-            QTextStream(&qstr) << gui_node_->received_data_[i].target_pos;
-            ui->line_target_velocity_m3->setText(qstr);
-          /*  ui->line_target_velocity_m1->setStyleSheet("QLabel{background:white;"
-                                                       "color:black;"
-                                                       "font:bold 75 12pt \"Noto Sans\";}");*/
-            qstr.clear();
-
-            QTextStream(&qstr) << gui_node_->received_data_[i].control_word;
-            ui->line_control_word_m3->setText(qstr);
-            qstr.clear();
-
-            QTextStream(&qstr) << gui_node_->received_data_[i].actual_pos;
-            ui->line_actual_velocity_m3->setText(qstr);
-            qstr.clear();
-            qstr = GetReadableStatusWord(i);
-            qstr.clear();
-            break;
-        default:
-            ui->line_actual_velocity_m3->setText("0");
-            ui->line_status_word_m3->setText("NOT READY");
-            ui->line_control_word_m3->setText("0");
-            ui->line_target_velocity_m3->setText("0");
-
-            ui->line_actual_velocity_m2->setText("0");
-            ui->line_status_word_m2->setText("NOT READY");
-            ui->line_control_word_m2->setText("0");
-            ui->line_target_velocity_m2->setText("0");
-
-            ui->line_actual_velocity_m1->setText("0");
-            ui->line_status_word_m1->setText("NOT READY");
-            ui->line_control_word_m1->setText("0");
-            ui->line_target_velocity_m1->setText("0");
-            break;
-        }
-
+    for(int i = 0; i < NUM_OF_SERVO_DRIVES && i < kNumOfMotorViews ;i++){
+        target_view_[i].SetNumber(snapshot_.drives[i].target_pos);
+        control_word_view_[i].SetNumber(snapshot_.drives[i].control_word);
+        actual_view_[i].SetNumber(snapshot_.drives[i].actual_pos);
+        ShowStatusWord(i);
     }
 }
 
-QString MainWindow::GetReadableStatusWord(int index)
+void MainWindow::ShowStatusWord(int index)
 {
-    QString qstr;
-
-    if (gui_node_->received_data_[index].status_word==4663 || gui_node_->received_data_[index].status_word==567){
-        QTextStream(&qstr) << "READY";
-        switch (index) {
-        case 0:
-            ui->line_status_word_m1->setText(qstr);
-            ui->line_status_word_m1->setStyleSheet("QLabel{background:green;"
-                                                   "color:black;"
-                                                   "font:bold 75 12pt \"Noto Sans\";}");
-            break;
-        case 1:
-            ui->line_status_word_m2->setText(qstr);
-            ui->line_status_word_m2->setStyleSheet("QLabel{background:green;"
-                                                   "color:black;"
-                                                   "font:bold 75 12pt \"Noto Sans\";}");
-            break;
-        case 2:
-            ui->line_status_word_m3->setText(qstr);
-            ui->line_status_word_m3->setStyleSheet("QLabel{background:green;"
-                                                   "color:black;"
-                                                   "font:bold 75 12pt \"Noto Sans\";}");
-            break;
-        default:
-            break;
-        }
-    } else if(TEST_BIT(gui_node_->received_data_[index].status_word,10)){
-        QTextStream(&qstr) << "ON TARGET";
-        switch (index) {
-        case 0:
-            ui->line_status_word_m1->setText(qstr);
-            ui->line_status_word_m1->setStyleSheet("QLabel{background:yellow;"
-                                                   "color:black;"
-                                                   "font:bold 75 12pt \"Noto Sans\";}");
-            break;
-        case 1:
-            ui->line_status_word_m2->setText(qstr);
-            ui->line_status_word_m2->setStyleSheet("QLabel{background:yellow;"
-                                                   "color:black;"
-                                                   "font:bold 75 12pt \"Noto Sans\";}");
-            break;
-        case 2:
-            ui->line_status_word_m3->setText(qstr);
-            ui->line_status_word_m3->setStyleSheet("QLabel{background:yellow;"
-                                                   "color:black;"
-                                                   "font:bold 75 12pt \"Noto Sans\";}");
-            break;
-        default:
-            break;
-        }
+    const uint16_t status_word = snapshot_.drives[index].status_word;
+    if (status_word==4663 || status_word==567){
+        status_word_view_[index].SetText("READY");
+        status_word_view_[index].SetStyle(LabelStyle::kBlackOnGreen);
+    } else if(TEST_BIT(status_word,10)){
+        status_word_view_[index].SetText("ON TARGET");
+        status_word_view_[index].SetStyle(LabelStyle::kBlackOnYellow);
     }else{
-        QTextStream(&qstr) << "MOVING";
-        switch (index) {
-        case 0:
-            ui->line_status_word_m1->setText(qstr);
-            ui->line_status_word_m1->setStyleSheet("QLabel{background:red;"
-                                                   "color:black;"
-                                                   "font:bold 75 12pt \"Noto Sans\";}");
-            break;
-        case 1:
-            ui->line_status_word_m2->setText(qstr);
-            ui->line_status_word_m2->setStyleSheet("QLabel{background:red;"
-                                                   "color:black;"
-                                                   "font:bold 75 12pt \"Noto Sans\";}");
-            break;
-        case 2:
-            ui->line_status_word_m3->setText(qstr);
-            ui->line_status_word_m3->setStyleSheet("QLabel{background:red;"
-                                                   "color:black;"
-                                                   "font:bold 75 12pt \"Noto Sans\";}");
-            break;
-        default:
-            break;
-        }
+        status_word_view_[index].SetText("MOVING");
+        status_word_view_[index].SetStyle(LabelStyle::kBlackOnRed);
     }
-    return qstr;
 }
 
 void MainWindow::on_button_reset_clicked()
 {
-    for (int i = 0 ; i < NUM_OF_SERVO_DRIVES ; i++ ){
-        gui_node_->received_data_[i].status_word = 0 ;
-        gui_node_->received_data_[i].actual_pos = 0 ;
-        gui_node_->received_data_[i].actual_vel = 0 ;
-
-        gui_node_->received_data_[i].control_word = 0 ;
-        gui_node_->received_data_[i].target_pos  = 0 ;
-        gui_node_->received_data_[i].target_vel = 0 ;
-        gui_node_->received_data_[0].left_limit_switch_val = 0 ;
-        gui_node_->received_data_[0].right_limit_switch_val = 0;
-        gui_node_->received_data_[0].right_x_axis = 0 ;
-        gui_node_->received_data_[0].left_x_axis = 0 ;
-    }
-    if (gui_node_->received_data_[0].p_emergency_switch_val){
+    gui_node_->RequestReset();
+    if (snapshot_.drives[0].p_emergency_switch_val){
        gui_node_->emergency_button_val_ = 1;
        setEnabledStyleSheet();
     }
@@ -0,0 +1,100 @@
+#include "../include/gui_pkg/plot_widget.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <QPainter>
+#include <QResizeEvent>
+
+using namespace GUI;
+
+namespace {
+const QColor kTraceColors[] = {Qt::red, Qt::green, Qt::cyan, Qt::yellow, Qt::magenta, Qt::white};
+}
+
+PlotWidget::PlotWidget(const QString & title, int num_of_traces, int window_samples, QWidget * parent)
+: QWidget(parent),
+  title_(title),
+  num_of_traces_(num_of_traces),
+  window_samples_(window_samples)
+{
+    setMinimumHeight(120);
+    // Whole widget is painted in paintEvent(), Qt doesn't have to clear it first.
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    Reset(1);
+}
+
+void PlotWidget::Reset(int num_of_columns)
+{
+    num_of_columns_ = std::max(num_of_columns, 1);
+    samples_per_column_ = std::max(1, (window_samples_ + num_of_columns_ - 1) / num_of_columns_);
+    head_ = head_fill_ = num_of_full_columns_ = 0;
+    min_.assign(num_of_traces_ * num_of_columns_, 0);
+    max_.assign(num_of_traces_ * num_of_columns_, 0);
+    points_.resize(2 * num_of_columns_);
+}
+
+void PlotWidget::resizeEvent(QResizeEvent * event)
+{
+    if(event->size().width() != num_of_columns_){
+        Reset(event->size().width());
+    }
+    QWidget::resizeEvent(event);
+}
+
+void PlotWidget::Append(const float * values)
+{
+    if(!head_fill_){
+        for(int t = 0 ; t < num_of_traces_ ; t++){
+            Min(t, head_) = Max(t, head_) = values[t];
+        }
+    }else{
+        for(int t = 0 ; t < num_of_traces_ ; t++){
+            Min(t, head_) = std::min(Min(t, head_), values[t]);
+            Max(t, head_) = std::max(Max(t, head_), values[t]);
+        }
+    }
+    if(++head_fill_ == samples_per_column_){
+        head_fill_ = 0;
+        head_ = (head_ + 1) % num_of_columns_;
+        num_of_full_columns_ = std::min(num_of_full_columns_ + 1, num_of_columns_ - 1);
+    }
+}
+
+void PlotWidget::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+    painter.setPen(Qt::gray);
+    painter.drawText(4, 14, title_);
+
+    // Oldest complete column first, column being filled last, newest data at the right edge.
+    const int num_of_drawn = num_of_full_columns_ + (head_fill_ ? 1 : 0);
+    if(!num_of_drawn){
+        return;
+    }
+    const int first = (head_ - num_of_full_columns_ + num_of_columns_) % num_of_columns_;
+    float low = Min(0, first), high = Max(0, first);
+    for(int t = 0 ; t < num_of_traces_ ; t++){
+        for(int k = 0, c = first ; k < num_of_drawn ; k++, c = (c + 1) % num_of_columns_){
+            low  = std::min(low, Min(t, c));
+            high = std::max(high, Max(t, c));
+        }
+    }
+    const float margin = high > low ? 0.05f * (high - low) : 1.0f;
+    low -= margin;
+    high += margin;
+    const double scale = (height() - 1) / double(high - low);
+    painter.drawText(4, 28, QString::number(high, 'g', 6));
+    painter.drawText(4, height() - 4, QString::number(low, 'g', 6));
+
+    const int x0 = width() - num_of_drawn;
+    for(int t = 0 ; t < num_of_traces_ ; t++){
+        for(int k = 0, c = first ; k < num_of_drawn ; k++, c = (c + 1) % num_of_columns_){
+            points_[2 * k]     = QPointF(x0 + k, (high - Min(t, c)) * scale);
+            points_[2 * k + 1] = QPointF(x0 + k, (high - Max(t, c)) * scale);
+        }
+        painter.setPen(kTraceColors[t % (sizeof(kTraceColors) / sizeof(kTraceColors[0]))]);
+        painter.drawPolyline(points_.data(), 2 * num_of_drawn);
+    }
+}
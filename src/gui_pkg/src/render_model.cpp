@@ -0,0 +1,106 @@
+#include "../include/gui_pkg/render_model.hpp"
+
+#include <cstring>
+
+using namespace GUI;
+
+namespace {
+const char * StyleSheet(LabelStyle style)
+{
+    switch(style){
+        case LabelStyle::kWhiteOnGreen  : return "QLabel{background:green;color:white;font:bold 75 12pt \"Noto Sans\";}";
+        case LabelStyle::kWhiteOnYellow : return "QLabel{background:yellow;color:white;font:bold 75 12pt \"Noto Sans\";}";
+        case LabelStyle::kWhiteOnRed    : return "QLabel{background:red;color:white;font:bold 75 12pt \"Noto Sans\";}";
+        case LabelStyle::kBlackOnGreen  : return "QLabel{background:green;color:black;font:bold 75 12pt \"Noto Sans\";}";
+        case LabelStyle::kBlackOnYellow : return "QLabel{background:yellow;color:black;font:bold 75 12pt \"Noto Sans\";}";
+        case LabelStyle::kBlackOnRed    : return "QLabel{background:red;color:black;font:bold 75 12pt \"Noto Sans\";}";
+        default : return "";
+    }
+}
+}
+
+int64_t FrameStats::ThreadCpuNs()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return int64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+void FrameStats::BeginFrame()
+{
+    frame_start_ns_ = ThreadCpuNs();
+}
+
+void FrameStats::EndFrame()
+{
+    const int64_t cpu_ns = ThreadCpuNs() - frame_start_ns_;
+    total_ns_ += cpu_ns;
+    if(cpu_ns > max_ns_){
+        max_ns_ = cpu_ns;
+    }
+    frames_++;
+}
+
+bool FrameStats::TakeSummary(uint32_t frames_per_summary, Summary & summary)
+{
+    if(!frames_ || frames_ < frames_per_summary){
+        return false;
+    }
+    summary.frames            = frames_;
+    summary.mean_cpu_ns       = total_ns_ / frames_;
+    summary.max_cpu_ns        = max_ns_;
+    summary.updates_per_frame = double(updates_) / frames_;
+    summary.stale_snapshots   = stale_snapshots_;
+    total_ns_ = max_ns_ = 0;
+    frames_ = 0;
+    updates_ = 0;
+    stale_snapshots_ = 0;
+    return true;
+}
+
+void LabelView::Attach(QLabel * label, FrameStats * stats)
+{
+    label_ = label;
+    stats_ = stats;
+    Invalidate();
+}
+
+void LabelView::SetNumber(int64_t value)
+{
+    if(has_number_ && number_ == value){
+        return;
+    }
+    label_->setText(QString::number(value));
+    number_ = value;
+    has_number_ = true;
+    text_ = nullptr;
+    Updated();
+}
+
+void LabelView::SetText(const char * text)
+{
+    if(text_ && (text_ == text || !strcmp(text_, text))){
+        return;
+    }
+    label_->setText(QString::fromLatin1(text));
+    text_ = text;
+    has_number_ = false;
+    Updated();
+}
+
+void LabelView::SetStyle(LabelStyle style)
+{
+    if(style == style_){
+        return;
+    }
+    label_->setStyleSheet(StyleSheet(style));
+    style_ = style;
+    Updated();
+}
+
+void LabelView::Invalidate()
+{
+    has_number_ = false;
+    text_ = nullptr;
+    style_ = LabelStyle::kNone;
+}
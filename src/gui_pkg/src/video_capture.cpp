@@ -1,98 +1,215 @@
 #include "../include/gui_pkg/video_capture.hpp"
+#include <QCoreApplication>
 #include <QDebug>
 
+#include <algorithm>
+#include <chrono>
+
 VideoCapture::VideoCapture(QObject *parent)
     :QThread { parent }
     ,video_cap { ID_CAMERA }
 {
+    AllocateFrames();
+}
 
+VideoCapture::VideoCapture(const std::string & file, QObject *parent)
+    :QThread { parent }
+    ,video_cap { file }
+    ,from_file_ { true }
+{
+    AllocateFrames();
+}
+
+VideoCapture::~VideoCapture()
+{
+    requestInterruption();
+    wait();
+}
+
+void VideoCapture::AllocateFrames()
+{
+    for(size_t i = 0 ; i < mailbox_.Size() ; i++)
+    {
+        VideoFrame & frame = mailbox_[i];
+        // RGB32 is B, G, R, 0xff in memory, what cv::COLOR_BGR2BGRA writes and what QPainter draws without converting.
+        frame.image = QImage(kOutputWidth, kOutputHeight, QImage::Format_RGB32);
+        frame.image.fill(Qt::black);
+        frame.pixels = cv::Mat(kOutputHeight, kOutputWidth, CV_8UC4, frame.image.bits(),
+                               static_cast<size_t>(frame.image.bytesPerLine()));
+    }
+}
+
+int64_t VideoCapture::NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 void VideoCapture::run()
 {
-    if(video_cap.isOpened())
+    if(!video_cap.isOpened())
+    {
+        qWarning() << "VideoCapture::run() - video source couldn't be opened.";
+        return;
+    }
+    // Camera reads block until next frame, files are paced to their own frame rate.
+    const double fps = video_cap.get(cv::CAP_PROP_FPS);
+    const int64_t period_ns = static_cast<int64_t>(1e9 / (fps > 0 ? fps : frame_rate));
+    int64_t next_ns = NowNs();
+    while (!isInterruptionRequested())
     {
-        while (true)
+        if(!video_cap.read(frame_cap))
         {
-            video_cap >> frame_cap;
-            if(!frame_cap.empty())
+            if(from_file_)
             {
-                pixmap_cap = cvMatToQPixmap(frame_cap);
-                emit NewPixmapCapture();
+                break;
+            }
+            QThread::usleep(period_ns / 1000);
+            continue;
+        }
+        const int64_t capture_ns = NowNs();
+        VideoFrame & frame = mailbox_.WriteFrame();
+        if(ConvertFrame(frame_cap, frame))
+        {
+            frame.capture_ns = capture_ns;
+            frame.sequence   = captured_.fetch_add(1, std::memory_order_relaxed) + 1;
+            convert_ns_.fetch_add(NowNs() - capture_ns, std::memory_order_relaxed);
+            // GUI is only notified once per taken frame, newer frames replace the unread one.
+            if(mailbox_.Publish())
+            {
+                emit NewFrameCaptured();
+            }
+        }
+        if(from_file_)
+        {
+            // A late frame doesn't make following frames come in a burst.
+            next_ns = std::max(next_ns + period_ns, NowNs());
+            const int64_t wait_ns = next_ns - NowNs();
+            if(wait_ns > 0)
+            {
+                QThread::usleep(wait_ns / 1000);
             }
-            QThread::msleep((1/frame_rate)*1000);
         }
     }
 }
 
-QImage VideoCapture::cvMatToQImage( const cv::Mat &inMat )
+bool VideoCapture::ConvertFrame(const cv::Mat &inMat, VideoFrame & frame)
 {
-  switch ( inMat.type() )
-  {
-     // 8-bit, 4 channel
-     case CV_8UC4:
-     {
-        QImage image( inMat.data,
-                      inMat.cols, inMat.rows,
-                      static_cast<int>(inMat.step),
-                      QImage::Format_ARGB32 );
-
-        return image;
-     }
-
-     // 8-bit, 3 channel
-     case CV_8UC3:
-     {
-        QImage image( inMat.data,
-                      inMat.cols, inMat.rows,
-                      static_cast<int>(inMat.step),
-                      QImage::Format_RGB888 );
-
-        return image.rgbSwapped();
-     }
-
-     // 8-bit, 1 channel
-     case CV_8UC1:
-     {
-#if QT_VERSION >= QT_VERSION_CHECK(5, 5, 0)
-        QImage image( inMat.data,
-                      inMat.cols, inMat.rows,
-                      static_cast<int>(inMat.step),
-                      QImage::Format_Grayscale8 );
-#else
-        static QVector<QRgb>  sColorTable;
-
-        // only create our color table the first time
-        if ( sColorTable.isEmpty() )
+    // -1 : input is already BGRA, it's only copied or scaled.
+    int code;
+    switch ( inMat.type() )
+    {
+        case CV_8UC4: code = -1;                  break;
+        case CV_8UC3: code = cv::COLOR_BGR2BGRA;  break;
+        case CV_8UC1: code = cv::COLOR_GRAY2BGRA; break;
+        default:
         {
-           sColorTable.resize( 256 );
-
-           for ( int i = 0; i < 256; ++i )
-           {
-              sColorTable[i] = qRgb( i, i, i );
-           }
+            static bool warned = false;
+            if(!warned)
+            {
+                qWarning() << "VideoCapture::ConvertFrame() - cv::Mat image type not handled in switch:" << inMat.type();
+                warned = true;
+            }
+            return false;
         }
+    }
+    // Output Mat already has the right size and type, OpenCV writes into image's pixels without allocating.
+    if(inMat.size() == frame.pixels.size())
+    {
+        if(code < 0)
+        {
+            inMat.copyTo(frame.pixels);
+        }
+        else
+        {
+            cv::cvtColor(inMat, frame.pixels, code);
+        }
+    }
+    else if(code < 0)
+    {
+        cv::resize(inMat, frame.pixels, frame.pixels.size(), 0, 0,
+                   inMat.total() > frame.pixels.total() ? cv::INTER_AREA : cv::INTER_LINEAR);
+    }
+    else if(inMat.total() > frame.pixels.total())
+    {
+        // Shrink first, fewer pixels are converted.
+        cv::resize(inMat, scaled_, frame.pixels.size(), 0, 0, cv::INTER_AREA);
+        cv::cvtColor(scaled_, frame.pixels, code);
+    }
+    else
+    {
+        cv::cvtColor(inMat, converted_, code);
+        cv::resize(converted_, frame.pixels, frame.pixels.size(), 0, 0, cv::INTER_LINEAR);
+    }
+    return true;
+}
 
-        QImage image( inMat.data,
-                      inMat.cols, inMat.rows,
-                      static_cast<int>(inMat.step),
-                      QImage::Format_Indexed8 );
-
-        image.setColorTable( sColorTable );
-#endif
-
-        return image;
-     }
-
-     default:
-        qWarning() << "ASM::cvMatToQImage() - cv::Mat image type not handled in switch:" << inMat.type();
-        break;
-  }
+void VideoCapture::FrameShown(const VideoFrame & frame)
+{
+    const int64_t now = NowNs();
+    // First frame starts the measurement, so rates aren't diluted by start up time.
+    if(!summary_start_ns_)
+    {
+        summary_start_ns_ = now;
+        last_captured_    = captured_.load(std::memory_order_relaxed);
+        last_dropped_     = mailbox_.GetDropped();
+        last_convert_ns_  = convert_ns_.load(std::memory_order_relaxed);
+        return;
+    }
+    const int64_t latency = now - frame.capture_ns;
+    latency_sum_ns_ += latency;
+    stats_.max_latency_ns = std::max(stats_.max_latency_ns, latency);
+    if(++stats_.shown >= kFramesPerSummary)
+    {
+        LogSummary(now);
+    }
+}
 
-  return QImage();
+void VideoCapture::LogSummary(int64_t now)
+{
+    const uint64_t captured   = captured_.load(std::memory_order_relaxed);
+    const uint64_t dropped    = mailbox_.GetDropped();
+    const int64_t  convert_ns = convert_ns_.load(std::memory_order_relaxed);
+    const double   seconds    = (now - summary_start_ns_) / 1e9;
+    stats_.captured        = captured - last_captured_;
+    stats_.dropped         = dropped - last_dropped_;
+    stats_.shown_fps       = stats_.shown / seconds;
+    stats_.capture_fps     = stats_.captured / seconds;
+    stats_.mean_latency_ns = stats_.shown ? latency_sum_ns_ / stats_.shown : 0;
+    stats_.mean_convert_ns = stats_.captured ? (convert_ns - last_convert_ns_) / int64_t(stats_.captured) : 0;
+    qInfo("Video shown : %.1f fps | captured : %.1f fps | dropped : %llu | latency mean : %.2f ms max : %.2f ms | convert : %.2f ms",
+          stats_.shown_fps, stats_.capture_fps, static_cast<unsigned long long>(stats_.dropped),
+          stats_.mean_latency_ns / 1e6, stats_.max_latency_ns / 1e6, stats_.mean_convert_ns / 1e6);
+    summary_start_ns_ = now;
+    last_captured_    = captured;
+    last_dropped_     = dropped;
+    last_convert_ns_  = convert_ns;
+    latency_sum_ns_   = 0;
+    stats_ = {};
 }
 
-QPixmap VideoCapture::cvMatToQPixmap( const cv::Mat &inMat )
+int VideoCapture::RunBenchmark(const std::string & file)
 {
-  return QPixmap::fromImage( cvMatToQImage( inMat ) );
+    VideoCapture capture(file);
+    if(!capture.video_cap.isOpened())
+    {
+        qWarning() << "VideoCapture::RunBenchmark() - couldn't open" << file.c_str();
+        return -1;
+    }
+    // Same hand-off as GUI, frames are taken in the thread that owns capture, only without drawing them.
+    QObject::connect(&capture, &VideoCapture::NewFrameCaptured, &capture, [&capture]()
+    {
+        if(const VideoFrame * frame = capture.TakeFrame())
+        {
+            capture.FrameShown(*frame);
+        }
+    });
+    QObject::connect(&capture, &QThread::finished, QCoreApplication::instance(), &QCoreApplication::quit);
+    capture.start(QThread::HighestPriority);
+    const int result = QCoreApplication::exec();
+    if(capture.stats_.shown)
+    {
+        capture.LogSummary(NowNs());
+    }
+    return result;
 }
@@ -130,6 +130,10 @@ void HapticNode::commThread()
 			real_recv_len += real_recv_byte;
 		}
 
+    // Source stamp and sequence number are used by ecat_node for latency tracing.
+    hapticMsg.stamp = this->now();
+    hapticMsg.seq++;
+
     // CKim - Convert received bytes to doubles and ints
  		double* val = (double*) str2;
     //int* btn = (int*) (str2+6*sizeof(double));